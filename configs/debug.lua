@@ -28,6 +28,7 @@ function Config.Execute(self)
 	config.settings.config_name = "debug"
 	config.settings.config_ext = "_d"
 		config.settings.cc.defines:Add("CONFIG_SUFFIX=\\\"_d\\\"")
+	config.settings.cc.defines:Add("HASH_REGISTRY_ENABLE")
 
 	if family == "unix" then
 	  config.settings.cc.flags:Add("-g")
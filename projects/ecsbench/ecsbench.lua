@@ -0,0 +1,16 @@
+Unit:Using("foundation")
+Unit:Using("game")
+Unit:Using("getopt")
+
+function Unit.Init(self)
+	self.executable = true
+	self.targetname = "ecsbench"
+end
+
+function Unit.Build(self)
+	local common_src = Collect(self.path .. "/src/*.cpp")
+	local common_obj = Compile(self.settings, common_src)
+
+	local bin = Link(self.settings, self.targetname, common_obj)
+	self:AddProduct(bin)
+end
@@ -0,0 +1,731 @@
+#include <foundation/allocator.h>
+#include <foundation/array.h>
+#include <foundation/file.h>
+#include <foundation/job_system.h>
+#include <foundation/range_pool.h>
+#include <foundation/time.h>
+#include <game/ecs.h>
+#include <game/spatial.h>
+
+#include <getopt/getopt.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BENCH_MAX_COMPONENTS (16)
+#define BENCH_NUM_QUERIES (1024)
+#define BENCH_MAX_QUERY_RESULTS (256)
+#define BENCH_MAX_TABLE_SIZE (64)
+#define BENCH_CHURN_TYPES (4)
+
+#define ERROR_AND_FAIL(fmt, ...) { fprintf(stderr, "Error: " fmt "\n", ##__VA_ARGS__); return 1; }
+
+struct bench_component_t
+{
+	float v[4];
+};
+
+struct bench_result_t
+{
+	const char* storage;
+	const char* operation;
+	uint32_t entities;
+	uint32_t components;
+	uint32_t items; // Entities, lookups or queries timed
+	uint32_t repeats;
+	uint64_t best;
+	uint64_t total;
+};
+
+struct bench_t
+{
+	job_system_t* job_system;
+	uint32_t num_workers;
+	array_t<bench_result_t> results;
+
+	uint64_t rng;
+	bench_component_t* component_data; // One component per entity, shared by all component types
+	entity_id_t* eids;
+	volatile float sink; // Keeps the reads of the queries from being optimized away
+};
+
+static uint32_t bench_rand(bench_t* bench)
+{
+	// xorshift64*, the same sequence on every platform
+	bench->rng ^= bench->rng >> 12;
+	bench->rng ^= bench->rng << 25;
+	bench->rng ^= bench->rng >> 27;
+	return (uint32_t)((bench->rng * 2685821657736338717ULL) >> 32);
+}
+
+static float bench_randf(bench_t* bench, float lo, float hi)
+{
+	return lo + (hi - lo) * (float)(bench_rand(bench) >> 8) * (1.0f / 16777216.0f);
+}
+
+static void bench_shuffle(bench_t* bench, entity_id_t* eids, uint32_t count)
+{
+	for (uint32_t i = count; i > 1; --i)
+	{
+		uint32_t j = bench_rand(bench) % i;
+		entity_id_t tmp = eids[i - 1];
+		eids[i - 1] = eids[j];
+		eids[j] = tmp;
+	}
+}
+
+/**
+ * Adds a timing to the row of the same benchmark, the best and the mean of all repeats are reported.
+ */
+static void bench_record(bench_t* bench, const char* storage, const char* operation, uint32_t entities, uint32_t components, uint32_t items, uint64_t ticks)
+{
+	for (size_t i = 0; i < bench->results.length(); ++i)
+	{
+		bench_result_t* result = &bench->results[i];
+		if (result->storage == storage && result->operation == operation && result->entities == entities && result->components == components)
+		{
+			result->best = ticks < result->best ? ticks : result->best;
+			result->total += ticks;
+			result->repeats += 1;
+			return;
+		}
+	}
+
+	bench_result_t result = { storage, operation, entities, components, items, 1, ticks, ticks };
+	if (bench->results.full())
+		bench->results.grow(&allocator_malloc);
+	bench->results.append(result);
+}
+
+/******************************************************************************\
+*
+*  ECS benchmarks
+*
+\******************************************************************************/
+
+static void bench_iterate_job(job_context_t* context, const ecs_query_batch_t* batch, void* user_data)
+{
+	uint32_t num_components = *(const uint32_t*)user_data;
+	for (uint32_t c = 0; c < num_components; ++c)
+	{
+		bench_component_t* components = (bench_component_t*)batch->components[c];
+		for (uint32_t i = 0; i < batch->count; ++i)
+			components[i].v[0] += 1.0f;
+	}
+}
+
+static float bench_iterate(ecs_t* ecs, ecs_query_t* query, uint32_t num_components)
+{
+	float sum = 0.0f;
+	ecs_query_iter_t iter;
+	ecs_query_batch_t batch;
+	ecs_query_iter_begin(ecs, query, &iter);
+	while (ecs_query_iter_next(&iter, &batch))
+	{
+		for (uint32_t c = 0; c < num_components; ++c)
+		{
+			const bench_component_t* components = (const bench_component_t*)batch.components[c];
+			for (uint32_t i = 0; i < batch.count; ++i)
+				sum += components[i].v[0];
+		}
+	}
+	return sum;
+}
+
+/**
+ * One round of every ECS benchmark on a fresh ECS with entities having the first num_components component types.
+ */
+static void bench_ecs_round(bench_t* bench, ecs_storage_t storage, const char* storage_name, uint32_t num_entities, uint32_t num_components)
+{
+	ecs_create_info_t create_info = {};
+	create_info.allocator = &allocator_malloc;
+	create_info.storage = storage;
+	create_info.max_entities = num_entities;
+	create_info.max_component_types = BENCH_MAX_COMPONENTS;
+	create_info.max_archetypes = 4;
+	ecs_t* ecs;
+	ecs_create(&create_info, &ecs);
+
+	component_type_id_t types[BENCH_MAX_COMPONENTS];
+	component_data_t datas[BENCH_MAX_COMPONENTS];
+	for (uint32_t c = 0; c < num_components; ++c)
+	{
+		component_type_create_info_t type_info = {};
+		type_info.component_size = sizeof(bench_component_t);
+		ecs_register_component_type(ecs, &type_info, &types[c]);
+		datas[c].type = types[c];
+		datas[c].data = bench->component_data;
+	}
+	entity_create_info_t entity_info = { num_components, datas };
+	entity_id_t* eids = bench->eids;
+
+	uint64_t start = time_current();
+	for (uint32_t i = 0; i < num_entities; ++i)
+	{
+		for (uint32_t c = 0; c < num_components; ++c)
+			datas[c].data = &bench->component_data[i];
+		ecs_entity_create(ecs, &entity_info, &eids[i]);
+	}
+	bench_record(bench, storage_name, "create", num_entities, num_components, num_entities, time_current() - start);
+	for (uint32_t c = 0; c < num_components; ++c)
+		datas[c].data = bench->component_data;
+
+	start = time_current();
+	for (uint32_t i = 0; i < num_entities; ++i)
+		ecs_entity_destroy(ecs, eids[i]);
+	bench_record(bench, storage_name, "destroy_sequential", num_entities, num_components, num_entities, time_current() - start);
+
+	start = time_current();
+	ecs_entities_create_batch(ecs, &entity_info, num_entities, eids);
+	bench_record(bench, storage_name, "create_batch", num_entities, num_components, num_entities, time_current() - start);
+
+	bench_shuffle(bench, eids, num_entities);
+	start = time_current();
+	for (uint32_t i = 0; i < num_entities; ++i)
+		ecs_entity_destroy(ecs, eids[i]);
+	bench_record(bench, storage_name, "destroy_random", num_entities, num_components, num_entities, time_current() - start);
+
+	ecs_entities_create_batch(ecs, &entity_info, num_entities, eids);
+
+	ecs_query_create_info_t query_info = {};
+	query_info.num_with = 1;
+	query_info.with = types;
+	ecs_query_t* single_query;
+	ecs_query_create(ecs, &query_info, &single_query);
+	query_info.num_with = num_components;
+	query_info.write_mask = (uint32_t)((1ULL << num_components) - 1);
+	ecs_query_t* multi_query;
+	ecs_query_create(ecs, &query_info, &multi_query);
+
+	start = time_current();
+	bench->sink = bench->sink + bench_iterate(ecs, single_query, 1);
+	bench_record(bench, storage_name, "query_single", num_entities, num_components, num_entities, time_current() - start);
+
+	start = time_current();
+	bench->sink = bench->sink + bench_iterate(ecs, multi_query, num_components);
+	bench_record(bench, storage_name, "query_multi", num_entities, num_components, num_entities, time_current() - start);
+
+	bench_shuffle(bench, eids, num_entities);
+	start = time_current();
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < num_entities; ++i)
+	{
+		query_result_t result;
+		ecs_query_component(ecs, eids[i], types[i % num_components], &result);
+		sum += ((const bench_component_t*)result.component_data)->v[0];
+	}
+	bench->sink = bench->sink + sum;
+	bench_record(bench, storage_name, "lookup_random", num_entities, num_components, num_entities, time_current() - start);
+
+	job_event_t* event;
+	job_system_acquire_event(bench->job_system, &event);
+	start = time_current();
+	ecs_query_kick(ecs, multi_query, bench->job_system, bench->num_workers, bench_iterate_job, &num_components, nullptr, event);
+	job_system_wait_release_event(bench->job_system, event);
+	bench_record(bench, storage_name, "iterate_parallel", num_entities, num_components, num_entities, time_current() - start);
+
+	start = time_current();
+	ecs_entities_destroy_batch(ecs, eids, num_entities);
+	bench_record(bench, storage_name, "destroy_batch", num_entities, num_components, num_entities, time_current() - start);
+
+	ecs_query_destroy(ecs, single_query);
+	ecs_query_destroy(ecs, multi_query);
+	ecs_destroy(ecs);
+}
+
+/******************************************************************************\
+*
+*  Spatial grid benchmarks
+*
+\******************************************************************************/
+
+struct bench_query_job_arg_t
+{
+	const spatial_grid_t* grid;
+	const spatial_aabb_t* queries;
+	uint32_t num_queries;
+	uint32_t* num_found;
+};
+
+static void bench_query_job(job_context_t* context, void* arg)
+{
+	bench_query_job_arg_t* job_arg = (bench_query_job_arg_t*)arg;
+	entity_id_t found[BENCH_MAX_QUERY_RESULTS];
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < job_arg->num_queries; ++i)
+	{
+		uint32_t count;
+		spatial_grid_query_aabb(job_arg->grid, &job_arg->queries[i], BENCH_MAX_QUERY_RESULTS, found, &count);
+		total += count;
+	}
+	*job_arg->num_found = total;
+}
+
+/**
+ * Boxes of size 1 wandering around a cube sized for about one box per 8 units
+ * of volume. Every box moves each frame, so the whole grid is updated.
+ */
+static void bench_spatial_round(bench_t* bench, uint32_t num_entities)
+{
+	spatial_grid_create_info_t create_info = {};
+	create_info.allocator = &allocator_malloc;
+	create_info.max_entities = num_entities;
+	create_info.max_cells = num_entities;
+	create_info.cell_size = 4.0f;
+	spatial_grid_t* grid;
+	spatial_grid_create(&create_info, &grid);
+
+	float extent = cbrtf((float)num_entities) * 2.0f;
+	float* positions = (float*)malloc(num_entities * 3 * sizeof(float));
+	float* velocities = (float*)malloc(num_entities * 3 * sizeof(float));
+	spatial_aabb_t* aabbs = (spatial_aabb_t*)malloc(num_entities * sizeof(spatial_aabb_t));
+	entity_id_t* eids = bench->eids;
+	for (uint32_t i = 0; i < num_entities; ++i)
+	{
+		eids[i].id = i | (1U << ECS_ENTITY_INDEX_BITS);
+		for (int a = 0; a < 3; ++a)
+		{
+			positions[i * 3 + a] = bench_randf(bench, 0.0f, extent);
+			velocities[i * 3 + a] = bench_randf(bench, -0.5f, 0.5f);
+			aabbs[i].min[a] = positions[i * 3 + a] - 0.5f;
+			aabbs[i].max[a] = positions[i * 3 + a] + 0.5f;
+		}
+	}
+
+	uint64_t start = time_current();
+	for (uint32_t i = 0; i < num_entities; ++i)
+		spatial_grid_insert(grid, eids[i], &aabbs[i]);
+	bench_record(bench, "grid", "spatial_insert", num_entities, 0, num_entities, time_current() - start);
+
+	for (uint32_t i = 0; i < num_entities; ++i)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			float* p = &positions[i * 3 + a];
+			float* v = &velocities[i * 3 + a];
+			*p += *v;
+			if (*p < 0.0f || *p > extent)
+				*v = -*v;
+			aabbs[i].min[a] = *p - 0.5f;
+			aabbs[i].max[a] = *p + 0.5f;
+		}
+	}
+	start = time_current();
+	spatial_grid_update_batch(grid, num_entities, eids, aabbs);
+	bench_record(bench, "grid", "spatial_update", num_entities, 0, num_entities, time_current() - start);
+
+	spatial_aabb_t queries[BENCH_NUM_QUERIES];
+	for (uint32_t i = 0; i < BENCH_NUM_QUERIES; ++i)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			queries[i].min[a] = bench_randf(bench, 0.0f, extent);
+			queries[i].max[a] = queries[i].min[a] + 8.0f;
+		}
+	}
+
+	uint32_t num_found = 0;
+	bench_query_job_arg_t serial_arg = { grid, queries, BENCH_NUM_QUERIES, &num_found };
+	start = time_current();
+	bench_query_job(nullptr, &serial_arg);
+	bench_record(bench, "grid", "spatial_query", num_entities, 0, BENCH_NUM_QUERIES, time_current() - start);
+
+	// Queries only read the grid, so they are split evenly over all workers
+	uint32_t num_jobs = bench->num_workers;
+	bench_query_job_arg_t* job_args = (bench_query_job_arg_t*)malloc(num_jobs * sizeof(bench_query_job_arg_t));
+	uint32_t* job_found = (uint32_t*)malloc(num_jobs * sizeof(uint32_t));
+	for (uint32_t j = 0; j < num_jobs; ++j)
+	{
+		uint32_t begin = BENCH_NUM_QUERIES * j / num_jobs;
+		uint32_t end = BENCH_NUM_QUERIES * (j + 1) / num_jobs;
+		bench_query_job_arg_t job_arg = { grid, &queries[begin], end - begin, &job_found[j] };
+		job_args[j] = job_arg;
+	}
+	job_event_t* event;
+	job_system_acquire_event(bench->job_system, &event);
+	start = time_current();
+	job_system_kick_ptr(bench->job_system, bench_query_job, num_jobs, job_args, nullptr, event);
+	job_system_wait_release_event(bench->job_system, event);
+	bench_record(bench, "grid", "spatial_query_parallel", num_entities, 0, BENCH_NUM_QUERIES, time_current() - start);
+
+	bench->sink = bench->sink + (float)num_found;
+	free(job_found);
+	free(job_args);
+	free(aabbs);
+	free(velocities);
+	free(positions);
+	spatial_grid_destroy(grid);
+}
+
+/******************************************************************************\
+*
+*  Churn
+*
+\******************************************************************************/
+
+/**
+ * Counts the tables holding entities and the batches iterating all of them
+ * takes. Every combination of the churn types is queried on its own, so each
+ * query matches exactly one table.
+ */
+static void bench_count_tables(ecs_t* ecs, const component_type_id_t* types, uint32_t* out_tables, uint32_t* out_batches)
+{
+	*out_tables = 0;
+	*out_batches = 0;
+	for (uint32_t mask = 1; mask < (1U << BENCH_CHURN_TYPES); ++mask)
+	{
+		component_type_id_t with[BENCH_CHURN_TYPES];
+		component_type_id_t without[BENCH_CHURN_TYPES];
+		ecs_query_create_info_t query_info = {};
+		query_info.with = with;
+		query_info.without = without;
+		for (uint32_t c = 0; c < BENCH_CHURN_TYPES; ++c)
+		{
+			if (mask & (1U << c))
+				with[query_info.num_with++] = types[c];
+			else
+				without[query_info.num_without++] = types[c];
+		}
+		ecs_query_t* query;
+		ecs_query_create(ecs, &query_info, &query);
+
+		uint32_t num_batches = 0;
+		ecs_query_iter_t iter;
+		ecs_query_batch_t batch;
+		ecs_query_iter_begin(ecs, query, &iter);
+		while (ecs_query_iter_next(&iter, &batch))
+			++num_batches;
+		ecs_query_destroy(ecs, query);
+
+		*out_tables += num_batches ? 1 : 0;
+		*out_batches += num_batches;
+	}
+}
+
+static entity_id_t bench_churn_create(bench_t* bench, ecs_t* ecs, const component_type_id_t* types)
+{
+	component_data_t datas[BENCH_CHURN_TYPES];
+	entity_create_info_t entity_info = { 0, datas };
+	uint32_t mask = 1 + bench_rand(bench) % ((1U << BENCH_CHURN_TYPES) - 1);
+	for (uint32_t c = 0; c < BENCH_CHURN_TYPES; ++c)
+	{
+		if (mask & (1U << c))
+		{
+			datas[entity_info.num_components].type = types[c];
+			datas[entity_info.num_components].data = bench->component_data;
+			++entity_info.num_components;
+		}
+	}
+	entity_id_t eid;
+	ecs_entity_create(ecs, &entity_info, &eid);
+	return eid;
+}
+
+/**
+ * Entities with random combinations of the churn types spread over all
+ * archetypes, then each step destroys a random entity and creates one with
+ * a new random combination. Table and batch counts go to stderr before and
+ * after the churn.
+ */
+static void bench_ecs_churn_round(bench_t* bench, uint32_t num_entities, bool print)
+{
+	ecs_create_info_t create_info = {};
+	create_info.allocator = &allocator_malloc;
+	create_info.storage = ECS_STORAGE_ARCHETYPES;
+	create_info.max_entities = num_entities;
+	create_info.max_component_types = BENCH_CHURN_TYPES;
+	create_info.max_archetypes = 1 << BENCH_CHURN_TYPES;
+	ecs_t* ecs;
+	ecs_create(&create_info, &ecs);
+
+	component_type_id_t types[BENCH_CHURN_TYPES];
+	for (uint32_t c = 0; c < BENCH_CHURN_TYPES; ++c)
+	{
+		component_type_create_info_t type_info = {};
+		type_info.component_size = sizeof(bench_component_t);
+		ecs_register_component_type(ecs, &type_info, &types[c]);
+	}
+
+	entity_id_t* eids = bench->eids;
+	for (uint32_t i = 0; i < num_entities; ++i)
+		eids[i] = bench_churn_create(bench, ecs, types);
+
+	uint32_t num_tables, num_batches;
+	if (print)
+	{
+		bench_count_tables(ecs, types, &num_tables, &num_batches);
+		fprintf(stderr, "ecs %u entities before churn: %u tables, %u batches\n", num_entities, num_tables, num_batches);
+	}
+
+	uint64_t start = time_current();
+	for (uint32_t i = 0; i < num_entities; ++i)
+	{
+		uint32_t e = bench_rand(bench) % num_entities;
+		ecs_entity_destroy(ecs, eids[e]);
+		eids[e] = bench_churn_create(bench, ecs, types);
+	}
+	bench_record(bench, "archetypes", "churn", num_entities, BENCH_CHURN_TYPES, num_entities, time_current() - start);
+
+	if (print)
+	{
+		bench_count_tables(ecs, types, &num_tables, &num_batches);
+		fprintf(stderr, "ecs %u entities after churn: %u tables, %u batches\n", num_entities, num_tables, num_batches);
+	}
+
+	ecs_entities_destroy_batch(ecs, eids, num_entities);
+	ecs_destroy(ecs);
+}
+
+static void bench_print_range_pool(const char* when, const range_pool_t<uint32_t>* pool, uint32_t num_tables, uint32_t num_failed)
+{
+	uint32_t num_ranges, largest;
+	pool->free_ranges(&num_ranges, &largest);
+	fprintf(stderr, "range pool %u ids %s churn: %u tables, %u free ids in %u ranges, largest %u, %u failed allocs\n",
+		pool->num_ids(), when, num_tables, pool->num_free(), num_ranges, largest, num_failed);
+}
+
+/**
+ * Fragmentation stress for range_pool_t set up like a descriptor heap. Tables of
+ * 1 to BENCH_MAX_TABLE_SIZE ids fill three quarters of the pool, then each step
+ * frees a random table and allocates a new one of random size. The state of the
+ * free ranges goes to stderr before and after the churn.
+ */
+static void bench_range_pool_round(bench_t* bench, uint32_t num_ids, bool print)
+{
+	range_pool_t<uint32_t> pool;
+	pool.create(&allocator_malloc, num_ids);
+
+	uint32_t max_tables = num_ids / ((BENCH_MAX_TABLE_SIZE + 1) / 2) + 1;
+	uint32_t* offsets = (uint32_t*)malloc(max_tables * sizeof(uint32_t));
+	uint32_t* sizes = (uint32_t*)malloc(max_tables * sizeof(uint32_t));
+	uint32_t num_tables = 0;
+	while (num_tables < max_tables && pool.num_free() > num_ids / 4 + BENCH_MAX_TABLE_SIZE)
+	{
+		sizes[num_tables] = 1 + bench_rand(bench) % BENCH_MAX_TABLE_SIZE;
+		offsets[num_tables] = pool.alloc(sizes[num_tables]);
+		++num_tables;
+	}
+	if (print)
+		bench_print_range_pool("before", &pool, num_tables, 0);
+
+	// Allocations that find no fit are counted instead of made, alloc breaks on those
+	uint32_t num_steps = num_ids;
+	uint32_t num_failed = 0;
+	uint64_t start = time_current();
+	for (uint32_t i = 0; i < num_steps && num_tables > 0; ++i)
+	{
+		uint32_t t = bench_rand(bench) % num_tables;
+		pool.free(offsets[t], sizes[t]);
+		uint32_t size = 1 + bench_rand(bench) % BENCH_MAX_TABLE_SIZE;
+		if (pool.find_free(size) == range_pool_t<uint32_t>::invalid())
+		{
+			++num_failed;
+			offsets[t] = offsets[--num_tables];
+			sizes[t] = sizes[num_tables];
+			continue;
+		}
+		offsets[t] = pool.alloc(size);
+		sizes[t] = size;
+	}
+	bench_record(bench, "range_pool", "churn", num_ids, 0, num_steps, time_current() - start);
+	if (print)
+		bench_print_range_pool("after", &pool, num_tables, num_failed);
+
+	free(sizes);
+	free(offsets);
+	pool.destroy(&allocator_malloc);
+}
+
+/******************************************************************************\
+*
+*  Output
+*
+\******************************************************************************/
+
+static void bench_printf(array_t<char>* out, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int length = vsnprintf(nullptr, 0, fmt, args);
+	va_end(args);
+
+	out->ensure_capacity(&allocator_malloc, out->length() + length + 1);
+	va_start(args, fmt);
+	vsnprintf(out->end(), length + 1, fmt, args);
+	va_end(args);
+	out->set_length(out->length() + length);
+}
+
+static void bench_write_csv(const bench_t* bench, array_t<char>* out)
+{
+	double ms_per_tick = 1000.0 / (double)time_frequency();
+	bench_printf(out, "storage,operation,entities,components,items,repeats,best_ms,mean_ms,best_ns_per_item\n");
+	for (size_t i = 0; i < bench->results.length(); ++i)
+	{
+		const bench_result_t* r = &bench->results[i];
+		double best = (double)r->best * ms_per_tick;
+		double mean = (double)r->total * ms_per_tick / r->repeats;
+		bench_printf(out, "%s,%s,%u,%u,%u,%u,%.4f,%.4f,%.2f\n", r->storage, r->operation, r->entities, r->components, r->items, r->repeats, best, mean, best * 1e6 / r->items);
+	}
+}
+
+static void bench_write_json(const bench_t* bench, array_t<char>* out)
+{
+	double ms_per_tick = 1000.0 / (double)time_frequency();
+	bench_printf(out, "[\n");
+	for (size_t i = 0; i < bench->results.length(); ++i)
+	{
+		const bench_result_t* r = &bench->results[i];
+		double best = (double)r->best * ms_per_tick;
+		double mean = (double)r->total * ms_per_tick / r->repeats;
+		bench_printf(out, "\t{ \"storage\": \"%s\", \"operation\": \"%s\", \"entities\": %u, \"components\": %u, \"items\": %u, \"repeats\": %u, \"best_ms\": %.4f, \"mean_ms\": %.4f, \"best_ns_per_item\": %.2f }%s\n",
+			r->storage, r->operation, r->entities, r->components, r->items, r->repeats, best, mean, best * 1e6 / r->items, i + 1 < bench->results.length() ? "," : "");
+	}
+	bench_printf(out, "]\n");
+}
+
+void print_help(getopt_context_t* ctx)
+{
+	char buffer[2048];
+	printf("usage: ecsbench [options]\n\n");
+	printf("%s", getopt_create_help_string(ctx, buffer, sizeof(buffer)));
+}
+
+int main(int argc, const char** argv)
+{
+	int json = 0;
+	int skip_arrays = 0;
+	int skip_archetypes = 0;
+	int skip_spatial = 0;
+	int skip_churn = 0;
+
+	static const getopt_option_t option_list[] =
+	{
+		{ "help",            'h', GETOPT_OPTION_TYPE_NO_ARG,   0x0,              'h', "displays this message", 0x0 },
+		{ "output",          'o', GETOPT_OPTION_TYPE_REQUIRED, 0x0,              'o', "output to file instead of stdout", "file" },
+		{ "json",            'j', GETOPT_OPTION_TYPE_FLAG_SET, &json,            1,   "output json instead of csv", 0x0 },
+		{ "min-entities",    'm', GETOPT_OPTION_TYPE_REQUIRED, 0x0,              'm', "smallest entity count, default 1000", "count" },
+		{ "max-entities",    'n', GETOPT_OPTION_TYPE_REQUIRED, 0x0,              'n', "largest entity count, default 1000000", "count" },
+		{ "max-components",  'c', GETOPT_OPTION_TYPE_REQUIRED, 0x0,              'c', "largest component count, default 16", "count" },
+		{ "repeats",         'r', GETOPT_OPTION_TYPE_REQUIRED, 0x0,              'r', "runs of each benchmark, default 3", "count" },
+		{ "threads",         't', GETOPT_OPTION_TYPE_REQUIRED, 0x0,              't', "job system threads, default 8", "count" },
+		{ "skip-arrays",     0,   GETOPT_OPTION_TYPE_FLAG_SET, &skip_arrays,     1,   "skip ECS_STORAGE_ARRAYS", 0x0 },
+		{ "skip-archetypes", 0,   GETOPT_OPTION_TYPE_FLAG_SET, &skip_archetypes, 1,   "skip ECS_STORAGE_ARCHETYPES", 0x0 },
+		{ "skip-spatial",    0,   GETOPT_OPTION_TYPE_FLAG_SET, &skip_spatial,    1,   "skip the spatial grid", 0x0 },
+		{ "skip-churn",      0,   GETOPT_OPTION_TYPE_FLAG_SET, &skip_churn,      1,   "skip the ECS and range pool churn", 0x0 },
+		GETOPT_OPTIONS_END
+	};
+
+	getopt_context_t go_ctx;
+	getopt_create_context(&go_ctx, argc, argv, option_list);
+
+	const char* outfilename = nullptr;
+	uint32_t min_entities = 1000;
+	uint32_t max_entities = 1000000;
+	uint32_t max_components = BENCH_MAX_COMPONENTS;
+	uint32_t repeats = 3;
+	uint32_t num_threads = 8;
+
+	int opt;
+	while( (opt = getopt_next( &go_ctx ) ) != -1 )
+	{
+		switch(opt)
+		{
+			case 'h': print_help(&go_ctx); return 0;
+			case 'o': outfilename = go_ctx.current_opt_arg; break;
+			case 'm': min_entities = (uint32_t)strtoul(go_ctx.current_opt_arg, nullptr, 10); break;
+			case 'n': max_entities = (uint32_t)strtoul(go_ctx.current_opt_arg, nullptr, 10); break;
+			case 'c': max_components = (uint32_t)strtoul(go_ctx.current_opt_arg, nullptr, 10); break;
+			case 'r': repeats = (uint32_t)strtoul(go_ctx.current_opt_arg, nullptr, 10); break;
+			case 't': num_threads = (uint32_t)strtoul(go_ctx.current_opt_arg, nullptr, 10); break;
+			case '+': ERROR_AND_FAIL("unexpected argument \"%s\"", go_ctx.current_opt_arg);
+			case '!': ERROR_AND_FAIL("invalid use of option \"%s\"", go_ctx.current_opt_arg);
+			case '?': ERROR_AND_FAIL("unknown option \"%s\"", go_ctx.current_opt_arg);
+			case 0: break; // ignore, flag was set!
+		}
+	}
+
+	if (min_entities == 0 || max_entities < min_entities || max_entities > ECS_ENTITY_INDEX_MASK + 1)
+		ERROR_AND_FAIL("entity counts have to be in 1..%u with min <= max", ECS_ENTITY_INDEX_MASK + 1);
+	if (max_components == 0 || max_components > BENCH_MAX_COMPONENTS)
+		ERROR_AND_FAIL("component count has to be in 1..%u", BENCH_MAX_COMPONENTS);
+	if (repeats == 0)
+		ERROR_AND_FAIL("at least one repeat is needed");
+
+	job_system_create_params_t job_system_create_params = {};
+	job_system_create_params.alloc = &allocator_malloc;
+	job_system_create_params.num_threads = (uint16_t)num_threads;
+	job_system_create_params.max_cached_functions = 16;
+	job_system_create_params.worker_thread_temp_size = 1024 * 1024;
+	job_system_create_params.max_job_argument_size = 256;
+	job_system_create_params.job_argument_alignment = 16;
+
+	bench_t bench;
+	memset(&bench, 0, sizeof(bench));
+	bench.job_system = job_system_create(&job_system_create_params);
+	job_system_get_num_workers(bench.job_system, &bench.num_workers);
+	bench.results.create(&allocator_malloc, 256);
+	bench.rng = 0x9E3779B97F4A7C15ULL;
+	bench.component_data = (bench_component_t*)malloc(max_entities * sizeof(bench_component_t));
+	bench.eids = (entity_id_t*)malloc(max_entities * sizeof(entity_id_t));
+	for (uint32_t i = 0; i < max_entities; ++i)
+	{
+		for (int a = 0; a < 4; ++a)
+			bench.component_data[i].v[a] = (float)i;
+	}
+
+	// Progress goes to stderr, so stdout only holds the results
+	for (uint32_t num_entities = min_entities; num_entities <= max_entities; num_entities = num_entities > max_entities / 10 ? max_entities + 1 : num_entities * 10)
+	{
+		for (uint32_t num_components = 1; num_components <= max_components; num_components *= 2)
+		{
+			for (uint32_t r = 0; r < repeats; ++r)
+			{
+				if (!skip_arrays)
+					bench_ecs_round(&bench, ECS_STORAGE_ARRAYS, "arrays", num_entities, num_components);
+				if (!skip_archetypes)
+					bench_ecs_round(&bench, ECS_STORAGE_ARCHETYPES, "archetypes", num_entities, num_components);
+			}
+			fprintf(stderr, "%u entities, %u components done\n", num_entities, num_components);
+		}
+
+		for (uint32_t r = 0; r < repeats && !skip_spatial; ++r)
+			bench_spatial_round(&bench, num_entities);
+
+		for (uint32_t r = 0; r < repeats && !skip_churn; ++r)
+		{
+			bench_ecs_churn_round(&bench, num_entities, r == 0);
+			bench_range_pool_round(&bench, num_entities, r == 0);
+		}
+	}
+
+	array_t<char> out;
+	out.create(&allocator_malloc, 64 * 1024);
+	if (json)
+		bench_write_json(&bench, &out);
+	else
+		bench_write_csv(&bench, &out);
+
+	if (outfilename != nullptr)
+	{
+		file_t* file = file_open(outfilename, FILE_MODE_WRITE);
+		if (file == nullptr)
+			ERROR_AND_FAIL("could not open \"%s\" for writing", outfilename);
+		file_write(file, out.begin(), out.length());
+		file_close(file);
+	}
+	else
+	{
+		fwrite(out.begin(), 1, out.length(), stdout);
+	}
+	out.destroy(&allocator_malloc);
+
+	free(bench.eids);
+	free(bench.component_data);
+	bench.results.destroy(&allocator_malloc);
+	job_system_destroy(bench.job_system);
+	return 0;
+}
@@ -1,8 +1,6 @@
 Unit:Using("application")
 Unit:Using("game")
 
-Unit:Using("glm")
-
 function Unit.Init(self)
 	self.executable = true
 	self.targetname = "ecstest"
@@ -4,20 +4,17 @@
 #include <foundation/array.h>
 #include <foundation/list.h>
 #include <foundation/cobjpool.h>
+#include <foundation/simd_math.h>
 #include <foundation/time.h>
-#include <game/ecs.h>
+#include <game/ecs_view.h>
 
 #if defined(FAMILY_WINDOWS)
 	#include <windows.h>
 #endif
 #include <stdint.h>
 
-#include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
 #include <algorithm>
+#include <cmath>
 
 struct allocation_instance_t : list_node_t<allocation_instance_t>
 {
@@ -137,62 +134,47 @@ struct render_component_t
 	float transform[16];
 };
 
-struct position_job_arg_t
-{
-	position_component_t* positions;
-	entity_id_t* eids;
-	uint32_t count;
-	float time;
-};
+typedef ecs_view_t<transform_t, position_component_t> position_view_t;
+typedef ecs_view_t<const position_component_t, render_component_t> render_view_t;
 
-void position_job_func(job_context_t* context, void* arg)
+void position_job_func(job_context_t* context, const ecs_query_batch_t* query_batch, void* user_data)
 {
-	position_job_arg_t* position_arg = (position_job_arg_t*)arg;
-	position_component_t* positions = position_arg->positions;
-	entity_id_t* eids = position_arg->eids;
-	(void)eids;
-	uint32_t count = position_arg->count;
-	float t = position_arg->time;
-
+	position_view_t::batch_t batch(*query_batch);
+	transform_soa_t transforms = transform_soa_from_fields(batch.fields<transform_t>(), batch.field_stride<transform_t>());
+	position_component_t* positions = batch.get<position_component_t>();
+	const entity_id_t* eids = batch.eids;
+	uint32_t count = batch.count;
+	float t = *(const float*)user_data;
+
+	// Rotation around x followed by rotation around y, as a quaternion
 	for (uint32_t i = 0; i < count; ++i)
 	{
-		float x = (float)(i % 100) - 50;
-		float y = (float)(i / 100) - 50;
-		glm::mat4x4 translation = glm::translate(glm::vec3(x, y, 0.0f));
-		glm::mat4x4 rotx = glm::rotate((x + t) * 0.01f, glm::vec3(1.0f, 0.0f, 0.0f));
-		glm::mat4x4 roty = glm::rotate((y + t) * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4x4 mat = translation * rotx * roty;
-		memcpy(positions[i].transform, glm::value_ptr(mat), sizeof(positions[i].transform));
+		float x = (float)(ecs_entity_index(eids[i]) % 100) - 50;
+		float y = (float)(ecs_entity_index(eids[i]) / 100) - 50;
+		float sx = sinf((x + t) * 0.005f);
+		float cx = cosf((x + t) * 0.005f);
+		float sy = sinf((y + t) * 0.005f);
+		float cy = cosf((y + t) * 0.005f);
+		transforms.px[i] = x;
+		transforms.py[i] = y;
+		transforms.qx[i] = sx * cy;
+		transforms.qy[i] = cx * sy;
+		transforms.qz[i] = sx * sy;
+		transforms.qw[i] = cx * cy;
 	}
-}
 
-struct render_job_arg_t
-{
-	ecs_t* ecs;
-	component_type_id_t position_type_id;
-	render_component_t* renders;
-	entity_id_t* eids;
-	uint32_t count;
-};
+	simd_transform_compose(&transforms, count, positions[0].transform);
+}
 
-void render_job_func(job_context_t* context, void* arg)
+void render_job_func(job_context_t* context, const ecs_query_batch_t* query_batch, void* user_data)
 {
-	render_job_arg_t* render_arg = (render_job_arg_t*)arg;
-	ecs_t* ecs = render_arg->ecs;
-	component_type_id_t position_type_id = render_arg->position_type_id;
-	render_component_t* renders = render_arg->renders;
-	entity_id_t* eids = render_arg->eids;
-	uint32_t count = render_arg->count;
+	render_view_t::batch_t batch(*query_batch);
+	const position_component_t* positions = batch.get<const position_component_t>();
+	render_component_t* renders = batch.get<render_component_t>();
+	uint32_t count = batch.count;
 
 	for (uint32_t i = 0; i < count; ++i)
-	{
-		query_result_t position_res = {};
-		ecs_result_t ecs_res = ecs_query_component(ecs, eids[i], position_type_id, &position_res); // TODO: batch get? also thread safe (work graph?)
-		ASSERT(ecs_res == ECS_RESULT_OK);
-		position_component_t* position = (position_component_t*)position_res.component_data;
-
-		memcpy(renders[i].transform, position->transform, sizeof(renders[i].transform));
-	}
+		memcpy(renders[i].transform, positions[i].transform, sizeof(renders[i].transform));
 }
 
 int application_main(application_t* application)
@@ -221,42 +203,75 @@ int application_main(application_t* application)
 
 	ecs_create_info_t ecs_create_info = {};
 	ecs_create_info.allocator = allocator;
+	ecs_create_info.storage = ECS_STORAGE_ARCHETYPES;
 	ecs_create_info.max_entities = NUM_ENTITIES;
-	ecs_create_info.max_component_types = 2;
+	ecs_create_info.max_component_types = 3;
+	ecs_create_info.max_archetypes = 16;
 	ecs_t* ecs = nullptr;
 	ecs_result_t ecs_res = ecs_create(&ecs_create_info, &ecs);
 	(void)ecs_res;
 
-	component_type_create_info_t position_component_create_info = {};
-	position_component_create_info.component_size = sizeof(position_component_t);
-	position_component_create_info.max_components = NUM_ENTITIES;
-	component_type_id_t position_type_id = {};
-	ecs_res = ecs_register_component_type(ecs, &position_component_create_info, &position_type_id);
+	ecs_res = ecs_register_component<transform_t>(ecs, NUM_ENTITIES, TRANSFORM_NUM_FIELDS);
+	ecs_res = ecs_register_component<position_component_t>(ecs, NUM_ENTITIES);
+	ecs_res = ecs_register_component<render_component_t>(ecs, NUM_ENTITIES);
+	component_type_id_t transform_type_id = ecs_component_id<transform_t>();
+	component_type_id_t position_type_id = ecs_component_id<position_component_t>();
+	component_type_id_t render_type_id = ecs_component_id<render_component_t>();
 
-	component_type_create_info_t render_component_create_info = {};
-	render_component_create_info.component_size = sizeof(render_component_t);
-	render_component_create_info.max_components = NUM_ENTITIES;
-	component_type_id_t render_type_id = {};
-	ecs_res = ecs_register_component_type(ecs, &render_component_create_info, &render_type_id);
+	transform_t transform_data = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+	position_component_t position_data = {};
+	render_component_t render_data = {};
 
-	entity_id_t entities[NUM_ENTITIES];
-	for (uint32_t i = 0; i < NUM_ENTITIES; ++i)
-	{
-		position_component_t position_data = {};
-		render_component_t render_data = {};
+	component_data_t component_data[3];
+	component_data[0].type = transform_type_id;
+	component_data[0].data = &transform_data;
+	component_data[1].type = position_type_id;
+	component_data[1].data = &position_data;
+	component_data[2].type = render_type_id;
+	component_data[2].data = &render_data;
 
-		component_data_t component_data[2];
-		component_data[0].type = position_type_id;
-		component_data[0].data = &position_data;
-		component_data[1].type = render_type_id;
-		component_data[1].data = &render_data;
+	entity_create_info_t entity_create_info = {};
+	entity_create_info.num_components = 3;
+	entity_create_info.component_datas = component_data;
 
-		entity_create_info_t entity_create_info = {};
-		entity_create_info.num_components = 2;
-		entity_create_info.component_datas = component_data;
+	ecs_prefab_t* prefab = nullptr;
+	ecs_res = ecs_prefab_create(ecs, &entity_create_info, &prefab);
 
-		ecs_res = ecs_entity_create(ecs, &entity_create_info, &entities[i]);
-	}
+	entity_id_t entities[NUM_ENTITIES];
+	ecs_res = ecs_prefab_instantiate(ecs, prefab, NUM_ENTITIES, entities);
+	ecs_prefab_destroy(ecs, prefab);
+
+	position_view_t position_view = {};
+	ecs_res = position_view.create(ecs);
+
+	render_view_t render_view = {};
+	ecs_res = render_view.create(ecs, 0, 1 << 0); // Only copy positions that moved
+
+	float t = 0.0f;
+
+	component_type_id_t position_system_writes[] = { transform_type_id, position_type_id };
+	ecs_system_create_info_t position_system_create_info = {};
+	position_system_create_info.name = "position";
+	position_system_create_info.num_writes = 2;
+	position_system_create_info.writes = position_system_writes;
+	position_system_create_info.query = position_view.query;
+	position_system_create_info.func = position_job_func;
+	position_system_create_info.user_data = &t;
+	position_system_create_info.max_jobs = job_system_create_params.num_threads;
+	ecs_system_id_t position_system_id = {};
+	ecs_res = ecs_system_register(ecs, &position_system_create_info, &position_system_id);
+
+	ecs_system_create_info_t render_system_create_info = {};
+	render_system_create_info.name = "render";
+	render_system_create_info.num_reads = 1;
+	render_system_create_info.reads = &position_type_id;
+	render_system_create_info.num_writes = 1;
+	render_system_create_info.writes = &render_type_id;
+	render_system_create_info.query = render_view.query;
+	render_system_create_info.func = render_job_func;
+	render_system_create_info.max_jobs = job_system_create_params.num_threads;
+	ecs_system_id_t render_system_id = {};
+	ecs_res = ecs_system_register(ecs, &render_system_create_info, &render_system_id);
 
 	uint64_t freq = time_frequency();
 	uint64_t start = time_current();
@@ -264,50 +279,17 @@ int application_main(application_t* application)
 	{
 		uint64_t curr = time_current();
 		uint64_t time = curr - start;
-		float t = (float)time / (float)freq;
+		t = (float)time / (float)freq;
 		application_update(application);
 
-		query_all_result_t position_res = {};
-		ecs_res = ecs_query_all_components(ecs, position_type_id, &position_res); // TODO: bake query into job (or job setup)
-
-		position_job_arg_t position_job_arg = {};
-		position_job_arg.positions = (position_component_t*)position_res.component_data;
-		position_job_arg.eids = position_res.eids;
-		position_job_arg.count = position_res.count;
-		position_job_arg.time = t;
-
-		job_event_t* positions_done = nullptr;
-		job_res = job_system_acquire_event(job_system, &positions_done);
-		ASSERT(job_res == JOB_SYSTEM_OK);
-		job_res = job_system_kick_ptr(job_system, position_job_func, 1, &position_job_arg, nullptr, positions_done);
-		ASSERT(job_res == JOB_SYSTEM_OK);
-
-		query_all_result_t render_res = {};
-		ecs_res = ecs_query_all_components(ecs, render_type_id, &render_res); // TODO: bake query into job (or job setup)
-
-		render_job_arg_t render_job_arg = {};
-		render_job_arg.ecs = ecs;
-		render_job_arg.position_type_id = position_type_id;
-		render_job_arg.renders = (render_component_t*)render_res.component_data;
-		render_job_arg.eids = render_res.eids;
-		render_job_arg.count = render_res.count;
-
-		job_event_t* render_done = nullptr;
-		job_res = job_system_acquire_event(job_system, &render_done);
-		ASSERT(job_res == JOB_SYSTEM_OK);
-		job_res = job_system_kick_ptr(job_system, render_job_func, 1, &render_job_arg, positions_done, render_done);
-		ASSERT(job_res == JOB_SYSTEM_OK);
-
-		job_res = job_system_wait_release_event(job_system, render_done);
-		ASSERT(job_res == JOB_SYSTEM_OK);
-		job_res = job_system_release_event(job_system, positions_done);
-		ASSERT(job_res == JOB_SYSTEM_OK);
+		ecs_res = ecs_systems_run(ecs, job_system);
+		ASSERT(ecs_res == ECS_RESULT_OK);
 	}
 	
-	for (uint32_t i = 0; i < NUM_ENTITIES; ++i)
-	{
-		ecs_entity_destroy(ecs, entities[i]);
-	}
+	render_view.destroy();
+	position_view.destroy();
+
+	ecs_entities_destroy_batch(ecs, entities, NUM_ENTITIES);
 
 	ecs_destroy(ecs);
 
@@ -0,0 +1,401 @@
+#include "unittest.h"
+
+#include <foundation/allocator.h>
+#include <foundation/job_system.h>
+#include <foundation/simd_math.h>
+#include <game/ecs.h>
+
+#define ECS_TEST_ENTITIES (100)
+
+static const char* ecs_test_storage_name(ecs_storage_t storage)
+{
+	return storage == ECS_STORAGE_ARCHETYPES ? "archetypes" : "arrays";
+}
+
+static ecs_t* ecs_test_create(ecs_storage_t storage)
+{
+	ecs_create_info_t create_info = {};
+	create_info.allocator = &allocator_malloc;
+	create_info.storage = storage;
+	create_info.max_entities = 1024;
+	create_info.max_component_types = 8;
+	create_info.max_archetypes = 64;
+
+	ecs_t* ecs;
+	ecs_create(&create_info, &ecs);
+	return ecs;
+}
+
+static component_type_id_t ecs_test_register(ecs_t* ecs, uint32_t component_size, bool shared)
+{
+	component_type_create_info_t create_info = {};
+	create_info.component_size = component_size;
+	create_info.shared = shared;
+
+	component_type_id_t ctid;
+	ecs_register_component_type(ecs, &create_info, &ctid);
+	return ctid;
+}
+
+static uint32_t ecs_test_value(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid)
+{
+	query_result_t result;
+	if (ecs_query_component(ecs, eid, ctid, &result) != ECS_RESULT_OK)
+		return UINT32_MAX;
+	return *(const uint32_t*)result.component_data;
+}
+
+/**
+ * Dead and repeated ids in a batch destroy are skipped, the other entities keep their components.
+ */
+static void test_ecs_destroy_batch_dead_ids(ecs_storage_t storage)
+{
+	const char* name = ecs_test_storage_name(storage);
+	ecs_t* ecs = ecs_test_create(storage);
+	component_type_id_t value_type = ecs_test_register(ecs, sizeof(uint32_t), false);
+	component_type_id_t group_type = ecs_test_register(ecs, sizeof(uint32_t), storage == ECS_STORAGE_ARCHETYPES);
+
+	uint32_t values[ECS_TEST_ENTITIES];
+	uint32_t groups[ECS_TEST_ENTITIES];
+	for (uint32_t i = 0; i < ECS_TEST_ENTITIES; ++i)
+	{
+		values[i] = i;
+		groups[i] = i % 3;
+	}
+	component_data_t component_datas[] = { { value_type, values }, { group_type, groups } };
+	entity_create_info_t create_info = { 2, component_datas };
+	entity_id_t eids[ECS_TEST_ENTITIES];
+	ecs_entities_create_batch(ecs, &create_info, ECS_TEST_ENTITIES, eids);
+
+	ecs_entity_destroy(ecs, eids[5]);
+	entity_id_t batch[] = { eids[0], eids[0], eids[5], eids[1], eids[9], eids[2], eids[1], eids[9] };
+	ecs_result_t result = ecs_entities_destroy_batch(ecs, batch, sizeof(batch) / sizeof(batch[0]));
+	TEST_CHECK(result == ECS_RESULT_NO_SUCH_ENTITY, "%s: destroying dead ids returned %d", name, (int)result);
+
+	// Reuses the freed indices, each must have been freed once only
+	entity_id_t reused[5];
+	ecs_entities_create_batch(ecs, &create_info, 5, reused);
+	for (uint32_t i = 0; i < 5; ++i)
+		for (uint32_t j = 0; j < i; ++j)
+			TEST_CHECK(reused[i].id != reused[j].id, "%s: id 0x%x handed out twice", name, reused[i].id);
+
+	for (uint32_t i = 0; i < ECS_TEST_ENTITIES; ++i)
+	{
+		bool destroyed = i == 0 || i == 1 || i == 2 || i == 5 || i == 9;
+		TEST_CHECK(ecs_entity_is_alive(ecs, eids[i]) != destroyed, "%s: entity %u %s", name, i, destroyed ? "still alive" : "destroyed");
+		if (destroyed)
+			continue;
+		TEST_CHECK(ecs_test_value(ecs, eids[i], value_type) == i, "%s: entity %u has value %u", name, i, ecs_test_value(ecs, eids[i], value_type));
+		TEST_CHECK(ecs_test_value(ecs, eids[i], group_type) == i % 3, "%s: entity %u has group %u", name, i, ecs_test_value(ecs, eids[i], group_type));
+	}
+	for (uint32_t i = 0; i < 5; ++i)
+		TEST_CHECK(ecs_test_value(ecs, reused[i], value_type) == i, "%s: new entity %u has value %u", name, i, ecs_test_value(ecs, reused[i], value_type));
+
+	ecs_entities_destroy_batch(ecs, eids, ECS_TEST_ENTITIES);
+	ecs_entities_destroy_batch(ecs, reused, 5);
+	ecs_destroy(ecs);
+}
+
+void test_ecs_destroy_batch_dead_ids()
+{
+	test_ecs_destroy_batch_dead_ids(ECS_STORAGE_ARRAYS);
+	test_ecs_destroy_batch_dead_ids(ECS_STORAGE_ARCHETYPES);
+}
+
+/**
+ * Commands of stream 0 are played back before the create in stream 1, they must not touch any entity.
+ */
+static void test_ecs_command_before_create(ecs_storage_t storage)
+{
+	const char* name = ecs_test_storage_name(storage);
+	ecs_t* ecs = ecs_test_create(storage);
+	component_type_id_t value_type = ecs_test_register(ecs, sizeof(uint32_t), false);
+	component_type_id_t other_type = ecs_test_register(ecs, sizeof(uint32_t), false);
+
+	uint32_t values[ECS_TEST_ENTITIES];
+	for (uint32_t i = 0; i < ECS_TEST_ENTITIES; ++i)
+		values[i] = i;
+	component_data_t component_data = { value_type, values };
+	entity_create_info_t create_info = { 1, &component_data };
+	entity_id_t eids[ECS_TEST_ENTITIES];
+	ecs_entities_create_batch(ecs, &create_info, ECS_TEST_ENTITIES, eids);
+
+	ecs_command_buffer_create_info_t buffer_info = { 2, 4096, 4 };
+	ecs_command_buffer_t* buffer;
+	ecs_command_buffer_create(ecs, &buffer_info, &buffer);
+
+	uint32_t created_value = 1000;
+	component_data_t created_data = { value_type, &created_value };
+	entity_create_info_t created_info = { 1, &created_data };
+	entity_id_t created;
+	ecs_command_create_entity(buffer, 1, &created_info, &created);
+
+	uint32_t other_value = 2000;
+	component_data_t other_data = { other_type, &other_value };
+	ecs_command_add_component(buffer, 0, created, &other_data);
+	ecs_command_remove_component(buffer, 0, created, value_type);
+	ecs_command_destroy_entity(buffer, 0, created);
+
+	TEST_CHECK(!ecs_entity_is_alive(ecs, created), "%s: reserved id alive before playback", name);
+	TEST_CHECK(ecs_entity_destroy(ecs, created) == ECS_RESULT_NO_SUCH_ENTITY, "%s: destroyed a reserved id", name);
+	TEST_CHECK(ecs_entity_add_component(ecs, created, &other_data) == ECS_RESULT_NO_SUCH_ENTITY, "%s: added a component to a reserved id", name);
+
+	ecs_command_buffer_playback(ecs, buffer);
+
+	TEST_CHECK(ecs_entity_is_alive(ecs, created), "%s: created entity not alive after playback", name);
+	TEST_CHECK(ecs_test_value(ecs, created, value_type) == created_value, "%s: created entity has value %u", name, ecs_test_value(ecs, created, value_type));
+	TEST_CHECK(ecs_test_value(ecs, created, other_type) == UINT32_MAX, "%s: component added before the create was played back", name);
+	for (uint32_t i = 0; i < ECS_TEST_ENTITIES; ++i)
+	{
+		TEST_CHECK(ecs_entity_is_alive(ecs, eids[i]), "%s: entity %u destroyed", name, i);
+		TEST_CHECK(ecs_test_value(ecs, eids[i], value_type) == i, "%s: entity %u has value %u", name, i, ecs_test_value(ecs, eids[i], value_type));
+	}
+
+	ecs_entities_destroy_batch(ecs, eids, ECS_TEST_ENTITIES);
+	ecs_entity_destroy(ecs, created);
+	ecs_command_buffer_destroy(ecs, buffer);
+	ecs_destroy(ecs);
+}
+
+void test_ecs_command_before_create()
+{
+	test_ecs_command_before_create(ECS_STORAGE_ARRAYS);
+	test_ecs_command_before_create(ECS_STORAGE_ARCHETYPES);
+}
+
+static bool ecs_test_world_at(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, float x, float y, float z)
+{
+	const float* world;
+	if (ecs_hierarchy_get_world(ecs, hierarchy, eid, &world) != ECS_RESULT_OK)
+		return false;
+	return world[12] == x && world[13] == y && world[14] == z;
+}
+
+/**
+ * A child destroyed without being removed leaves its node behind, the entity reusing its index must not see it.
+ */
+void test_ecs_hierarchy_reused_index()
+{
+	ecs_t* ecs = ecs_test_create(ECS_STORAGE_ARCHETYPES);
+	ecs_hierarchy_create_info_t hierarchy_info = { 16, 0 };
+	ecs_hierarchy_t* hierarchy;
+	ecs_hierarchy_create(ecs, &hierarchy_info, &hierarchy);
+
+	entity_create_info_t create_info = { 0, nullptr };
+	entity_id_t parent, child, grandchild;
+	ecs_entity_create(ecs, &create_info, &parent);
+	ecs_entity_create(ecs, &create_info, &child);
+	ecs_entity_create(ecs, &create_info, &grandchild);
+
+	entity_id_t none = { 0 };
+	transform_t parent_local = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+	transform_t child_local = { { 0.0f, 2.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+	transform_t grandchild_local = { { 0.0f, 0.0f, 4.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+	ecs_hierarchy_add(ecs, hierarchy, parent, none, &parent_local);
+	ecs_hierarchy_add(ecs, hierarchy, child, parent, &child_local);
+	ecs_hierarchy_add(ecs, hierarchy, grandchild, child, &grandchild_local);
+	ecs_hierarchy_update(ecs, hierarchy, nullptr);
+	TEST_CHECK(ecs_test_world_at(ecs, hierarchy, grandchild, 1.0f, 2.0f, 4.0f), "grandchild not composed with its parents");
+
+	ecs_entity_destroy(ecs, child);
+	entity_id_t reused;
+	ecs_entity_create(ecs, &create_info, &reused);
+	TEST_CHECK(ecs_entity_index(reused) == ecs_entity_index(child), "index 0x%x not reused", ecs_entity_index(child));
+
+	const float* world;
+	ecs_result_t result = ecs_hierarchy_get_world(ecs, hierarchy, reused, &world);
+	TEST_CHECK(result == ECS_RESULT_NO_SUCH_COMPONENT, "stale node found for the reused index, result %d", (int)result);
+	result = ecs_hierarchy_remove(ecs, hierarchy, reused);
+	TEST_CHECK(result == ECS_RESULT_NO_SUCH_COMPONENT, "stale node removed through the reused index, result %d", (int)result);
+
+	// Adding drops the stale node, its child becomes a root
+	transform_t reused_local = { { 0.0f, 0.0f, 8.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+	result = ecs_hierarchy_add(ecs, hierarchy, reused, none, &reused_local);
+	TEST_CHECK(result == ECS_RESULT_OK, "adding the entity reusing the index returned %d", (int)result);
+	ecs_hierarchy_update(ecs, hierarchy, nullptr);
+	TEST_CHECK(ecs_test_world_at(ecs, hierarchy, reused, 0.0f, 0.0f, 8.0f), "entity reusing the index has a stale world matrix");
+	TEST_CHECK(ecs_test_world_at(ecs, hierarchy, grandchild, 0.0f, 0.0f, 4.0f), "child of the stale node did not become a root");
+	TEST_CHECK(ecs_test_world_at(ecs, hierarchy, parent, 1.0f, 0.0f, 0.0f), "parent of the stale node changed");
+
+	TEST_CHECK(ecs_hierarchy_remove(ecs, hierarchy, reused) == ECS_RESULT_OK, "removing the entity reusing the index failed");
+	TEST_CHECK(ecs_hierarchy_remove(ecs, hierarchy, grandchild) == ECS_RESULT_OK, "removing the grandchild failed");
+	TEST_CHECK(ecs_hierarchy_remove(ecs, hierarchy, parent) == ECS_RESULT_OK, "removing the parent failed");
+
+	ecs_entity_destroy(ecs, parent);
+	ecs_entity_destroy(ecs, reused);
+	ecs_entity_destroy(ecs, grandchild);
+	ecs_hierarchy_destroy(ecs, hierarchy);
+	ecs_destroy(ecs);
+}
+
+struct ecs_test_defrag_keys_t
+{
+	component_type_id_t value_type;
+	uint32_t num_calls;
+};
+
+static uint64_t ecs_test_defrag_key(ecs_t* ecs, entity_id_t eid, void* user_data)
+{
+	ecs_test_defrag_keys_t* keys = (ecs_test_defrag_keys_t*)user_data;
+	++keys->num_calls;
+	return ecs_test_value(ecs, eid, keys->value_type);
+}
+
+/**
+ * Building the order of a table is spread over calls, no call collects more keys than its budget.
+ */
+static void test_ecs_defrag_budget(ecs_storage_t storage)
+{
+	const char* name = ecs_test_storage_name(storage);
+	ecs_t* ecs = ecs_test_create(storage);
+	ecs_test_defrag_keys_t keys = { ecs_test_register(ecs, sizeof(uint32_t), false), 0 };
+
+	const uint32_t num_entities = 1000;
+	uint32_t values[1000];
+	unittest_rng_t rng = { 0x9e3779b97f4a7c15ULL };
+	for (uint32_t i = 0; i < num_entities; ++i)
+		values[i] = unittest_rand(&rng) % 5000;
+	component_data_t component_data = { keys.value_type, values };
+	entity_create_info_t create_info = { 1, &component_data };
+	entity_id_t eids[1000];
+	ecs_entities_create_batch(ecs, &create_info, num_entities, eids);
+
+	ecs_defrag_info_t defrag_info = { 16, ecs_test_defrag_key, &keys };
+	uint32_t num_steps = 0;
+	for (bool done = false; !done && num_steps < 10000; ++num_steps)
+	{
+		keys.num_calls = 0;
+		ecs_defragment(ecs, &defrag_info, &done);
+		TEST_CHECK(keys.num_calls <= defrag_info.max_rows, "%s: step %u collected %u keys", name, num_steps, keys.num_calls);
+	}
+	TEST_CHECK(num_steps < 10000, "%s: defragmenting never finished", name);
+
+	for (uint32_t i = 0; i < num_entities; ++i)
+		TEST_CHECK(ecs_test_value(ecs, eids[i], keys.value_type) == values[i], "%s: entity %u has value %u", name, i, ecs_test_value(ecs, eids[i], keys.value_type));
+
+	ecs_query_create_info_t query_info = {};
+	query_info.num_with = 1;
+	query_info.with = &keys.value_type;
+	ecs_query_t* query;
+	ecs_query_create(ecs, &query_info, &query);
+	ecs_query_iter_t iter;
+	ecs_query_batch_t batch;
+	uint32_t num_rows = 0;
+	uint32_t prev = 0;
+	ecs_query_iter_begin(ecs, query, &iter);
+	while (ecs_query_iter_next(&iter, &batch))
+	{
+		for (uint32_t i = 0; i < batch.count; ++i, ++num_rows)
+		{
+			uint32_t value = ((const uint32_t*)batch.components[0])[i];
+			TEST_CHECK(value >= prev, "%s: row %u has value %u after %u", name, num_rows, value, prev);
+			prev = value;
+		}
+	}
+	TEST_CHECK(num_rows == num_entities, "%s: iterated %u rows", name, num_rows);
+
+	ecs_query_destroy(ecs, query);
+	ecs_entities_destroy_batch(ecs, eids, num_entities);
+	ecs_destroy(ecs);
+}
+
+void test_ecs_defrag_budget()
+{
+	test_ecs_defrag_budget(ECS_STORAGE_ARRAYS);
+	test_ecs_defrag_budget(ECS_STORAGE_ARCHETYPES);
+}
+
+struct ecs_test_observed_t
+{
+	uint32_t num_changed;
+	uint32_t num_added;
+};
+
+static void ecs_test_observe(ecs_t* /*ecs*/, ecs_observer_event_t event, const entity_id_t* /*eids*/, uint32_t count, void* user_data)
+{
+	ecs_test_observed_t* observed = (ecs_test_observed_t*)user_data;
+	if (event == ECS_OBSERVER_EVENT_CHANGE)
+		observed->num_changed += count;
+	else if (event == ECS_OBSERVER_EVENT_ADD)
+		observed->num_added += count;
+}
+
+static void ecs_test_write_job(job_context_t* /*context*/, const ecs_query_batch_t* batch, void* /*user_data*/)
+{
+	uint32_t* values = (uint32_t*)batch->components[0];
+	for (uint32_t i = 0; i < batch->count; ++i)
+		values[i] += 1;
+}
+
+/**
+ * A system writing from several jobs reports every entity it wrote as changed, once.
+ */
+static void test_ecs_system_observe_writes(ecs_storage_t storage, job_system_t* job_system)
+{
+	const char* name = ecs_test_storage_name(storage);
+	ecs_t* ecs = ecs_test_create(storage);
+	component_type_id_t value_type = ecs_test_register(ecs, sizeof(uint32_t), false);
+
+	const uint32_t num_entities = 1000;
+	uint32_t values[1000] = {};
+	component_data_t component_data = { value_type, values };
+	entity_create_info_t create_info = { 1, &component_data };
+	entity_id_t eids[1000];
+	ecs_entities_create_batch(ecs, &create_info, num_entities, eids);
+
+	ecs_test_observed_t observed = { 0, 0 };
+	ecs_observer_create_info_t observer_info = { value_type, ECS_OBSERVER_EVENT_ADD | ECS_OBSERVER_EVENT_CHANGE, ecs_test_observe, &observed };
+	ecs_observer_t* observer;
+	ecs_observer_create(ecs, &observer_info, &observer);
+	ecs_observers_flush(ecs);
+	TEST_CHECK(observed.num_added == num_entities, "%s: %u entities reported as added", name, observed.num_added);
+
+	ecs_query_create_info_t query_info = {};
+	query_info.num_with = 1;
+	query_info.with = &value_type;
+	query_info.batch_size = 16;
+	ecs_query_t* query;
+	ecs_query_create(ecs, &query_info, &query);
+
+	ecs_system_create_info_t system_info = {};
+	system_info.name = "write";
+	system_info.num_writes = 1;
+	system_info.writes = &value_type;
+	system_info.query = query;
+	system_info.func = ecs_test_write_job;
+	system_info.max_jobs = 8;
+	ecs_system_id_t system;
+	ecs_system_register(ecs, &system_info, &system);
+
+	for (uint32_t frame = 1; frame <= 3; ++frame)
+	{
+		observed.num_changed = 0;
+		ecs_systems_run(ecs, job_system);
+		ecs_observers_flush(ecs);
+		TEST_CHECK(observed.num_changed == num_entities, "%s: frame %u reported %u changes", name, frame, observed.num_changed);
+	}
+	for (uint32_t i = 0; i < num_entities; ++i)
+		TEST_CHECK(ecs_test_value(ecs, eids[i], value_type) == 3, "%s: entity %u has value %u", name, i, ecs_test_value(ecs, eids[i], value_type));
+
+	ecs_observer_destroy(ecs, observer);
+	ecs_entities_destroy_batch(ecs, eids, num_entities);
+	ecs_query_destroy(ecs, query);
+	ecs_destroy(ecs);
+}
+
+void test_ecs_system_observe_writes()
+{
+	job_system_create_params_t params = {};
+	params.alloc = &allocator_malloc;
+	params.num_threads = 4;
+	params.max_cached_functions = 16;
+	params.worker_thread_temp_size = 64 * 1024;
+	params.max_job_argument_size = 256;
+	params.job_argument_alignment = 16;
+	job_system_t* job_system = job_system_create(&params);
+
+	test_ecs_system_observe_writes(ECS_STORAGE_ARRAYS, job_system);
+	test_ecs_system_observe_writes(ECS_STORAGE_ARCHETYPES, job_system);
+
+	job_system_destroy(job_system);
+}
@@ -0,0 +1,141 @@
+#include "unittest.h"
+
+#include <foundation/allocator.h>
+#include <foundation/range_pool.h>
+
+#include <string.h>
+
+#define RANGE_POOL_TEST_IDS (4096)
+#define RANGE_POOL_TEST_STEPS (20000)
+
+struct range_pool_test_t
+{
+	range_pool_t<uint32_t> pool;
+	uint32_t num_live;
+	uint32_t live_offsets[RANGE_POOL_TEST_IDS];
+	uint32_t live_counts[RANGE_POOL_TEST_IDS];
+	uint32_t live_ids; // Sum of live_counts
+	uint8_t owner[RANGE_POOL_TEST_IDS]; // 1 for ids in a live allocation, 2 for ids in a free range while checking
+};
+
+/**
+ * Walks every free list and checks it against the live allocations: free ranges
+ * are coalesced, sit in the class of their size, do not overlap each other or
+ * a live allocation and together with the live allocations cover every id.
+ */
+static void range_pool_test_check(range_pool_test_t* test)
+{
+	typedef range_pool_t<uint32_t> pool_t;
+	const pool_t& pool = test->pool;
+
+	TEST_CHECK(pool.num_free() + test->live_ids == pool.num_ids(), "%u free and %u live ids of %u", pool.num_free(), test->live_ids, pool.num_ids());
+
+	uint32_t free_ids = 0;
+	for (uint32_t fl = 0; fl < pool_t::FL_COUNT; ++fl)
+	{
+		for (uint32_t sl = 0; sl < pool_t::SL_COUNT; ++sl)
+		{
+			uint32_t head = pool._heads[fl][sl];
+			bool sl_bit = (pool._sl_bitmap[fl] & (1U << sl)) != 0;
+			TEST_CHECK(sl_bit == (head != pool_t::invalid()), "class %u/%u bitmap does not match its list", fl, sl);
+
+			uint32_t prev = pool_t::invalid();
+			for (uint32_t begin = head; begin != pool_t::invalid(); begin = pool._next[begin])
+			{
+				uint32_t size = pool._size[begin];
+				TEST_CHECK(size > 0 && begin + size <= pool.num_ids(), "free range %u+%u outside of pool", begin, size);
+				if (size == 0 || begin + size > pool.num_ids())
+					return;
+
+				uint32_t range_fl, range_sl;
+				pool_t::mapping(size, &range_fl, &range_sl);
+				TEST_CHECK(range_fl == fl && range_sl == sl, "free range %u+%u in class %u/%u instead of %u/%u", begin, size, fl, sl, range_fl, range_sl);
+				TEST_CHECK(pool._prev[begin] == prev, "free range %u has a broken prev link", begin);
+				TEST_CHECK(pool._tail_to_begin[begin + size - 1] == begin, "free range %u+%u has a broken tail", begin, size);
+				TEST_CHECK(begin + size == pool.num_ids() || pool._size[begin + size] == 0, "free range %u+%u not merged with the next one", begin, size);
+
+				for (uint32_t id = begin; id < begin + size; ++id)
+				{
+					TEST_CHECK(test->owner[id] == 0, "id %u in free range %u+%u is %s", id, begin, size, test->owner[id] == 1 ? "allocated" : "in another free range");
+					test->owner[id] = 2;
+				}
+				free_ids += size;
+				prev = begin;
+			}
+		}
+		bool fl_bit = (pool._fl_bitmap & (1ULL << fl)) != 0;
+		TEST_CHECK(fl_bit == (pool._sl_bitmap[fl] != 0), "first level %u bitmap does not match its classes", fl);
+	}
+
+	TEST_CHECK(free_ids == pool.num_free(), "free lists hold %u ids, num_free is %u", free_ids, pool.num_free());
+	for (uint32_t id = 0; id < pool.num_ids(); ++id)
+	{
+		TEST_CHECK(test->owner[id] != 0, "id %u neither allocated nor free", id);
+		test->owner[id] = test->owner[id] == 2 ? 0 : test->owner[id];
+	}
+}
+
+static void range_pool_test_free(range_pool_test_t* test, uint32_t index)
+{
+	uint32_t offset = test->live_offsets[index];
+	uint32_t count = test->live_counts[index];
+	test->pool.free(offset, count);
+	for (uint32_t id = offset; id < offset + count; ++id)
+		test->owner[id] = 0;
+
+	test->live_ids -= count;
+	--test->num_live;
+	test->live_offsets[index] = test->live_offsets[test->num_live];
+	test->live_counts[index] = test->live_counts[test->num_live];
+}
+
+void test_range_pool_churn()
+{
+	range_pool_test_t* test = ALLOCATOR_ALLOC_TYPE(&allocator_malloc, range_pool_test_t);
+	memset(test, 0, sizeof(*test));
+	test->pool.create(&allocator_malloc, RANGE_POOL_TEST_IDS);
+
+	unittest_rng_t rng = { 0x9e3779b97f4a7c15ULL };
+	for (uint32_t step = 0; step < RANGE_POOL_TEST_STEPS; ++step)
+	{
+		// Mostly small ranges with the odd large one, freeing a bit more often than allocating once the pool fills up
+		uint32_t count = unittest_rand(&rng) % 16 == 0 ? 1 + unittest_rand(&rng) % 512 : 1 + unittest_rand(&rng) % 32;
+		bool do_free = test->num_live > 0 && (unittest_rand(&rng) % 100 < 45 || test->pool.find_free(count) == test->pool.invalid());
+
+		if (do_free)
+			range_pool_test_free(test, unittest_rand(&rng) % test->num_live);
+		else
+		{
+			uint32_t offset = test->pool.alloc(count);
+			TEST_CHECK(offset + count <= RANGE_POOL_TEST_IDS, "range %u+%u outside of pool", offset, count);
+			if (offset + count > RANGE_POOL_TEST_IDS)
+				break;
+
+			for (uint32_t id = offset; id < offset + count; ++id)
+			{
+				TEST_CHECK(test->owner[id] == 0, "range %u+%u overlaps a live allocation at id %u", offset, count, id);
+				test->owner[id] = 1;
+			}
+			test->live_offsets[test->num_live] = offset;
+			test->live_counts[test->num_live] = count;
+			test->live_ids += count;
+			++test->num_live;
+		}
+
+		if (step % 64 == 0)
+			range_pool_test_check(test);
+	}
+	range_pool_test_check(test);
+
+	while (test->num_live > 0)
+		range_pool_test_free(test, unittest_rand(&rng) % test->num_live);
+	range_pool_test_check(test);
+
+	uint32_t num_ranges, largest;
+	test->pool.free_ranges(&num_ranges, &largest);
+	TEST_CHECK(num_ranges == 1 && largest == RANGE_POOL_TEST_IDS, "%u free ranges, largest %u, after freeing everything", num_ranges, largest);
+	TEST_CHECK(test->pool.num_free() == RANGE_POOL_TEST_IDS, "%u free ids after freeing everything", test->pool.num_free());
+
+	test->pool.destroy(&allocator_malloc);
+	ALLOCATOR_FREE(&allocator_malloc, test);
+}
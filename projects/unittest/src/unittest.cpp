@@ -0,0 +1,44 @@
+#include "unittest.h"
+
+#include <string.h>
+
+uint32_t unittest_num_failed_checks = 0;
+
+struct unittest_t
+{
+	const char* name;
+	void (*func)();
+};
+
+static const unittest_t unittests[] =
+{
+	{ "range_pool_churn", test_range_pool_churn },
+	{ "ecs_destroy_batch_dead_ids", test_ecs_destroy_batch_dead_ids },
+	{ "ecs_command_before_create", test_ecs_command_before_create },
+	{ "ecs_hierarchy_reused_index", test_ecs_hierarchy_reused_index },
+	{ "ecs_defrag_budget", test_ecs_defrag_budget },
+	{ "ecs_system_observe_writes", test_ecs_system_observe_writes },
+};
+
+/**
+ * Runs all tests, or only the ones named on the command line, and returns the number of failed tests.
+ */
+int main(int argc, const char** argv)
+{
+	int num_failed = 0;
+	for (size_t i = 0; i < sizeof(unittests) / sizeof(unittests[0]); ++i)
+	{
+		bool selected = argc < 2;
+		for (int arg = 1; arg < argc; ++arg)
+			selected |= strcmp(argv[arg], unittests[i].name) == 0;
+		if (!selected)
+			continue;
+
+		uint32_t num_failed_checks = unittest_num_failed_checks;
+		unittests[i].func();
+		bool passed = unittest_num_failed_checks == num_failed_checks;
+		printf("%-32s %s\n", unittests[i].name, passed ? "ok" : "FAILED");
+		num_failed += passed ? 0 : 1;
+	}
+	return num_failed;
+}
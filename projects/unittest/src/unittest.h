@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Minimal test runner, every test is a function registered in unittest.cpp.
+ * A failed check reports to stderr and fails the test but keeps it running.
+ */
+extern uint32_t unittest_num_failed_checks;
+
+#define TEST_CHECK(cond, fmt, ...) \
+	do { \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s(%d): check failed: %s, " fmt "\n", __FILE__, __LINE__, #cond, ##__VA_ARGS__); \
+			++unittest_num_failed_checks; \
+		} \
+	} while (0)
+
+struct unittest_rng_t
+{
+	uint64_t state;
+};
+
+static inline uint32_t unittest_rand(unittest_rng_t* rng)
+{
+	// xorshift64*, the same sequence on every platform
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return (uint32_t)((rng->state * 2685821657736338717ULL) >> 32);
+}
+
+void test_range_pool_churn();
+void test_ecs_destroy_batch_dead_ids();
+void test_ecs_command_before_create();
+void test_ecs_hierarchy_reused_index();
+void test_ecs_defrag_budget();
+void test_ecs_system_observe_writes();
@@ -0,0 +1,15 @@
+Unit:Using("foundation")
+Unit:Using("game")
+
+function Unit.Init(self)
+	self.executable = true
+	self.targetname = "unittest"
+end
+
+function Unit.Build(self)
+	local common_src = Collect(self.path .. "/src/*.cpp")
+	local common_obj = Compile(self.settings, common_src)
+
+	local bin = Link(self.settings, self.targetname, common_obj)
+	self:AddProduct(bin)
+end
@@ -90,7 +90,7 @@ void material_register_creator(resource_context_t* resource_context)
 		material_destroy,
 		&allocator_malloc,
 		resource_context,
-		hash_string("material")
+		hash_string_64("material")
 	};
 	resource_cache_add_creator(resource_context->resource_cache, &material_creator);
 }
@@ -64,7 +64,7 @@ void mesh_register_creator(resource_context_t* resource_context)
 		mesh_destroy,
 		&allocator_malloc,
 		resource_context,
-		hash_string("mesh")
+		hash_string_64("mesh")
 	};
 	resource_cache_add_creator(resource_context->resource_cache, &mesh_creator);
 }
@@ -0,0 +1,118 @@
+#include "render_bridge.h"
+
+#include <foundation/allocator.h>
+#include <foundation/array.h>
+#include <foundation/assert.h>
+#include <foundation/simd_math.h>
+
+#include <cstring>
+
+static_assert(sizeof(render_component_t) == sizeof(render_instance_id_t), "Render components are passed on as instance ids");
+static_assert(sizeof(render_instance_data_t) == 16 * sizeof(float), "Instance data has to be a single matrix");
+
+struct render_bridge_t
+{
+	allocator_t* allocator;
+	ecs_t* ecs;
+	render_t* render;
+	component_type_id_t transform_type;
+	component_type_id_t render_type;
+	ecs_query_t* query;
+	uint64_t last_version; // Transforms changed after this have not been written
+
+	// Instance data of the current batch
+	array_t<render_instance_data_t*> mapped;
+	array_t<float*> matrices;
+};
+
+render_bridge_t* render_bridge_create(const render_bridge_create_info_t* create_info)
+{
+	render_bridge_t* bridge = ALLOCATOR_ALLOC_TYPE(create_info->allocator, render_bridge_t);
+	memset(bridge, 0, sizeof(render_bridge_t));
+	bridge->allocator = create_info->allocator;
+	bridge->ecs = create_info->ecs;
+	bridge->render = create_info->render;
+	bridge->transform_type = create_info->transform_type;
+	bridge->render_type = create_info->render_type;
+
+	component_type_id_t with[] = { create_info->transform_type, create_info->render_type };
+	ecs_query_create_info_t query_create_info = {};
+	query_create_info.num_with = 2;
+	query_create_info.with = with;
+	query_create_info.changed_mask = 1 << 0;
+	ecs_result_t res = ecs_query_create(bridge->ecs, &query_create_info, &bridge->query);
+	ASSERT(res == ECS_RESULT_OK, "failed to create render bridge query");
+	(void)res;
+
+	bridge->mapped.create(bridge->allocator, 0);
+	bridge->matrices.create(bridge->allocator, 0);
+	return bridge;
+}
+
+void render_bridge_destroy(render_bridge_t* bridge)
+{
+	bridge->mapped.destroy(bridge->allocator);
+	bridge->matrices.destroy(bridge->allocator);
+	ecs_query_destroy(bridge->ecs, bridge->query);
+	ALLOCATOR_FREE(bridge->allocator, bridge);
+}
+
+render_result_t render_bridge_attach(render_bridge_t* bridge, entity_id_t eid, render_mesh_id_t mesh_id, render_material_id_t material_id)
+{
+	render_instance_create_info_t instance_create_info;
+	memset(&instance_create_info, 0, sizeof(instance_create_info));
+	instance_create_info.mesh_id = mesh_id;
+	instance_create_info.material_id = material_id;
+
+	render_component_t component;
+	render_result_t res = render_instance_create(bridge->render, &instance_create_info, &component.instance_id);
+	if (res != RENDER_RESULT_OK)
+		return res;
+
+	// The transform moves to a new archetype and counts as changed, so the next update fills in the instance
+	component_data_t component_data;
+	component_data.type = bridge->render_type;
+	component_data.data = &component;
+	ecs_result_t ecs_res = ecs_entity_add_component(bridge->ecs, eid, &component_data);
+	ASSERT(ecs_res == ECS_RESULT_OK, "failed to add render component");
+	(void)ecs_res;
+	return RENDER_RESULT_OK;
+}
+
+void render_bridge_detach(render_bridge_t* bridge, entity_id_t eid)
+{
+	query_result_t result;
+	if (ecs_query_component(bridge->ecs, eid, bridge->render_type, &result) != ECS_RESULT_OK)
+		return;
+
+	render_instance_destroy(bridge->render, ((const render_component_t*)result.component_data)->instance_id);
+	ecs_entity_remove_component(bridge->ecs, eid, bridge->render_type);
+}
+
+void render_bridge_update(render_bridge_t* bridge)
+{
+	uint64_t version = ecs_get_version(bridge->ecs);
+	ecs_query_set_changed_since(bridge->query, bridge->last_version);
+	bridge->last_version = version;
+
+	ecs_query_iter_t iter;
+	ecs_query_batch_t batch;
+	ecs_query_iter_begin(bridge->ecs, bridge->query, &iter);
+	while (ecs_query_iter_next(&iter, &batch))
+	{
+		bridge->mapped.ensure_capacity(bridge->allocator, batch.count);
+		bridge->mapped.set_length(batch.count);
+		bridge->matrices.ensure_capacity(bridge->allocator, batch.count);
+		bridge->matrices.set_length(batch.count);
+		const render_instance_id_t* instance_ids = (const render_instance_id_t*)batch.components[1];
+		render_result_t res = render_instance_map_data(bridge->render, batch.count, instance_ids, bridge->mapped.begin());
+		ASSERT(res == RENDER_RESULT_OK, "failed to map render instances");
+		(void)res;
+
+		for (uint32_t i = 0; i < batch.count; ++i)
+			bridge->matrices[i] = bridge->mapped[i]->transform;
+
+		transform_soa_t transforms = transform_soa_from_fields(batch.components[0], batch.field_strides[0]);
+		simd_transform_compose_scatter(&transforms, batch.count, bridge->matrices.begin());
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <game/ecs.h>
+#include <graphics/render.h>
+
+struct allocator_t;
+
+/**
+ * Owned by the entity, created by render_bridge_attach and destroyed by render_bridge_detach.
+ */
+struct render_component_t
+{
+	render_instance_id_t instance_id;
+};
+
+struct render_bridge_create_info_t
+{
+	allocator_t* allocator;
+	ecs_t* ecs;
+	render_t* render;
+	component_type_id_t transform_type; // transform_t split into TRANSFORM_NUM_FIELDS fields
+	component_type_id_t render_type; // render_component_t
+};
+
+/**
+ * Feeds the transforms of entities to their render instances. Only batches
+ * with changed transforms are looked at, and their matrices are composed
+ * straight into the instance data of the backend, so each matrix is written
+ * once per frame.
+ */
+struct render_bridge_t;
+
+render_bridge_t* render_bridge_create(const render_bridge_create_info_t* create_info);
+
+void render_bridge_destroy(render_bridge_t* bridge);
+
+/**
+ * Creates a render instance for the entity and adds a render_component_t owning it.
+ */
+render_result_t render_bridge_attach(render_bridge_t* bridge, entity_id_t eid, render_mesh_id_t mesh_id, render_material_id_t material_id);
+
+/**
+ * Destroys the render instance of the entity and removes its render_component_t, has to be done before destroying the entity.
+ */
+void render_bridge_detach(render_bridge_t* bridge, entity_id_t eid);
+
+/**
+ * Writes the transforms changed since the last update into the instances.
+ * Runs after the transforms are written for the frame and before render_kick_render.
+ */
+void render_bridge_update(render_bridge_t* bridge);
@@ -64,7 +64,7 @@ void shader_register_creator(resource_context_t* resource_context)
 		shader_destroy,
 		&allocator_malloc,
 		resource_context,
-		hash_string("shader")
+		hash_string_64("shader")
 	};
 	resource_cache_add_creator(resource_context->resource_cache, &shader_creator);
 }
@@ -64,7 +64,7 @@ void texture_register_creator(resource_context_t* resource_context)
 		texture_destroy,
 		&allocator_malloc,
 		resource_context,
-		hash_string("texture")
+		hash_string_64("texture")
 	};
 	resource_cache_add_creator(resource_context->resource_cache, &texture_creator);
 }
@@ -5,6 +5,7 @@
 #include <foundation/hash.h>
 #include <foundation/job_system.h>
 #include <foundation/resource_cache.h>
+#include <foundation/simd_math.h>
 #include <foundation/time.h>
 #include <foundation/vfs.h>
 #include <foundation/vfs_mount_fs.h>
@@ -19,8 +20,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
 #include <cstdio>
 
+#include "render_bridge.h"
 #include "resource_context.h"
 
 #define DATA_PATH "local/build/" PLATFORM_STRING "/"
@@ -46,6 +49,40 @@ void shader_register_creator(resource_context_t* resource_context);
 void texture_register_creator(resource_context_t* resource_context);
 void material_register_creator(resource_context_t* resource_context);
 
+/**
+ * Lays the entities out in a grid on their entity index, each rotated around x and then y by an angle growing with t.
+ */
+static void update_transforms(ecs_t* ecs, ecs_query_t* query, float t)
+{
+	ecs_query_iter_t iter;
+	ecs_query_batch_t batch;
+	ecs_query_iter_begin(ecs, query, &iter);
+	while (ecs_query_iter_next(&iter, &batch))
+	{
+		transform_soa_t transforms = transform_soa_from_fields(batch.components[0], batch.field_strides[0]);
+		for (uint32_t i = 0; i < batch.count; ++i)
+		{
+			uint32_t index = ecs_entity_index(batch.eids[i]);
+			float x = (float)(index % 100) - 50;
+			float y = (float)(index / 100) - 50;
+			float sx = sinf((x + t) * 0.005f);
+			float cx = cosf((x + t) * 0.005f);
+			float sy = sinf((y + t) * 0.005f);
+			float cy = cosf((y + t) * 0.005f);
+			transforms.px[i] = x;
+			transforms.py[i] = y;
+			transforms.pz[i] = 0.0f;
+			transforms.qx[i] = sx * cy;
+			transforms.qy[i] = cx * sy;
+			transforms.qz[i] = sx * sy;
+			transforms.qw[i] = cx * cy;
+			transforms.sx[i] = 1.0f;
+			transforms.sy[i] = 1.0f;
+			transforms.sz[i] = 1.0f;
+		}
+	}
+}
+
 int application_main(application_t* application)
 {
 #if defined(FAMILY_WINDOWS)
@@ -229,8 +266,10 @@ int application_main(application_t* application)
 		const char* type_str = strrchr(precache_name, '.') + 1;
 		if (strcmp(type_str, "vl") != 0) // TODO: remove this early out and select what to precache better
 		{
-			uint32_t name_hash = hash_string(precache_name);
-			uint32_t type_hash = hash_string(type_str);
+			uint64_t name_hash = hash_string_64(precache_name);
+			uint64_t type_hash = hash_string_64(type_str);
+			bool registered = hash_registry_add(name_hash, precache_name);
+			ASSERT(registered, "resource name \"%s\" collides with another resource name", precache_name);
 
 			vfs_request_t request;
 			vfs_res = vfs_begin_request(vfs, precache_name, &request);
@@ -274,31 +313,58 @@ int application_main(application_t* application)
 	resource_cache_handle_to_pointer(resource_cache, material_handle, &material_ptr);
 	render_material_id_t material_id = (render_material_id_t)(uintptr_t)material_ptr;
 
-	render_instance_id_t instance_id[MAX_ENTITIES];
-	render_instance_create_info_t instance_create_info =
-	{
-		mesh_id,
-		material_id,
-		{
-			{ 0 },
-		},
-	};
+	ecs_create_info_t ecs_create_info = {};
+	ecs_create_info.allocator = &allocator_malloc;
+	ecs_create_info.storage = ECS_STORAGE_ARCHETYPES;
+	ecs_create_info.max_entities = MAX_ENTITIES;
+	ecs_create_info.max_component_types = 2;
+	ecs_create_info.max_archetypes = 4;
+	ecs_t* ecs;
+	ecs_result_t ecs_res = ecs_create(&ecs_create_info, &ecs);
+	ASSERT(ecs_res == ECS_RESULT_OK, "failed to create ecs");
+
+	component_type_create_info_t transform_type_create_info = {};
+	transform_type_create_info.component_size = sizeof(transform_t);
+	transform_type_create_info.num_fields = TRANSFORM_NUM_FIELDS;
+	component_type_id_t transform_type;
+	ecs_register_component_type(ecs, &transform_type_create_info, &transform_type);
+
+	component_type_create_info_t render_type_create_info = {};
+	render_type_create_info.component_size = sizeof(render_component_t);
+	component_type_id_t render_type;
+	ecs_register_component_type(ecs, &render_type_create_info, &render_type);
+
+	// Changed transforms are composed straight into the render instances, nothing is copied in between
+	render_bridge_create_info_t bridge_create_info;
+	bridge_create_info.allocator = &allocator_malloc;
+	bridge_create_info.ecs = ecs;
+	bridge_create_info.render = render;
+	bridge_create_info.transform_type = transform_type;
+	bridge_create_info.render_type = render_type;
+	render_bridge_t* bridge = render_bridge_create(&bridge_create_info);
+
+	ecs_query_create_info_t animate_create_info = {};
+	animate_create_info.num_with = 1;
+	animate_create_info.with = &transform_type;
+	animate_create_info.write_mask = 1 << 0;
+	ecs_query_t* animate_query;
+	ecs_res = ecs_query_create(ecs, &animate_create_info, &animate_query);
+	ASSERT(ecs_res == ECS_RESULT_OK, "failed to create query");
+
+	transform_t initial_transform = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+	component_data_t initial_components[] = { { transform_type, &initial_transform } };
+	entity_create_info_t entity_create_info = { (uint32_t)ARRAY_LENGTH(initial_components), initial_components };
+	entity_id_t entities[MAX_ENTITIES];
 	for (size_t i = 0; i < MAX_ENTITIES; ++i)
 	{
-		float x = (float)(i % 100) - 50;
-		float y = (float)(i / 100) - 50;
-		glm::mat4x4 translation = glm::translate(glm::vec3(x, y, 0.0f));
-		glm::mat4x4 rotx = glm::rotate(x * 0.01f, glm::vec3(1.0f, 0.0f, 0.0f));
-		glm::mat4x4 roty = glm::rotate(y * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4x4 mat = translation * rotx * roty;
-		memcpy(instance_create_info.initial_data.transform, glm::value_ptr(mat), sizeof(instance_create_info.initial_data.transform));
-		render_res = render_instance_create(render, &instance_create_info, &instance_id[i]);
+		ecs_res = ecs_entity_create(ecs, &entity_create_info, &entities[i]);
+		ASSERT(ecs_res == ECS_RESULT_OK, "failed to create entity");
+		render_res = render_bridge_attach(bridge, entities[i], mesh_id, material_id);
 		ASSERT(render_res == RENDER_RESULT_OK, "failed create render instance");
 	}
 
 	uint64_t freq = time_frequency();
 	uint64_t start = time_current();
-	render_instance_data_t instance_data[MAX_ENTITIES];
 	while (application_is_running(application))
 	{
 		uint64_t curr = time_current();
@@ -306,19 +372,9 @@ int application_main(application_t* application)
 		float t = (float)time / (float)freq;
 		application_update(application);
 
-		for (size_t i = 0; i < MAX_ENTITIES; ++i)
-		{
-			float x = (float)(i % 100) - 50;
-			float y = (float)(i / 100) - 50;
-			glm::mat4x4 translation = glm::translate(glm::vec3(x, y, 0.0f));
-			glm::mat4x4 rotx = glm::rotate((x + t) * 0.01f, glm::vec3(1.0f, 0.0f, 0.0f));
-			glm::mat4x4 roty = glm::rotate((y + t) * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
-			glm::mat4x4 mat = translation * rotx * roty;
-			memcpy(instance_data[i].transform, glm::value_ptr(mat), sizeof(instance_data[i].transform));
-		}
+		update_transforms(ecs, animate_query, t);
+		render_bridge_update(bridge);
 
-		render_instance_set_data(render, MAX_ENTITIES, instance_id, instance_data);
-		
 		render_kick_render(render, view_id, script_id);
 	}
 
@@ -328,8 +384,12 @@ int application_main(application_t* application)
 
 	for (size_t i = 0; i < MAX_ENTITIES; ++i)
 	{
-		render_instance_destroy(render, instance_id[i]);
+		render_bridge_detach(bridge, entities[i]);
+		ecs_entity_destroy(ecs, entities[i]);
 	}
+	ecs_query_destroy(ecs, animate_query);
+	render_bridge_destroy(bridge);
+	ecs_destroy(ecs);
 
 	resource_cache_release_handle(resource_cache, mesh_handle);
 	resource_cache_release_handle(resource_cache, material_handle);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "defines.h"
+
+#if defined(COMPILER_MSVC)
+#	include <intrin.h>
+#endif
+
+static inline bool bits_is_pow2(size_t x)
+{
+	return x != 0 && (x & (x - 1)) == 0;
+}
+
+static inline size_t bits_next_pow2(size_t x)
+{
+	if (x <= 1)
+		return 1;
+	x--;
+	for (size_t shift = 1; shift < sizeof(size_t) * 8; shift <<= 1)
+		x |= x >> shift;
+	return x + 1;
+}
+
+/**
+ * Index of the lowest set bit, x must not be 0.
+ */
+static inline uint32_t bits_lsb(uint64_t x)
+{
+#if defined(COMPILER_MSVC) && defined(PLATFORM_WIN64)
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return (uint32_t)index;
+#elif defined(COMPILER_MSVC)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)x))
+		return (uint32_t)index;
+	_BitScanForward(&index, (unsigned long)(x >> 32));
+	return (uint32_t)index + 32;
+#else
+	return (uint32_t)__builtin_ctzll(x);
+#endif
+}
+
+/**
+ * Index of the highest set bit, x must not be 0.
+ */
+static inline uint32_t bits_msb(uint64_t x)
+{
+#if defined(COMPILER_MSVC) && defined(PLATFORM_WIN64)
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return (uint32_t)index;
+#elif defined(COMPILER_MSVC)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(x >> 32)))
+		return (uint32_t)index + 32;
+	_BitScanReverse(&index, (unsigned long)x);
+	return (uint32_t)index;
+#else
+	return 63 - (uint32_t)__builtin_clzll(x);
+#endif
+}
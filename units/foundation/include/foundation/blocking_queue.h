@@ -0,0 +1,157 @@
+#pragma once
+
+#include "allocator.h"
+#include "eventcount.h"
+
+#include <atomic>
+
+/**
+ * Blocking wrapper around spsc_queue_t or mpmc_queue_t.
+ *
+ * Waiting threads sleep on an eventcount, producers and consumers only pay
+ * for a wakeup when the other side is actually asleep. close() wakes all
+ * waiters and makes pop fail once the queue has been drained.
+ */
+template<class TQ>
+struct blocking_queue_t
+{
+	typedef typename TQ::item_t item_t;
+
+	TQ _queue;
+	eventcount_t _not_empty;
+	eventcount_t _not_full;
+	std::atomic<bool> _closed;
+
+	void create(allocator_t* allocator, size_t capacity)
+	{
+		_queue.create(allocator, capacity);
+		_closed.store(false);
+	}
+
+	void destroy(allocator_t* allocator)
+	{
+		_queue.destroy(allocator);
+	}
+
+	size_t capacity() const
+	{
+		return _queue.capacity();
+	}
+
+	size_t count() const
+	{
+		return _queue.count();
+	}
+
+	bool try_push(const item_t& item)
+	{
+		if (!_queue.try_push(item))
+			return false;
+		_not_empty.notify_one();
+		return true;
+	}
+
+	bool try_pop(item_t* out_item)
+	{
+		if (!_queue.try_pop(out_item))
+			return false;
+		_not_full.notify_one();
+		return true;
+	}
+
+	void push(const item_t& item)
+	{
+		while (!_queue.try_push(item))
+		{
+			uint32_t key = _not_full.prepare_wait();
+			if (_queue.try_push(item))
+			{
+				_not_full.cancel_wait();
+				break;
+			}
+			_not_full.wait(key);
+		}
+		_not_empty.notify_one();
+	}
+
+	void push_bulk(const item_t* items, size_t num_items)
+	{
+		while (num_items != 0)
+		{
+			size_t n = _queue.push_bulk(items, num_items);
+			if (n == 0)
+			{
+				uint32_t key = _not_full.prepare_wait();
+				n = _queue.push_bulk(items, num_items);
+				if (n == 0)
+				{
+					_not_full.wait(key);
+					continue;
+				}
+				_not_full.cancel_wait();
+			}
+			items += n;
+			num_items -= n;
+			_not_empty.notify_all();
+		}
+	}
+
+	/**
+	 * Blocks until an item is available. Returns false if the queue was
+	 * closed and is empty.
+	 */
+	bool pop(item_t* out_item)
+	{
+		while (!_queue.try_pop(out_item))
+		{
+			uint32_t key = _not_empty.prepare_wait();
+			if (_queue.try_pop(out_item))
+			{
+				_not_empty.cancel_wait();
+				break;
+			}
+			if (_closed.load())
+			{
+				_not_empty.cancel_wait();
+				return false;
+			}
+			_not_empty.wait(key);
+		}
+		_not_full.notify_one();
+		return true;
+	}
+
+	/**
+	 * Blocks until at least one item is available and pops up to max_items.
+	 * Returns 0 if the queue was closed and is empty.
+	 */
+	size_t pop_bulk(item_t* out_items, size_t max_items)
+	{
+		size_t n;
+		while ((n = _queue.pop_bulk(out_items, max_items)) == 0)
+		{
+			uint32_t key = _not_empty.prepare_wait();
+			n = _queue.pop_bulk(out_items, max_items);
+			if (n != 0)
+			{
+				_not_empty.cancel_wait();
+				break;
+			}
+			if (_closed.load())
+			{
+				_not_empty.cancel_wait();
+				return 0;
+			}
+			_not_empty.wait(key);
+		}
+		_not_full.notify_all();
+		return n;
+	}
+
+	void close()
+	{
+		_closed.store(true);
+		_not_empty.notify_all();
+		_not_full.notify_all();
+	}
+};
@@ -93,7 +93,7 @@ struct cobjpool_t
 			_allocated_handles[ih] = _allocated_handles[il];
 		}
 
-		_indices[handle] = _indices[last];
+		_indices[last] = _indices[handle];
 		_handles[_num_free++] = handle;
 	}
 
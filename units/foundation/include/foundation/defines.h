@@ -6,6 +6,8 @@
 #define ARRAY_LENGTH(a) (sizeof((a)[0]) ? sizeof(a) / sizeof((a)[0]) : 0)
 #define ALIGN_UP(ptr, align) (((uintptr_t)(ptr) + ((align)-1)) & ~((align)-1))
 
+#define CACHE_LINE_SIZE 64
+
 #if defined(COMPILER_GCC)
 #	if defined(ALIGN)
 #		undef ALIGN
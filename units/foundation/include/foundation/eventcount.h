@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Eventcount used to put threads to sleep on lock-free structures.
+ *
+ * A waiter calls prepare_wait, re-checks its condition and then either
+ * cancel_wait or wait. Notifiers only touch the mutex when somebody is
+ * actually waiting, so the uncontended path is a single atomic load.
+ */
+struct eventcount_t
+{
+	std::atomic<uint32_t> _epoch;
+	std::atomic<uint32_t> _waiters;
+	std::mutex _mutex;
+	std::condition_variable _cond;
+
+	eventcount_t()
+		: _epoch(0)
+		, _waiters(0)
+	{
+	}
+
+	uint32_t prepare_wait()
+	{
+		_waiters.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return _epoch.load();
+	}
+
+	void cancel_wait()
+	{
+		_waiters.fetch_sub(1);
+	}
+
+	void wait(uint32_t key)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (_epoch.load() == key)
+				_cond.wait(lock);
+		}
+		_waiters.fetch_sub(1);
+	}
+
+	void notify_one()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waiters.load() == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_epoch.fetch_add(1);
+		}
+		_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waiters.load() == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_epoch.fetch_add(1);
+		}
+		_cond.notify_all();
+	}
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstring> // for memmove
+
+#include "assert.h"
+#include "allocator.h"
+
+/**
+ * Map with keys kept sorted in their own array, separate from the values.
+ *
+ * Lookups are a branchless binary search that only touches the key array,
+ * inserts and removes move the tail of both arrays. Best suited for maps
+ * that are built once and then searched a lot.
+ */
+template<class TK, class TV>
+struct flat_map_t
+{
+	TK* _keys;
+	TV* _values;
+	size_t _capacity;
+	size_t _length;
+
+	void create(allocator_t* allocator, size_t capacity)
+	{
+		ASSERT(_keys == nullptr && _values == nullptr, "flat_map was already created");
+		_capacity = capacity;
+		_length = 0;
+		_keys = capacity ? ALLOCATOR_ALLOC_ARRAY(allocator, capacity, TK) : nullptr;
+		_values = capacity ? ALLOCATOR_ALLOC_ARRAY(allocator, capacity, TV) : nullptr;
+	}
+
+	void destroy(allocator_t* allocator)
+	{
+		ALLOCATOR_FREE(allocator, _keys);
+		ALLOCATOR_FREE(allocator, _values);
+	}
+
+	size_t length() const
+	{
+		return _length;
+	}
+
+	size_t capacity() const
+	{
+		return _capacity;
+	}
+
+	bool empty() const
+	{
+		return _length == 0;
+	}
+
+	bool full() const
+	{
+		return _length == _capacity;
+	}
+
+	/**
+	 * Index of the first key not less than key, length() if there is none.
+	 */
+	size_t lower_bound(const TK& key) const
+	{
+		size_t n = _length;
+		if (n == 0)
+			return 0;
+
+		const TK* base = _keys;
+		while (n > 1)
+		{
+			size_t half = n / 2;
+			base = (base[half] < key) ? base + half : base;
+			n -= half;
+		}
+		return (size_t)(base - _keys) + (*base < key ? 1 : 0);
+	}
+
+	bool has_key(const TK& key) const
+	{
+		size_t i = lower_bound(key);
+		return i < _length && _keys[i] == key;
+	}
+
+	TV* find(const TK& key)
+	{
+		size_t i = lower_bound(key);
+		return (i < _length && _keys[i] == key) ? &_values[i] : nullptr;
+	}
+
+	const TV* find(const TK& key) const
+	{
+		size_t i = lower_bound(key);
+		return (i < _length && _keys[i] == key) ? &_values[i] : nullptr;
+	}
+
+	/**
+	 * Inserts or overwrites the value for key.
+	 */
+	void insert(const TK& key, const TV& value)
+	{
+		size_t i = lower_bound(key);
+		if (i < _length && _keys[i] == key)
+		{
+			_values[i] = value;
+			return;
+		}
+
+		ASSERT(!full(), "flat_map is full");
+		memmove(_keys + i + 1, _keys + i, (_length - i) * sizeof(TK));
+		memmove(_values + i + 1, _values + i, (_length - i) * sizeof(TV));
+		_keys[i] = key;
+		_values[i] = value;
+		_length++;
+	}
+
+	bool remove(const TK& key)
+	{
+		size_t i = lower_bound(key);
+		if (i >= _length || !(_keys[i] == key))
+			return false;
+
+		memmove(_keys + i, _keys + i + 1, (_length - i - 1) * sizeof(TK));
+		memmove(_values + i, _values + i + 1, (_length - i - 1) * sizeof(TV));
+		_length--;
+		return true;
+	}
+
+	void clear()
+	{
+		_length = 0;
+	}
+
+	const TK* keys() const
+	{
+		return _keys;
+	}
+
+	TV* values()
+	{
+		return _values;
+	}
+
+	const TV* values() const
+	{
+		return _values;
+	}
+};
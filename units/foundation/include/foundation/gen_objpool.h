@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "assert.h"
+#include "allocator.h"
+
+/**
+ * Object pool handing out generational handles.
+ *
+ * A handle packs the slot index in the low INDEX_BITS bits and the slot
+ * generation in the remaining bits. Freeing a slot bumps its generation so
+ * stale handles are detected by is_valid in O(1). Generation 0 is never
+ * handed out, so a zeroed handle is always invalid.
+ *
+ * By default 32-bit handles get 20 index bits (about 1M objects) and 12
+ * generation bits, 64-bit handles get 40 index bits and 24 generation bits.
+ */
+template<class T, class TH = uint32_t, int INDEX_BITS = sizeof(TH) * 5>
+struct gen_objpool_t
+{
+	size_t       _capacity;
+	size_t       _num_free;
+	TH*          _free_indices;
+	TH*          _generations;
+	T*           _data;
+
+	static TH index_mask() { return static_cast<TH>((TH(1) << INDEX_BITS) - 1); }
+	static TH generation_mask() { return static_cast<TH>(TH(~TH(0)) >> INDEX_BITS); }
+	static TH handle_index(TH handle) { return static_cast<TH>(handle & index_mask()); }
+	static TH handle_generation(TH handle) { return static_cast<TH>(handle >> INDEX_BITS); }
+	static TH make_handle(TH index, TH generation) { return static_cast<TH>((generation << INDEX_BITS) | index); }
+
+	void create(allocator_t* allocator, size_t capacity)
+	{
+		ASSERT(_free_indices == NULL, "gen_objpool was already created");
+		ASSERT(_data == NULL, "gen_objpool alrady created");
+		ASSERT(capacity <= (size_t)index_mask() + 1, "gen_objpool capacity does not fit in handle index bits");
+
+		_capacity = capacity;
+		_num_free = capacity;
+		_free_indices = ALLOCATOR_ALLOC_ARRAY(allocator, capacity, TH);
+		_generations = ALLOCATOR_ALLOC_ARRAY(allocator, capacity, TH);
+		_data = ALLOCATOR_ALLOC_ARRAY(allocator, capacity, T);
+
+		for(size_t i = 0; i < capacity; ++i)
+		{
+			_free_indices[i] = static_cast<TH>(capacity - i - 1);
+			_generations[i] = 1;
+		}
+	}
+
+	void destroy(allocator_t* allocator)
+	{
+		ALLOCATOR_FREE(allocator, _free_indices);
+		ALLOCATOR_FREE(allocator, _generations);
+		ALLOCATOR_FREE(allocator, _data);
+	}
+
+	bool full() const
+	{
+		return _num_free == 0;
+	}
+
+	bool empty() const
+	{
+		return _num_free == _capacity;
+	}
+
+	size_t capacity() const
+	{
+		return _capacity;
+	}
+
+	size_t num_free() const
+	{
+		return _num_free;
+	}
+
+	size_t num_used() const
+	{
+		return _capacity - _num_free;
+	}
+
+	bool is_valid(TH handle) const
+	{
+		TH index = handle_index(handle);
+		return index < _capacity && _generations[index] == handle_generation(handle);
+	}
+
+	TH alloc_handle()
+	{
+		ASSERT(_num_free > 0, "gen_objpool out of space");
+
+		TH index = _free_indices[--_num_free];
+		return make_handle(index, _generations[index]);
+	}
+
+	void free_handle(TH handle)
+	{
+		ASSERT(_num_free < _capacity, "tried to free handle on empty gen_objpool");
+		ASSERT(is_valid(handle), "stale or bad handle");
+
+		TH index = handle_index(handle);
+		TH generation = static_cast<TH>((_generations[index] + 1) & generation_mask());
+		_generations[index] = generation != 0 ? generation : 1;
+		_free_indices[_num_free++] = index;
+	}
+
+	T* alloc()
+	{
+		return handle_to_pointer(alloc_handle());
+	}
+
+	void free(T* ptr)
+	{
+		free_handle(pointer_to_handle(ptr));
+	}
+
+	T* handle_to_pointer(TH handle)
+	{
+		ASSERT(is_valid(handle), "stale or bad handle");
+
+		return _data + handle_index(handle);
+	}
+
+	const T* handle_to_pointer(TH handle) const
+	{
+		ASSERT(is_valid(handle), "stale or bad handle");
+
+		return _data + handle_index(handle);
+	}
+
+	void handles_to_pointers(const TH* handles, size_t num_handles, T** out_pointers)
+	{
+		for(size_t i = 0; i < num_handles; ++i)
+		{
+			ASSERT(is_valid(handles[i]), "stale or bad handle");
+			out_pointers[i] = _data + handle_index(handles[i]);
+		}
+	}
+
+	TH pointer_to_handle(const T* ptr) const
+	{
+		ptrdiff_t index = ptr - _data;
+		ASSERT(index >= 0 && index < static_cast<ptrdiff_t>(_capacity), "pointer not in gen_objpool");
+		return make_handle(static_cast<TH>(index), _generations[index]);
+	}
+};
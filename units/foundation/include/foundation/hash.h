@@ -5,3 +5,36 @@
 
 uint32_t hash_string(const char* str);
 uint32_t hash_buffer(const void* buf, size_t size);
+
+/**
+ * 64-bit hashes, used for all persistent identities (resource names, types,
+ * shader properties and job functions) to keep collisions unlikely even with
+ * a very large number of assets.
+ */
+uint64_t hash_string_64(const char* str);
+uint64_t hash_buffer_64(const void* buf, size_t size);
+
+/**
+ * Debug registry remembering the string behind each 64-bit hash.
+ * Only active when HASH_REGISTRY_ENABLE is defined (debug builds), otherwise
+ * add always succeeds and lookup always returns nullptr.
+ *
+ * hash_registry_add returns false and reports to stderr if the hash was
+ * already registered from a different string.
+ */
+bool hash_registry_add(uint64_t hash, const char* str);
+const char* hash_registry_lookup(uint64_t hash);
+
+/**
+ * Build time collision check across assets. Every asset compiler appends the
+ * names it hashes to a shared manifest, one "hash name" line per name, and
+ * checks them against the names every other compiler appended.
+ *
+ * The names are appended before the manifest is read back, so of two
+ * compilers running at the same time the one that finishes last sees both.
+ * Names already in the manifest are not appended again.
+ *
+ * Returns false and reports to stderr if one of the names collides with
+ * another name or if the manifest can not be written.
+ */
+bool hash_manifest_add(const char* manifest_path, const char* const* names, size_t num_names);
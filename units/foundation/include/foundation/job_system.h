@@ -50,7 +50,7 @@ void job_system_destroy(job_system_t* system);
 
 job_system_result_t job_system_load_bundle(job_system_t* system, const char* bundle_name);
 
-job_system_result_t job_system_cache_function(job_system_t* system, uint32_t function_name_hash, job_cached_function_t** out_cached_function);
+job_system_result_t job_system_cache_function(job_system_t* system, uint64_t function_name_hash, job_cached_function_t** out_cached_function);
 job_system_result_t job_system_release_cached_function(job_system_t* system, job_cached_function_t* cached_function);
 
 job_system_result_t job_system_acquire_event(job_system_t* system, job_event_t** out_event);
@@ -62,7 +62,14 @@ job_system_result_t job_system_wait_release_event(job_system_t* system, job_even
 job_system_result_t job_system_kick(job_system_t* system, job_cached_function_t* cached_function, size_t num_jobs, void** args, size_t arg_size, job_event_t* depends = nullptr, job_event_t* event = nullptr);
 job_system_result_t job_system_kick_ptr(job_system_t* system, job_function_t function, size_t num_jobs, void** args, size_t arg_size, job_event_t* depends = nullptr, job_event_t* event = nullptr);
 
+/**
+ * Worker threads are numbered from 0 and the main thread comes last, giving
+ * num_threads + 1 workers. Used to index per worker data without locking.
+ */
+job_system_result_t job_system_get_num_workers(job_system_t* system, uint32_t* out_num_workers);
+
 job_system_result_t job_context_get_allocator(job_context_t* context, allocator_t** out_allocator);
+job_system_result_t job_context_get_worker_index(job_context_t* context, uint32_t* out_worker_index);
 job_system_result_t job_context_kick(job_context_t* context, job_cached_function_t* cached_function, size_t num_jobs, void** args, size_t arg_size);
 job_system_result_t job_context_call(job_context_t* context, job_cached_function_t* cached_function, size_t num_jobs, void** args, size_t arg_size);
 job_system_result_t job_context_kick_ptr(job_context_t* context, job_function_t function, size_t num_jobs, void** args, size_t arg_size);
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "assert.h"
+#include "allocator.h"
+#include "bits.h"
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Lock-free bounded multi producer, multi consumer queue.
+ *
+ * Every cell carries a sequence number telling if it is free for the
+ * producer or filled for the consumer of the current lap. Capacity has to be
+ * a power of two. Bulk operations claim a whole range of cells with one
+ * atomic operation and then wait for each cell to be released by whoever
+ * claimed it in the previous lap, which is at most a few instructions away.
+ */
+template<class T>
+struct mpmc_queue_t
+{
+	typedef T item_t;
+
+	struct cell_t
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	cell_t* _cells;
+	size_t _mask;
+	uint8_t _pad0[CACHE_LINE_SIZE - sizeof(cell_t*) - sizeof(size_t)];
+
+	std::atomic<size_t> _enqueue_pos;
+	uint8_t _pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+	std::atomic<size_t> _dequeue_pos;
+	uint8_t _pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+	void create(allocator_t* allocator, size_t capacity)
+	{
+		ASSERT(_cells == NULL, "queue was already created");
+		ASSERT(bits_is_pow2(capacity), "queue capacity has to be a power of two");
+		_mask = capacity - 1;
+		_cells = ALLOCATOR_ALLOC_ARRAY(allocator, capacity, cell_t);
+		for (size_t i = 0; i < capacity; ++i)
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		_enqueue_pos.store(0, std::memory_order_relaxed);
+		_dequeue_pos.store(0, std::memory_order_relaxed);
+	}
+
+	void destroy(allocator_t* allocator)
+	{
+		ALLOCATOR_FREE(allocator, _cells);
+	}
+
+	size_t capacity() const
+	{
+		return _mask + 1;
+	}
+
+	/**
+	 * Approximate number of items, exact only when no other thread is active.
+	 */
+	size_t count() const
+	{
+		size_t head = _dequeue_pos.load(std::memory_order_acquire);
+		size_t tail = _enqueue_pos.load(std::memory_order_acquire);
+		return tail - head;
+	}
+
+	bool empty() const
+	{
+		return count() == 0;
+	}
+
+	bool any() const
+	{
+		return count() != 0;
+	}
+
+	bool try_push(const T& t)
+	{
+		size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell_t* cell = &_cells[pos & _mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell->data = t;
+					cell->sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_pop(T* out_t)
+	{
+		size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell_t* cell = &_cells[pos & _mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					*out_t = cell->data;
+					cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _dequeue_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns the number of items pushed
+	size_t push_bulk(const T* items, size_t num_items)
+	{
+		size_t pos, n;
+		for (;;)
+		{
+			// Read the consumer position first so pos can never be behind it
+			size_t head = _dequeue_pos.load(std::memory_order_acquire);
+			pos = _enqueue_pos.load(std::memory_order_relaxed);
+			size_t used = pos - head;
+			if (used > _mask + 1)
+				continue; // consumers moved on in between, head is stale
+			size_t space = _mask + 1 - used;
+			n = num_items < space ? num_items : space;
+			if (n == 0)
+				return 0;
+			if (_enqueue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+				break;
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			cell_t* cell = &_cells[(pos + i) & _mask];
+			while (cell->sequence.load(std::memory_order_acquire) != pos + i)
+				std::this_thread::yield(); // consumer of the previous lap is still reading
+			cell->data = items[i];
+			cell->sequence.store(pos + i + 1, std::memory_order_release);
+		}
+		return n;
+	}
+
+	// Returns the number of items popped
+	size_t pop_bulk(T* out_items, size_t max_items)
+	{
+		size_t pos, n;
+		do
+		{
+			// Read our own position first so pos can never be ahead of tail
+			pos = _dequeue_pos.load(std::memory_order_relaxed);
+			size_t tail = _enqueue_pos.load(std::memory_order_acquire);
+			size_t avail = tail - pos;
+			n = max_items < avail ? max_items : avail;
+			if (n == 0)
+				return 0;
+		} while (!_dequeue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed));
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			cell_t* cell = &_cells[(pos + i) & _mask];
+			while (cell->sequence.load(std::memory_order_acquire) != pos + i + 1)
+				std::this_thread::yield(); // producer has claimed the cell but not written it yet
+			out_items[i] = cell->data;
+			cell->sequence.store(pos + i + _mask + 1, std::memory_order_release);
+		}
+		return n;
+	}
+};
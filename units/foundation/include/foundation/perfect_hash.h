@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "allocator.h"
+
+/**
+ * Minimal perfect hashing of 64-bit keys (usually hash_string_64 results).
+ *
+ * Keys are first distributed into buckets, each bucket then gets a seed that
+ * places all its keys into distinct slots in [0, num_keys). Lookup is two
+ * mixes and no probing. Since any key maps to some slot the caller has to
+ * compare the key stored in that slot to detect misses.
+ *
+ * Intended to be built offline by the asset compilers and stored alongside
+ * the data it indexes.
+ */
+
+static inline uint64_t perfect_hash_mix(uint64_t key, uint32_t seed)
+{
+	uint64_t h = key ^ ((uint64_t)seed * 0x9e3779b97f4a7c15ULL);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline uint32_t perfect_hash_reduce(uint64_t h, uint32_t range)
+{
+	return (uint32_t)(((h >> 32) * range) >> 32);
+}
+
+/**
+ * Number of seeds needed for a table of num_keys keys.
+ */
+static inline uint32_t perfect_hash_num_seeds(size_t num_keys)
+{
+	return (uint32_t)((num_keys + 1) / 2);
+}
+
+/**
+ * Slot for key, num_keys must not be 0.
+ */
+static inline uint32_t perfect_hash_lookup(const uint32_t* seeds, uint32_t num_seeds, uint32_t num_keys, uint64_t key)
+{
+	uint32_t bucket = perfect_hash_reduce(perfect_hash_mix(key, 0), num_seeds);
+	return perfect_hash_reduce(perfect_hash_mix(key, seeds[bucket]), num_keys);
+}
+
+/**
+ * Builds the seeds for num_keys distinct keys. out_seeds has to hold
+ * perfect_hash_num_seeds(num_keys) entries, out_slots[i] receives the slot of
+ * keys[i]. Returns false if the keys contain duplicates.
+ */
+bool perfect_hash_build(allocator_t* allocator, const uint64_t* keys, size_t num_keys, uint32_t* out_seeds, uint32_t* out_slots);
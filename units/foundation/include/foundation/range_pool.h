@@ -1,98 +1,250 @@
 #pragma once
 
-#include "array.h"
+#include <cstring> // for memset
 
+#include "assert.h"
+#include "allocator.h"
+#include "bits.h"
+
+/**
+ * Allocator for ranges of consecutive ids, e.g. descriptor heap slots.
+ *
+ * Free ranges are kept in segregated free lists in the style of TLSF. The
+ * first level splits sizes by power of two, the second level splits each
+ * power of two into SL_COUNT linear classes. Two levels of bitmaps give the
+ * first non-empty class in O(1), and alloc and free never scan the free
+ * ranges.
+ *
+ * Allocation first tries the head of the class the requested size falls
+ * into and then takes the smallest class that guarantees a fit. Freed ranges
+ * are coalesced with free neighbours through boundary tags stored per id.
+ */
 template<class T = uint32_t>
 struct range_pool_t
 {
-	struct range_t
+	enum
 	{
-		T begin;
-		T end;
+		SL_BITS = 4,
+		SL_COUNT = 1 << SL_BITS,
+		FL_COUNT = sizeof(T) * 8 - SL_BITS + 1,
 	};
 
-	array_t<range_t> _ranges;
 	T _num_ids;
+	T _num_free;
+
+	uint64_t _fl_bitmap;
+	uint32_t _sl_bitmap[FL_COUNT];
+	T _heads[FL_COUNT][SL_COUNT];
+
+	// Indexed by the first id of a free range, size is 0 when no free range starts there
+	T* _size;
+	T* _next;
+	T* _prev;
+	// Indexed by the last id of a free range, gives the first id
+	T* _tail_to_begin;
+
+	static T invalid() { return (T)-1; }
+
+	static void mapping(T size, uint32_t* out_fl, uint32_t* out_sl)
+	{
+		if (size < SL_COUNT)
+		{
+			*out_fl = 0;
+			*out_sl = (uint32_t)size;
+		}
+		else
+		{
+			uint32_t msb = bits_msb(size);
+			*out_fl = msb - SL_BITS + 1;
+			*out_sl = (uint32_t)(size >> (msb - SL_BITS)) ^ SL_COUNT;
+		}
+	}
 
 	void create(allocator_t* alloc, T num_ids, size_t range_capacity = 0)
 	{
-		_ranges.create(alloc, range_capacity ? range_capacity : (num_ids / 4));
+		(void)range_capacity; // Kept for compatibility, storage is bounded by num_ids
+
 		_num_ids = num_ids;
+		_num_free = 0;
+		_fl_bitmap = 0;
+		memset(_sl_bitmap, 0, sizeof(_sl_bitmap));
+		for (uint32_t fl = 0; fl < FL_COUNT; ++fl)
+			for (uint32_t sl = 0; sl < SL_COUNT; ++sl)
+				_heads[fl][sl] = invalid();
 
-		range_t range = {
-			0,
-			num_ids,
-		};
+		size_t n = num_ids ? num_ids : 1;
+		_size = ALLOCATOR_ALLOC_ARRAY(alloc, n, T);
+		_next = ALLOCATOR_ALLOC_ARRAY(alloc, n, T);
+		_prev = ALLOCATOR_ALLOC_ARRAY(alloc, n, T);
+		_tail_to_begin = ALLOCATOR_ALLOC_ARRAY(alloc, n, T);
+		memset(_size, 0, n * sizeof(T));
 
-		_ranges.append(range);
+		if (num_ids)
+			insert_free(0, num_ids);
 	}
-	
+
 	void destroy(allocator_t* allocator)
 	{
-		_ranges.destroy(allocator);
+		ALLOCATOR_FREE(allocator, _size);
+		ALLOCATOR_FREE(allocator, _next);
+		ALLOCATOR_FREE(allocator, _prev);
+		ALLOCATOR_FREE(allocator, _tail_to_begin);
 	}
 
-	T alloc(const T count)
+	T num_ids() const
+	{
+		return _num_ids;
+	}
+
+	T num_free() const
 	{
-		for(size_t i = 0; i < _ranges.length(); ++i)
+		return _num_free;
+	}
+
+	// Walks all free lists, only meant for statistics
+	void free_ranges(T* out_num_ranges, T* out_largest) const
+	{
+		T num_ranges = 0;
+		T largest = 0;
+		for (uint32_t fl = 0; fl < FL_COUNT; ++fl)
 		{
-			range_t& range = _ranges[i];
-			T range_count = range.end - range.begin;
-			if(range_count == count)
+			for (uint32_t sl = 0; sl < SL_COUNT; ++sl)
 			{
-				T offset = range.begin;
-				_ranges.remove_at(i);
-				return offset;
+				for (T begin = _heads[fl][sl]; begin != invalid(); begin = _next[begin])
+				{
+					++num_ranges;
+					largest = _size[begin] > largest ? _size[begin] : largest;
+				}
 			}
-			else if(range_count > count)
+		}
+		*out_num_ranges = num_ranges;
+		*out_largest = largest;
+	}
+
+	void insert_free(T begin, T size)
+	{
+		uint32_t fl, sl;
+		mapping(size, &fl, &sl);
+
+		T head = _heads[fl][sl];
+		_size[begin] = size;
+		_next[begin] = head;
+		_prev[begin] = invalid();
+		_tail_to_begin[begin + size - 1] = begin;
+		if (head != invalid())
+			_prev[head] = begin;
+		_heads[fl][sl] = begin;
+
+		_fl_bitmap |= 1ULL << fl;
+		_sl_bitmap[fl] |= 1U << sl;
+		_num_free += size;
+	}
+
+	void remove_free(T begin)
+	{
+		T size = _size[begin];
+		uint32_t fl, sl;
+		mapping(size, &fl, &sl);
+
+		T next = _next[begin];
+		T prev = _prev[begin];
+		if (next != invalid())
+			_prev[next] = prev;
+		if (prev != invalid())
+			_next[prev] = next;
+		else
+		{
+			_heads[fl][sl] = next;
+			if (next == invalid())
 			{
-				T offset = range.begin;
-				range.begin += count;
-				return offset;
+				_sl_bitmap[fl] &= ~(1U << sl);
+				if (_sl_bitmap[fl] == 0)
+					_fl_bitmap &= ~(1ULL << fl);
 			}
 		}
 
-		BREAKPOINT();
-		return (T)-1;
+		_size[begin] = 0;
+		_num_free -= size;
+	}
+
+	T find_free(T count) const
+	{
+		uint32_t fl, sl;
+		mapping(count, &fl, &sl);
+
+		// Anything in the exact class that is big enough is a tighter fit than the classes above
+		T head = _heads[fl][sl];
+		if (head != invalid() && _size[head] >= count)
+			return head;
+
+		// Round up to the next class so every range found is big enough
+		if (++sl == SL_COUNT)
+		{
+			sl = 0;
+			++fl;
+		}
+		if (fl >= FL_COUNT)
+			return invalid();
+
+		uint32_t sl_map = _sl_bitmap[fl] & (~0U << sl);
+		if (sl_map == 0)
+		{
+			uint64_t fl_map = fl + 1 < 64 ? _fl_bitmap & (~0ULL << (fl + 1)) : 0;
+			if (fl_map == 0)
+				return invalid();
+			fl = bits_lsb(fl_map);
+			sl_map = _sl_bitmap[fl];
+		}
+		sl = bits_lsb(sl_map);
+		return _heads[fl][sl];
+	}
+
+	T alloc(const T count)
+	{
+		ASSERT(count > 0, "cannot allocate empty range");
+
+		T begin = find_free(count);
+		if (begin == invalid())
+		{
+			BREAKPOINT();
+			return invalid();
+		}
+
+		T size = _size[begin];
+		remove_free(begin);
+		if (size > count)
+			insert_free(begin + count, size - count);
+
+		return begin;
 	}
 
 	void free(const T offset, const T count)
 	{
-		const size_t len = _ranges.length();
-		const T begin = offset;
-		const T end = offset + count;
-		for(size_t i = 0; i < len; ++i)
+		ASSERT(count > 0, "cannot free empty range");
+		ASSERT(offset + count <= _num_ids, "range outside of pool");
+
+		T begin = offset;
+		T end = offset + count;
+
+		// Merge with a free range ending right before us
+		if (begin > 0)
 		{
-			range_t& range = _ranges[i];
-			if(end < range.begin)
-			{
-				// The whole range is below the current range
-				// Insert a new slot in the range list
-				range_t new_range = { begin, end };
-				_ranges.insert_at(i, new_range);
-			}
-			else if(end == range.begin)
-			{
-				// The returned range ends where the current range starts
-				range.begin = begin;
-				return;
-			}
-			else if(range.end == begin)
+			T left = _tail_to_begin[begin - 1];
+			if (left < begin && _size[left] != 0 && left + _size[left] == begin)
 			{
-				// The returned range starts where the current range ends
-				if(i+1 < len && end == _ranges[i+1].begin)
-				{
-					// We have filled a gap, merge the whole range (curr, returned, next)
-					_ranges[i+1].begin = range.begin;
-					_ranges.remove_at(i);
-				}
-				else
-				{
-					// No gap filled, append returned range to the current
-					range.end = end;
-				}
-				return;
+				remove_free(left);
+				begin = left;
 			}
 		}
+
+		// Merge with a free range starting right after us
+		if (end < _num_ids && _size[end] != 0)
+		{
+			T right_size = _size[end];
+			remove_free(end);
+			end += right_size;
+		}
+
+		insert_free(begin, end - begin);
 	}
 };
@@ -26,7 +26,7 @@ struct resource_creator_t
 	void (*destroy)(void* context, allocator_t* allocator, void* resource_data, void* private_data);
 	allocator_t* allocator;
 	void* context;
-	uint32_t type_hash;
+	uint64_t type_hash;
 };
 
 struct resource_cache_create_params_t
@@ -47,15 +47,15 @@ void resource_cache_destroy(resource_cache_t* cache);
 
 resource_cache_result_t resource_cache_add_creator(resource_cache_t* cache, resource_creator_t* creator);
 
-resource_cache_result_t resource_cache_create_resource(resource_cache_t* cache, uint32_t name_hash, uint32_t type_hash, void* data, size_t size, resource_handle_t* out_handle);
+resource_cache_result_t resource_cache_create_resource(resource_cache_t* cache, uint64_t name_hash, uint64_t type_hash, void* data, size_t size, resource_handle_t* out_handle);
 
-resource_cache_result_t resource_cache_recreate_resource(resource_cache_t* cache, uint32_t name_hash, uint32_t type_hash, void* data, size_t size, resource_handle_t handle);
+resource_cache_result_t resource_cache_recreate_resource(resource_cache_t* cache, uint64_t name_hash, uint64_t type_hash, void* data, size_t size, resource_handle_t handle);
 
-resource_cache_result_t resource_cache_register_resource(resource_cache_t* cache, uint32_t name_hash, uint32_t type_hash, void* resource_data, void* private_data, resource_handle_t* out_handle);
+resource_cache_result_t resource_cache_register_resource(resource_cache_t* cache, uint64_t name_hash, uint64_t type_hash, void* resource_data, void* private_data, resource_handle_t* out_handle);
 
 resource_cache_result_t resource_cache_get_by_name(resource_cache_t* cache, const char* name, resource_handle_t* out_handle);
 
-resource_cache_result_t resource_cache_get_by_hash(resource_cache_t* cache, uint32_t name_hash, resource_handle_t* out_handle);
+resource_cache_result_t resource_cache_get_by_hash(resource_cache_t* cache, uint64_t name_hash, resource_handle_t* out_handle);
 
 resource_cache_result_t resource_cache_release_handle(resource_cache_t* cache, resource_handle_t handle);
 
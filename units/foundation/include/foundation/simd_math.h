@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Batch math kernels for transforms. The kernels work on many entities at
+ * once, with SSE when SIMD_SSE is defined, AVX2 when SIMD_AVX2 is defined
+ * (and the compiler is allowed to emit it) and plain C++ otherwise.
+ *
+ * Matrices are 4x4 floats, column major as in glm, stored back to back.
+ */
+
+/**
+ * Translation, rotation quaternion (x, y, z, w) and scale of one entity.
+ */
+struct transform_t
+{
+	float position[3];
+	float rotation[4];
+	float scale[3];
+};
+
+#define TRANSFORM_NUM_FIELDS (sizeof(transform_t) / sizeof(float))
+
+/**
+ * Transforms with every field in its own array, element i of each array
+ * makes up transform i.
+ */
+struct transform_soa_t
+{
+	float* px;
+	float* py;
+	float* pz;
+	float* qx;
+	float* qy;
+	float* qz;
+	float* qw;
+	float* sx;
+	float* sy;
+	float* sz;
+};
+
+/**
+ * Array i starts field_stride bytes after array i - 1, in the order of transform_t.
+ */
+inline transform_soa_t transform_soa_from_fields(void* first, size_t field_stride)
+{
+	float* f[TRANSFORM_NUM_FIELDS];
+	for (size_t i = 0; i < TRANSFORM_NUM_FIELDS; ++i)
+		f[i] = (float*)((uint8_t*)first + i * field_stride);
+	transform_soa_t soa = { f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8], f[9] };
+	return soa;
+}
+
+/**
+ * out_matrices[i] = translate(p[i]) * rotate(q[i]) * scale(s[i]), the
+ * quaternions have to be normalized.
+ */
+void simd_transform_compose(const transform_soa_t* transforms, size_t count, float* out_matrices);
+
+/**
+ * Same as simd_transform_compose with matrix i written to out_matrices[i],
+ * e.g. straight into mapped render instance data.
+ */
+void simd_transform_compose_scatter(const transform_soa_t* transforms, size_t count, float* const* out_matrices);
+
+/**
+ * out[i] = a[i] * b[i], out may be the same array as b but not as a.
+ */
+void simd_mat4_mul(const float* a, const float* b, float* out, size_t count);
+
+/**
+ * (out_x[i], out_y[i], out_z[i]) = matrices[i] * (x[i], y[i], z[i], 1), the output may be the same arrays as the input.
+ */
+void simd_mat4_transform_points(const float* matrices, const float* x, const float* y, const float* z, float* out_x, float* out_y, float* out_z, size_t count);
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "assert.h"
+#include "allocator.h"
+#include "bits.h"
+
+#include <atomic>
+
+/**
+ * Lock-free bounded single producer, single consumer queue.
+ *
+ * Capacity has to be a power of two so indices wrap with a mask. Head and
+ * tail live on separate cache lines and each side keeps a cached copy of the
+ * other sides index, so the shared lines are only touched when the cached
+ * value says the queue looks full/empty.
+ */
+template<class T>
+struct spsc_queue_t
+{
+	typedef T item_t;
+
+	T* _ptr;
+	size_t _mask;
+	uint8_t _pad0[CACHE_LINE_SIZE - sizeof(T*) - sizeof(size_t)];
+
+	// Consumer side
+	std::atomic<size_t> _head;
+	size_t _tail_cache;
+	uint8_t _pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+	// Producer side
+	std::atomic<size_t> _tail;
+	size_t _head_cache;
+	uint8_t _pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+	void create(allocator_t* allocator, size_t capacity)
+	{
+		ASSERT(_ptr == NULL, "queue was already created");
+		ASSERT(bits_is_pow2(capacity), "queue capacity has to be a power of two");
+		_mask = capacity - 1;
+		_head.store(0, std::memory_order_relaxed);
+		_tail.store(0, std::memory_order_relaxed);
+		_tail_cache = 0;
+		_head_cache = 0;
+		_ptr = (T*)ALLOCATOR_ALLOC(allocator, capacity * sizeof(T), ALIGNOF(T));
+	}
+
+	void destroy(allocator_t* allocator)
+	{
+		ALLOCATOR_FREE(allocator, _ptr);
+	}
+
+	size_t capacity() const
+	{
+		return _mask + 1;
+	}
+
+	/**
+	 * Approximate number of items, exact only when called with both sides idle.
+	 */
+	size_t count() const
+	{
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const
+	{
+		return count() == 0;
+	}
+
+	bool any() const
+	{
+		return count() != 0;
+	}
+
+	// Producer only
+	bool try_push(const T& t)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head_cache > _mask)
+		{
+			_head_cache = _head.load(std::memory_order_acquire);
+			if (tail - _head_cache > _mask)
+				return false;
+		}
+
+		_ptr[tail & _mask] = t;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Producer only, returns the number of items pushed
+	size_t push_bulk(const T* items, size_t num_items)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		size_t space = _mask + 1 - (tail - _head_cache);
+		if (space < num_items)
+		{
+			_head_cache = _head.load(std::memory_order_acquire);
+			space = _mask + 1 - (tail - _head_cache);
+		}
+
+		size_t n = num_items < space ? num_items : space;
+		for (size_t i = 0; i < n; ++i)
+			_ptr[(tail + i) & _mask] = items[i];
+
+		if (n != 0)
+			_tail.store(tail + n, std::memory_order_release);
+		return n;
+	}
+
+	// Consumer only
+	bool try_pop(T* out_t)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail_cache)
+		{
+			_tail_cache = _tail.load(std::memory_order_acquire);
+			if (head == _tail_cache)
+				return false;
+		}
+
+		*out_t = _ptr[head & _mask];
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, returns the number of items popped
+	size_t pop_bulk(T* out_items, size_t max_items)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		size_t avail = _tail_cache - head;
+		if (avail < max_items)
+		{
+			_tail_cache = _tail.load(std::memory_order_acquire);
+			avail = _tail_cache - head;
+		}
+
+		size_t n = max_items < avail ? max_items : avail;
+		for (size_t i = 0; i < n; ++i)
+			out_items[i] = _ptr[(head + i) & _mask];
+
+		if (n != 0)
+			_head.store(head + n, std::memory_order_release);
+		return n;
+	}
+};
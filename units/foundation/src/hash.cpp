@@ -1,7 +1,15 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <foundation/hash.h>
 
+#if defined(HASH_REGISTRY_ENABLE)
+#	include <mutex>
+#	include <string>
+#	include <unordered_map>
+#endif
+
 uint32_t hash_string(const char* str)
 {
 	return hash_buffer(str, strlen(str));
@@ -23,3 +31,178 @@ uint32_t hash_buffer(const void* buf, size_t size)
 	hash += (hash << 15);
 	return hash;
 }
+
+uint64_t hash_string_64(const char* str)
+{
+	return hash_buffer_64(str, strlen(str));
+}
+
+uint64_t hash_buffer_64(const void* buf, size_t size)
+{
+	// FNV-1a
+	const uint8_t* key = (const uint8_t*)buf;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= key[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#if defined(HASH_REGISTRY_ENABLE)
+
+struct hash_registry_t
+{
+	std::mutex mutex;
+	std::unordered_map<uint64_t, std::string> strings;
+};
+
+static hash_registry_t& hash_registry_get()
+{
+	static hash_registry_t registry;
+	return registry;
+}
+
+bool hash_registry_add(uint64_t hash, const char* str)
+{
+	hash_registry_t& registry = hash_registry_get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	auto iter = registry.strings.find(hash);
+	if (iter == registry.strings.end())
+	{
+		registry.strings[hash] = str;
+		return true;
+	}
+
+	if (iter->second == str)
+		return true;
+
+	fprintf(stderr, "Error: hash collision, \"%s\" and \"%s\" both hash to 0x%016llx\n", iter->second.c_str(), str, (unsigned long long)hash);
+	return false;
+}
+
+const char* hash_registry_lookup(uint64_t hash)
+{
+	hash_registry_t& registry = hash_registry_get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	auto iter = registry.strings.find(hash);
+	return iter != registry.strings.end() ? iter->second.c_str() : nullptr;
+}
+
+#else
+
+bool hash_registry_add(uint64_t /*hash*/, const char* /*str*/)
+{
+	return true;
+}
+
+const char* hash_registry_lookup(uint64_t /*hash*/)
+{
+	return nullptr;
+}
+
+#endif
+
+/**
+ * Checks names against every line of the manifest, a missing manifest has no names yet.
+ * Sets out_listed[i] if names[i] is already in the manifest.
+ */
+static bool hash_manifest_check(const char* manifest_path, const char* const* names, const uint64_t* hashes, size_t num_names, bool* out_listed)
+{
+	for (size_t i = 0; i < num_names; ++i)
+		out_listed[i] = false;
+
+	FILE* file = fopen(manifest_path, "rb");
+	if (file == nullptr)
+		return true;
+
+	bool ok = true;
+	char line[1024];
+	while (ok && fgets(line, sizeof(line), file) != nullptr)
+	{
+		// Skips a line still being appended by another compiler, it is checked by that compiler
+		char* end = strchr(line, '\n');
+		if (end == nullptr || end - line < 18 || line[16] != ' ')
+			continue;
+		*end = '\0';
+
+		uint64_t hash = strtoull(line, nullptr, 16);
+		const char* name = line + 17;
+		for (size_t i = 0; i < num_names; ++i)
+		{
+			if (hashes[i] != hash)
+				continue;
+
+			if (strcmp(names[i], name) == 0)
+				out_listed[i] = true;
+			else
+			{
+				fprintf(stderr, "Error: hash collision, \"%s\" and \"%s\" both hash to 0x%016llx (%s)\n", name, names[i], (unsigned long long)hash, manifest_path);
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
+
+bool hash_manifest_add(const char* manifest_path, const char* const* names, size_t num_names)
+{
+	if (num_names == 0)
+		return true;
+
+	uint64_t* hashes = (uint64_t*)malloc(num_names * sizeof(uint64_t));
+	bool* listed = (bool*)malloc(num_names * sizeof(bool));
+	for (size_t i = 0; i < num_names; ++i)
+		hashes[i] = hash_string_64(names[i]);
+
+	bool ok = hash_manifest_check(manifest_path, names, hashes, num_names, listed);
+
+	size_t size = 0;
+	for (size_t i = 0; ok && i < num_names; ++i)
+		size += listed[i] ? 0 : 17 + strlen(names[i]) + 1;
+
+	if (ok && size > 0)
+	{
+		// Appended with a single write so lines of compilers running at the same time do not interleave
+		char* text = (char*)malloc(size + 1);
+		size_t length = 0;
+		for (size_t i = 0; i < num_names; ++i)
+		{
+			bool duplicate = listed[i];
+			for (size_t j = 0; j < i && !duplicate; ++j)
+				duplicate = !listed[j] && strcmp(names[i], names[j]) == 0;
+			if (!duplicate)
+				length += (size_t)sprintf(text + length, "%016llx %s\n", (unsigned long long)hashes[i], names[i]);
+		}
+
+		FILE* file = fopen(manifest_path, "ab");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Error: could not open hash manifest \"%s\" for writing\n", manifest_path);
+			ok = false;
+		}
+		else
+		{
+			setvbuf(file, nullptr, _IOFBF, length);
+			ok = fwrite(text, 1, length, file) == length;
+			ok = fclose(file) == 0 && ok;
+			if (!ok)
+				fprintf(stderr, "Error: could not write hash manifest \"%s\"\n", manifest_path);
+		}
+		free(text);
+
+		// Catches names appended by compilers that read the manifest before we appended to it
+		if (ok)
+			ok = hash_manifest_check(manifest_path, names, hashes, num_names, listed);
+	}
+
+	free(listed);
+	free(hashes);
+	return ok;
+}
@@ -34,8 +34,8 @@ enum job_command_t
 struct job_entry_t
 {
 	job_function_t function;
-	uint32_t name_hash;
-	uint32_t bundle_name_hash;
+	uint64_t name_hash;
+	uint64_t bundle_name_hash;
 };
 
 struct job_bundle_t
@@ -46,13 +46,13 @@ struct job_bundle_t
 #elif defined(FAMILY_UNIX)
 	void* handle;
 #endif //#if defined(FAMILY_*)
-	uint32_t name_hash;
+	uint64_t name_hash;
 };
 
 struct job_cached_function_t
 {
 	job_function_t function;
-	uint32_t name_hash;
+	uint64_t name_hash;
 };
 
 struct job_queue_slot_t : public list_node_t<job_queue_slot_t>
@@ -71,6 +71,7 @@ struct job_context_t
 
 	allocator_t* incheap;
 	job_queue_slot_t* curr_job;
+	uint32_t worker_index;
 };
 
 struct job_event_t : public list_node_t<job_event_t>
@@ -79,8 +80,8 @@ struct job_event_t : public list_node_t<job_event_t>
 	std::atomic<uint64_t> deps;
 };
 
-typedef std::unordered_map<uint32_t, job_bundle_t> bundle_map; // TODO: use own hash table?
-typedef std::unordered_map<uint32_t, job_entry_t> function_map; // TODO: use own hash table?
+typedef std::unordered_map<uint64_t, job_bundle_t> bundle_map; // TODO: use own hash table?
+typedef std::unordered_map<uint64_t, job_entry_t> function_map; // TODO: use own hash table?
 
 struct job_system_t
 {
@@ -139,7 +140,7 @@ static void job_run_one(job_system_t* system, job_context_t* context, bool retur
 		lock.unlock();
 
 		context->curr_job = job;
-		job->function(context, &job->data);
+		job->function(context, job->data);
 		allocator_incheap_reset(context->incheap);
 		context->curr_job = nullptr;
 
@@ -190,6 +191,7 @@ job_system_t* job_system_create(const job_system_create_params_t* params)
 		system->threads[i].command = JOB_COMMAND_READY;
 		system->threads[i].incheap = allocator_incheap_create(system->alloc, params->worker_thread_temp_size);
 		system->threads[i].curr_job = nullptr;
+		system->threads[i].worker_index = (uint32_t)i;
 	}
 
 	system->max_job_argument_size = params->max_job_argument_size;
@@ -199,6 +201,7 @@ job_system_t* job_system_create(const job_system_create_params_t* params)
 	memset(&system->main_thread_context, 0, sizeof(system->main_thread_context));
 	system->main_thread_context.system = system;
 	system->main_thread_context.incheap = allocator_incheap_create(system->alloc, params->worker_thread_temp_size);
+	system->main_thread_context.worker_index = (uint32_t)system->threads.length();
 
 	return system;
 }
@@ -260,7 +263,7 @@ job_system_result_t job_system_load_bundle(job_system_t* system, const char* bun
 #elif defined(FAMILY_UNIX)
 	void* handle = NULL;
 #endif //#if defined(FAMILY_*)
-	uint32_t bundle_name_hash = hash_string(bundle_name);
+	uint64_t bundle_name_hash = hash_string_64(bundle_name);
 
 	bundle_map::iterator bundle_iter = system->bundles.find(bundle_name_hash);
 
@@ -340,10 +343,13 @@ job_system_result_t job_system_load_bundle(job_system_t* system, const char* bun
 				job_entry_t entry =
 				{
 					table->function,
-					hash_string(table->name),
+					hash_string_64(table->name),
 					bundle.name_hash
 				};
 
+				bool registered = hash_registry_add(entry.name_hash, table->name);
+				ASSERT(registered, "job function name \"%s\" collides with another job function name", table->name);
+
 				function_map::iterator function_iter = system->functions.find(entry.name_hash);
 				ASSERT(function_iter == system->functions.end());
 
@@ -363,7 +369,7 @@ job_system_result_t job_system_load_bundle(job_system_t* system, const char* bun
 	return JOB_SYSTEM_COULD_NOT_LOAD_BUNDLE;
 }
 
-job_system_result_t job_system_cache_function(job_system_t* system, uint32_t function_name_hash, job_cached_function_t** out_cached_function)
+job_system_result_t job_system_cache_function(job_system_t* system, uint64_t function_name_hash, job_cached_function_t** out_cached_function)
 {
 	function_map::iterator iter = system->functions.find(function_name_hash);
 	if (iter == system->functions.end())
@@ -496,12 +502,24 @@ job_system_result_t job_system_kick_ptr(job_system_t* system, job_function_t fun
 	return res;
 }
 
+job_system_result_t job_system_get_num_workers(job_system_t* system, uint32_t* out_num_workers)
+{
+	*out_num_workers = (uint32_t)system->threads.length() + 1;
+	return JOB_SYSTEM_OK;
+}
+
 job_system_result_t job_context_get_allocator(job_context_t* context, allocator_t** out_allocator)
 {
 	*out_allocator = context->incheap;
 	return JOB_SYSTEM_OK;
 }
 
+job_system_result_t job_context_get_worker_index(job_context_t* context, uint32_t* out_worker_index)
+{
+	*out_worker_index = context->worker_index;
+	return JOB_SYSTEM_OK;
+}
+
 job_system_result_t job_context_kick(job_context_t* context, job_cached_function_t* cached_function, size_t num_jobs, void** args, size_t arg_size)
 {
 	return job_context_kick_ptr(context, cached_function->function, num_jobs, args, arg_size);
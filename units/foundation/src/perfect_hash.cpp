@@ -0,0 +1,106 @@
+#include <string.h>
+
+#include <foundation/assert.h>
+#include <foundation/perfect_hash.h>
+
+static const uint32_t PERFECT_HASH_MAX_SEED = 1 << 24;
+
+bool perfect_hash_build(allocator_t* allocator, const uint64_t* keys, size_t num_keys, uint32_t* out_seeds, uint32_t* out_slots)
+{
+	if (num_keys == 0)
+		return true;
+
+	uint32_t n = (uint32_t)num_keys;
+	uint32_t num_buckets = perfect_hash_num_seeds(num_keys);
+
+	uint32_t* bucket_start = ALLOCATOR_ALLOC_ARRAY(allocator, num_buckets + 1, uint32_t);
+	uint32_t* bucket_order = ALLOCATOR_ALLOC_ARRAY(allocator, num_buckets, uint32_t);
+	uint32_t* bucket_keys = ALLOCATOR_ALLOC_ARRAY(allocator, n, uint32_t);
+	uint32_t* key_bucket = ALLOCATOR_ALLOC_ARRAY(allocator, n, uint32_t);
+	uint32_t* slot_taken = ALLOCATOR_ALLOC_ARRAY(allocator, n, uint32_t);
+	uint32_t* scratch_slots = ALLOCATOR_ALLOC_ARRAY(allocator, n, uint32_t);
+
+	// Counting sort keys into buckets
+	memset(bucket_start, 0, (num_buckets + 1) * sizeof(uint32_t));
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		key_bucket[i] = perfect_hash_reduce(perfect_hash_mix(keys[i], 0), num_buckets);
+		bucket_start[key_bucket[i] + 1]++;
+	}
+	for (uint32_t b = 0; b < num_buckets; ++b)
+		bucket_start[b + 1] += bucket_start[b];
+	memcpy(slot_taken, bucket_start, num_buckets * sizeof(uint32_t)); // borrowed as insert cursor
+	for (uint32_t i = 0; i < n; ++i)
+		bucket_keys[slot_taken[key_bucket[i]]++] = i;
+
+	// Place the biggest buckets first while there is most room
+	for (uint32_t b = 0; b < num_buckets; ++b)
+		bucket_order[b] = b;
+	for (uint32_t i = 1; i < num_buckets; ++i)
+	{
+		uint32_t b = bucket_order[i];
+		uint32_t size = bucket_start[b + 1] - bucket_start[b];
+		uint32_t j = i;
+		for (; j > 0 && bucket_start[bucket_order[j - 1] + 1] - bucket_start[bucket_order[j - 1]] < size; --j)
+			bucket_order[j] = bucket_order[j - 1];
+		bucket_order[j] = b;
+	}
+
+	memset(slot_taken, 0, n * sizeof(uint32_t));
+	bool success = true;
+	for (uint32_t ib = 0; ib < num_buckets && success; ++ib)
+	{
+		uint32_t b = bucket_order[ib];
+		uint32_t begin = bucket_start[b];
+		uint32_t end = bucket_start[b + 1];
+		out_seeds[b] = 0;
+		if (begin == end)
+			continue;
+
+		for (uint32_t i = begin; i < end; ++i)
+			for (uint32_t j = i + 1; j < end; ++j)
+				if (keys[bucket_keys[i]] == keys[bucket_keys[j]])
+					success = false;
+		if (!success)
+			break;
+
+		uint32_t seed = 1;
+		for (; seed < PERFECT_HASH_MAX_SEED; ++seed)
+		{
+			uint32_t i = begin;
+			for (; i < end; ++i)
+			{
+				uint32_t slot = perfect_hash_reduce(perfect_hash_mix(keys[bucket_keys[i]], seed), n);
+				if (slot_taken[slot])
+					break;
+				slot_taken[slot] = 1;
+				scratch_slots[i] = slot;
+			}
+
+			if (i == end)
+				break;
+
+			// Roll back the slots taken by this attempt
+			for (uint32_t k = begin; k < i; ++k)
+				slot_taken[scratch_slots[k]] = 0;
+		}
+
+		if (seed == PERFECT_HASH_MAX_SEED)
+		{
+			success = false;
+			break;
+		}
+
+		out_seeds[b] = seed;
+		for (uint32_t i = begin; i < end; ++i)
+			out_slots[bucket_keys[i]] = scratch_slots[i];
+	}
+
+	ALLOCATOR_FREE(allocator, bucket_start);
+	ALLOCATOR_FREE(allocator, bucket_order);
+	ALLOCATOR_FREE(allocator, bucket_keys);
+	ALLOCATOR_FREE(allocator, key_bucket);
+	ALLOCATOR_FREE(allocator, slot_taken);
+	ALLOCATOR_FREE(allocator, scratch_slots);
+	return success;
+}
@@ -9,14 +9,14 @@ struct resource_t
 {
 	void* resource_data;
 	void* private_data;
-	uint32_t type_hash;
-	uint32_t name_hash;
+	uint64_t type_hash;
+	uint64_t name_hash;
 	uint32_t ref_count;
 	uint32_t flags;
 };
 
-typedef table_t<uint32_t, resource_creator_t> resource_creator_map_t;
-typedef table_t<uint32_t, resource_t> resource_map_t;
+typedef table_t<uint64_t, resource_creator_t> resource_creator_map_t;
+typedef table_t<uint64_t, resource_t> resource_map_t;
 
 struct resource_cache_t
 {
@@ -57,7 +57,7 @@ resource_cache_result_t resource_cache_add_creator(resource_cache_t* cache, reso
 	return RESOURCE_CACHE_RESULT_OK;
 }
 
-resource_cache_result_t resource_cache_recreate_resource(resource_cache_t* cache, uint32_t name_hash, uint32_t type_hash, void* data, size_t size, resource_handle_t handle)
+resource_cache_result_t resource_cache_recreate_resource(resource_cache_t* cache, uint64_t name_hash, uint64_t type_hash, void* data, size_t size, resource_handle_t handle)
 {
 	resource_t* resource = *cache->handle_pool.handle_to_pointer(handle);
 	ASSERT(resource == cache->resources.fetch(name_hash));
@@ -78,7 +78,7 @@ resource_cache_result_t resource_cache_recreate_resource(resource_cache_t* cache
 	return RESOURCE_CACHE_RESULT_OK;
 }
 
-resource_cache_result_t resource_cache_create_resource(resource_cache_t* cache, uint32_t name_hash, uint32_t type_hash, void* data, size_t size, resource_handle_t* out_handle)
+resource_cache_result_t resource_cache_create_resource(resource_cache_t* cache, uint64_t name_hash, uint64_t type_hash, void* data, size_t size, resource_handle_t* out_handle)
 {
 	if(cache->handle_pool.full())
 		return RESOURCE_CACHE_RESULT_TOO_MANY_RESOURCE_HANDLES;
@@ -105,7 +105,7 @@ resource_cache_result_t resource_cache_create_resource(resource_cache_t* cache,
 	return resource_cache_register_resource(cache, name_hash, type_hash, resource_data, private_data, out_handle);
 }
 
-resource_cache_result_t resource_cache_register_resource(resource_cache_t* cache, uint32_t name_hash, uint32_t type_hash, void* resource_data, void* private_data, resource_handle_t* out_handle)
+resource_cache_result_t resource_cache_register_resource(resource_cache_t* cache, uint64_t name_hash, uint64_t type_hash, void* resource_data, void* private_data, resource_handle_t* out_handle)
 {
 	if(cache->handle_pool.full())
 		return RESOURCE_CACHE_RESULT_TOO_MANY_RESOURCE_HANDLES;
@@ -124,7 +124,7 @@ resource_cache_result_t resource_cache_register_resource(resource_cache_t* cache
 	return resource_cache_get_by_hash(cache, name_hash, out_handle);
 }
 
-static resource_cache_result_t resource_cache_try_get(resource_cache_t* cache, uint32_t name_hash, resource_handle_t* out_handle)
+static resource_cache_result_t resource_cache_try_get(resource_cache_t* cache, uint64_t name_hash, resource_handle_t* out_handle)
 {
 
 	if(cache->resources.has_key(name_hash))
@@ -146,7 +146,9 @@ static resource_cache_result_t resource_cache_try_get(resource_cache_t* cache, u
 
 resource_cache_result_t resource_cache_get_by_name(resource_cache_t* cache, const char* name, resource_handle_t* out_handle)
 {
-	uint32_t name_hash = hash_string(name);
+	uint64_t name_hash = hash_string_64(name);
+	bool registered = hash_registry_add(name_hash, name);
+	ASSERT(registered, "resource name \"%s\" collides with another resource name", name);
 
 	return resource_cache_try_get(cache, name_hash, out_handle);
 
@@ -154,7 +156,7 @@ resource_cache_result_t resource_cache_get_by_name(resource_cache_t* cache, cons
 	// TODO: add stream in resource
 }
 
-resource_cache_result_t resource_cache_get_by_hash(resource_cache_t* cache, uint32_t name_hash, resource_handle_t* out_handle)
+resource_cache_result_t resource_cache_get_by_hash(resource_cache_t* cache, uint64_t name_hash, resource_handle_t* out_handle)
 {
 	return resource_cache_try_get(cache, name_hash, out_handle);
 
@@ -0,0 +1,327 @@
+#include <foundation/simd_math.h>
+
+#if defined(SIMD_AVX2)
+#	include <immintrin.h>
+#elif defined(SIMD_SSE)
+#	include <xmmintrin.h>
+#endif
+
+/******************************************************************************\
+*
+*  Vector backend, one lane per entity
+*
+\******************************************************************************/
+
+#if defined(SIMD_AVX2)
+
+#define SIMD_WIDTH 8
+typedef __m256 vfloat_t;
+
+static inline vfloat_t v_load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void v_store(float* p, vfloat_t v) { _mm256_storeu_ps(p, v); }
+static inline vfloat_t v_set1(float f) { return _mm256_set1_ps(f); }
+static inline vfloat_t v_add(vfloat_t a, vfloat_t b) { return _mm256_add_ps(a, b); }
+static inline vfloat_t v_sub(vfloat_t a, vfloat_t b) { return _mm256_sub_ps(a, b); }
+static inline vfloat_t v_mul(vfloat_t a, vfloat_t b) { return _mm256_mul_ps(a, b); }
+
+// Transposes 4x4 blocks within each 128 bit half
+static inline void v_transpose(vfloat_t* r0, vfloat_t* r1, vfloat_t* r2, vfloat_t* r3)
+{
+	vfloat_t t0 = _mm256_unpacklo_ps(*r0, *r1);
+	vfloat_t t1 = _mm256_unpacklo_ps(*r2, *r3);
+	vfloat_t t2 = _mm256_unpackhi_ps(*r0, *r1);
+	vfloat_t t3 = _mm256_unpackhi_ps(*r2, *r3);
+	*r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	*r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	*r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	*r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+/**
+ * Writes column c of SIMD_WIDTH matrices from one vector per row.
+ */
+static inline void v_store_column(float* m, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	v_transpose(&r0, &r1, &r2, &r3);
+	vfloat_t r[4] = { r0, r1, r2, r3 };
+	for (size_t i = 0; i < 4; ++i)
+	{
+		_mm_storeu_ps(m + i * 16 + c * 4, _mm256_castps256_ps128(r[i]));
+		_mm_storeu_ps(m + (i + 4) * 16 + c * 4, _mm256_extractf128_ps(r[i], 1));
+	}
+}
+
+/**
+ * Reads column c of SIMD_WIDTH matrices into one vector per row.
+ */
+static inline void v_load_column(const float* m, size_t c, vfloat_t* r0, vfloat_t* r1, vfloat_t* r2, vfloat_t* r3)
+{
+	vfloat_t r[4];
+	for (size_t i = 0; i < 4; ++i)
+		r[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(m + i * 16 + c * 4)), _mm_loadu_ps(m + (i + 4) * 16 + c * 4), 1);
+	v_transpose(&r[0], &r[1], &r[2], &r[3]);
+	*r0 = r[0];
+	*r1 = r[1];
+	*r2 = r[2];
+	*r3 = r[3];
+}
+
+/**
+ * Like v_store_column with every matrix at its own address.
+ */
+static inline void v_scatter_column(float* const* m, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	v_transpose(&r0, &r1, &r2, &r3);
+	vfloat_t r[4] = { r0, r1, r2, r3 };
+	for (size_t i = 0; i < 4; ++i)
+	{
+		_mm_storeu_ps(m[i] + c * 4, _mm256_castps256_ps128(r[i]));
+		_mm_storeu_ps(m[i + 4] + c * 4, _mm256_extractf128_ps(r[i], 1));
+	}
+}
+
+#elif defined(SIMD_SSE)
+
+#define SIMD_WIDTH 4
+typedef __m128 vfloat_t;
+
+static inline vfloat_t v_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void v_store(float* p, vfloat_t v) { _mm_storeu_ps(p, v); }
+static inline vfloat_t v_set1(float f) { return _mm_set1_ps(f); }
+static inline vfloat_t v_add(vfloat_t a, vfloat_t b) { return _mm_add_ps(a, b); }
+static inline vfloat_t v_sub(vfloat_t a, vfloat_t b) { return _mm_sub_ps(a, b); }
+static inline vfloat_t v_mul(vfloat_t a, vfloat_t b) { return _mm_mul_ps(a, b); }
+
+static inline void v_store_column(float* m, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(m + 0 * 16 + c * 4, r0);
+	_mm_storeu_ps(m + 1 * 16 + c * 4, r1);
+	_mm_storeu_ps(m + 2 * 16 + c * 4, r2);
+	_mm_storeu_ps(m + 3 * 16 + c * 4, r3);
+}
+
+static inline void v_scatter_column(float* const* m, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(m[0] + c * 4, r0);
+	_mm_storeu_ps(m[1] + c * 4, r1);
+	_mm_storeu_ps(m[2] + c * 4, r2);
+	_mm_storeu_ps(m[3] + c * 4, r3);
+}
+
+static inline void v_load_column(const float* m, size_t c, vfloat_t* r0, vfloat_t* r1, vfloat_t* r2, vfloat_t* r3)
+{
+	vfloat_t t0 = _mm_loadu_ps(m + 0 * 16 + c * 4);
+	vfloat_t t1 = _mm_loadu_ps(m + 1 * 16 + c * 4);
+	vfloat_t t2 = _mm_loadu_ps(m + 2 * 16 + c * 4);
+	vfloat_t t3 = _mm_loadu_ps(m + 3 * 16 + c * 4);
+	_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+	*r0 = t0;
+	*r1 = t1;
+	*r2 = t2;
+	*r3 = t3;
+}
+
+#else
+
+#define SIMD_WIDTH 1
+typedef float vfloat_t;
+
+static inline vfloat_t v_load(const float* p) { return *p; }
+static inline void v_store(float* p, vfloat_t v) { *p = v; }
+static inline vfloat_t v_set1(float f) { return f; }
+static inline vfloat_t v_add(vfloat_t a, vfloat_t b) { return a + b; }
+static inline vfloat_t v_sub(vfloat_t a, vfloat_t b) { return a - b; }
+static inline vfloat_t v_mul(vfloat_t a, vfloat_t b) { return a * b; }
+
+static inline void v_store_column(float* m, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	m[c * 4 + 0] = r0;
+	m[c * 4 + 1] = r1;
+	m[c * 4 + 2] = r2;
+	m[c * 4 + 3] = r3;
+}
+
+static inline void v_scatter_column(float* const* m, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	v_store_column(m[0], c, r0, r1, r2, r3);
+}
+
+static inline void v_load_column(const float* m, size_t c, vfloat_t* r0, vfloat_t* r1, vfloat_t* r2, vfloat_t* r3)
+{
+	*r0 = m[c * 4 + 0];
+	*r1 = m[c * 4 + 1];
+	*r2 = m[c * 4 + 2];
+	*r3 = m[c * 4 + 3];
+}
+
+#endif
+
+/******************************************************************************\
+*
+*  Kernels
+*
+\******************************************************************************/
+
+// Matrices back to back or one address per matrix
+static inline void transform_store_column(float* out, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	v_store_column(out, c, r0, r1, r2, r3);
+}
+
+static inline void transform_store_column(float* const* out, size_t c, vfloat_t r0, vfloat_t r1, vfloat_t r2, vfloat_t r3)
+{
+	v_scatter_column(out, c, r0, r1, r2, r3);
+}
+
+/**
+ * Composes SIMD_WIDTH transforms starting at i.
+ */
+template<class Out>
+static inline void transform_compose_lanes(const transform_soa_t* t, size_t i, Out out)
+{
+	vfloat_t x = v_load(t->qx + i);
+	vfloat_t y = v_load(t->qy + i);
+	vfloat_t z = v_load(t->qz + i);
+	vfloat_t w = v_load(t->qw + i);
+
+	vfloat_t one = v_set1(1.0f);
+	vfloat_t x2 = v_add(x, x);
+	vfloat_t y2 = v_add(y, y);
+	vfloat_t z2 = v_add(z, z);
+	vfloat_t xx = v_mul(x, x2);
+	vfloat_t yy = v_mul(y, y2);
+	vfloat_t zz = v_mul(z, z2);
+	vfloat_t xy = v_mul(x, y2);
+	vfloat_t xz = v_mul(x, z2);
+	vfloat_t yz = v_mul(y, z2);
+	vfloat_t wx = v_mul(w, x2);
+	vfloat_t wy = v_mul(w, y2);
+	vfloat_t wz = v_mul(w, z2);
+
+	vfloat_t sx = v_load(t->sx + i);
+	vfloat_t sy = v_load(t->sy + i);
+	vfloat_t sz = v_load(t->sz + i);
+	vfloat_t zero = v_set1(0.0f);
+
+	transform_store_column(out, 0,
+		v_mul(v_sub(one, v_add(yy, zz)), sx),
+		v_mul(v_add(xy, wz), sx),
+		v_mul(v_sub(xz, wy), sx),
+		zero);
+	transform_store_column(out, 1,
+		v_mul(v_sub(xy, wz), sy),
+		v_mul(v_sub(one, v_add(xx, zz)), sy),
+		v_mul(v_add(yz, wx), sy),
+		zero);
+	transform_store_column(out, 2,
+		v_mul(v_add(xz, wy), sz),
+		v_mul(v_sub(yz, wx), sz),
+		v_mul(v_sub(one, v_add(xx, yy)), sz),
+		zero);
+	transform_store_column(out, 3, v_load(t->px + i), v_load(t->py + i), v_load(t->pz + i), one);
+}
+
+static void transform_compose_one(const transform_soa_t* t, size_t i, float* m)
+{
+	float x = t->qx[i], y = t->qy[i], z = t->qz[i], w = t->qw[i];
+	float sx = t->sx[i], sy = t->sy[i], sz = t->sz[i];
+
+	m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+	m[1] = 2.0f * (x * y + w * z) * sx;
+	m[2] = 2.0f * (x * z - w * y) * sx;
+	m[3] = 0.0f;
+	m[4] = 2.0f * (x * y - w * z) * sy;
+	m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+	m[6] = 2.0f * (y * z + w * x) * sy;
+	m[7] = 0.0f;
+	m[8] = 2.0f * (x * z + w * y) * sz;
+	m[9] = 2.0f * (y * z - w * x) * sz;
+	m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+	m[11] = 0.0f;
+	m[12] = t->px[i];
+	m[13] = t->py[i];
+	m[14] = t->pz[i];
+	m[15] = 1.0f;
+}
+
+void simd_transform_compose(const transform_soa_t* transforms, size_t count, float* out_matrices)
+{
+	size_t i = 0;
+	for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+		transform_compose_lanes(transforms, i, out_matrices + i * 16);
+	for (; i < count; ++i)
+		transform_compose_one(transforms, i, out_matrices + i * 16);
+}
+
+void simd_transform_compose_scatter(const transform_soa_t* transforms, size_t count, float* const* out_matrices)
+{
+	size_t i = 0;
+	for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+		transform_compose_lanes(transforms, i, out_matrices + i);
+	for (; i < count; ++i)
+		transform_compose_one(transforms, i, out_matrices[i]);
+}
+
+void simd_mat4_mul(const float* a, const float* b, float* out, size_t count)
+{
+#if defined(SIMD_SSE) || defined(SIMD_AVX2)
+	// One matrix at a time, each column of out is a sum of the columns of a
+	for (size_t i = 0; i < count; ++i, a += 16, b += 16, out += 16)
+	{
+		__m128 a0 = _mm_loadu_ps(a + 0);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+		for (size_t c = 0; c < 4; ++c)
+		{
+			__m128 col = _mm_mul_ps(a0, _mm_set1_ps(b[c * 4 + 0]));
+			col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[c * 4 + 1])));
+			col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[c * 4 + 2])));
+			col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b[c * 4 + 3])));
+			_mm_storeu_ps(out + c * 4, col);
+		}
+	}
+#else
+	for (size_t i = 0; i < count; ++i, a += 16, b += 16, out += 16)
+	{
+		for (size_t c = 0; c < 4; ++c)
+		{
+			float b0 = b[c * 4 + 0], b1 = b[c * 4 + 1], b2 = b[c * 4 + 2], b3 = b[c * 4 + 3];
+			for (size_t r = 0; r < 4; ++r)
+				out[c * 4 + r] = a[r] * b0 + a[4 + r] * b1 + a[8 + r] * b2 + a[12 + r] * b3;
+		}
+	}
+#endif
+}
+
+void simd_mat4_transform_points(const float* matrices, const float* x, const float* y, const float* z, float* out_x, float* out_y, float* out_z, size_t count)
+{
+	size_t i = 0;
+	for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+	{
+		const float* m = matrices + i * 16;
+		vfloat_t c[4][4];
+		for (size_t j = 0; j < 4; ++j)
+			v_load_column(m, j, &c[j][0], &c[j][1], &c[j][2], &c[j][3]);
+
+		vfloat_t px = v_load(x + i);
+		vfloat_t py = v_load(y + i);
+		vfloat_t pz = v_load(z + i);
+		vfloat_t r[3];
+		for (size_t j = 0; j < 3; ++j)
+			r[j] = v_add(v_add(v_mul(c[0][j], px), v_mul(c[1][j], py)), v_add(v_mul(c[2][j], pz), c[3][j]));
+		v_store(out_x + i, r[0]);
+		v_store(out_y + i, r[1]);
+		v_store(out_z + i, r[2]);
+	}
+	for (; i < count; ++i)
+	{
+		const float* m = matrices + i * 16;
+		float px = x[i], py = y[i], pz = z[i];
+		out_x[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+		out_y[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+		out_z[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+	}
+}
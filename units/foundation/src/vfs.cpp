@@ -1,12 +1,12 @@
 #include <foundation/array.h>
+#include <foundation/bits.h>
 #include <foundation/objpool.h>
-#include <foundation/circular_queue.h>
+#include <foundation/spsc_queue.h>
+#include <foundation/blocking_queue.h>
 
 #include <foundation/vfs.h>
 
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 
 typedef struct vfs_mount_t
 {
@@ -25,16 +25,14 @@ struct vfs_request_data_t
 struct vfs_t
 {
 	allocator_t* allocator;
-	volatile bool thread_exit;
 
 	array_t<vfs_mount_t> mounts;
 
+	// Requests are begun and ended from a single thread, the vfs thread only reads the request data
 	objpool_t<vfs_request_data_t, vfs_request_t> request_pool;
-	circular_queue_t<vfs_request_t> request_queue;
+	blocking_queue_t<spsc_queue_t<vfs_request_t>> request_queue;
 
 	std::thread thread;
-	std::mutex mutex;
-	std::condition_variable cond;
 };
 
 static void vfs_read_request(vfs_t* vfs, allocator_t* allocator, vfs_request_data_t* request)
@@ -56,29 +54,11 @@ static void vfs_read_request(vfs_t* vfs, allocator_t* allocator, vfs_request_dat
 
 static void vfs_thread(vfs_t* vfs)
 {
-	while(!vfs->thread_exit)
+	vfs_request_t id;
+	while(vfs->request_queue.pop(&id))
 	{
-
-		vfs_request_data_t* request = nullptr;
-		{
-			std::unique_lock<std::mutex> lock(vfs->mutex);
-
-			if (vfs->request_queue.empty())
-			{
-				vfs->cond.wait(lock);
-			}
-
-			if (vfs->request_queue.any())
-			{
-				vfs_request_t id = vfs->request_queue.get();
-				request = vfs->request_pool.handle_to_pointer(id);
-			}
-		}
-
-		if (request != nullptr)
-		{
-			vfs_read_request(vfs, vfs->allocator, request);
-		}
+		vfs_request_data_t* request = vfs->request_pool.handle_to_pointer(id);
+		vfs_read_request(vfs, vfs->allocator, request);
 	}
 }
 
@@ -86,11 +66,10 @@ vfs_t* vfs_create(const vfs_create_params_t* params)
 {
 	vfs_t* vfs = ALLOCATOR_NEW(params->allocator, vfs_t);
 	vfs->allocator = params->allocator;
-	vfs->thread_exit = false;
 
 	vfs->mounts.create(params->allocator, params->max_mounts);
 	vfs->request_pool.create(params->allocator, params->max_requests);
-	vfs->request_queue.create(params->allocator, params->max_requests);
+	vfs->request_queue.create(params->allocator, bits_next_pow2(params->max_requests));
 
 	vfs->thread = std::thread(vfs_thread, vfs);
 
@@ -99,8 +78,7 @@ vfs_t* vfs_create(const vfs_create_params_t* params)
 
 void vfs_destroy(vfs_t* vfs)
 {
-	vfs->thread_exit = true;
-	vfs->cond.notify_all();
+	vfs->request_queue.close();
 	vfs->thread.join();
 
 	vfs->request_queue.destroy(vfs->allocator);
@@ -135,11 +113,7 @@ vfs_result_t vfs_begin_request(vfs_t* vfs, const char* filename, vfs_request_t*
 	request->status = VFS_RESULT_PENDING;
 	request->data = NULL;
 	request->size = 0;
-	{
-		std::lock_guard<std::mutex> guard(vfs->mutex);
-		vfs->request_queue.put(id);
-	}
-	vfs->cond.notify_one();
+	vfs->request_queue.push(id);
 
 	*out_request = id;
 	return VFS_RESULT_OK;
@@ -173,7 +147,6 @@ vfs_result_t vfs_end_request(vfs_t* vfs, vfs_request_t request)
 	ASSERT(request_ptr->status != VFS_RESULT_PENDING, "cannot end pending requests (yet)");
 	ALLOCATOR_FREE(vfs->allocator, request_ptr->data);
 
-	std::lock_guard<std::mutex> lock(vfs->mutex);
 	vfs->request_pool.free_handle(request);
 
 	return VFS_RESULT_OK;
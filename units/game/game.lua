@@ -3,6 +3,14 @@ Unit:Using("foundation")
 function Unit.Build(self)
 	local game_src = {
 		PathJoin(self.path, "src/ecs.cpp"),
+		PathJoin(self.path, "src/ecs_command.cpp"),
+		PathJoin(self.path, "src/ecs_defrag.cpp"),
+		PathJoin(self.path, "src/ecs_hierarchy.cpp"),
+		PathJoin(self.path, "src/ecs_observer.cpp"),
+		PathJoin(self.path, "src/ecs_query.cpp"),
+		PathJoin(self.path, "src/ecs_snapshot.cpp"),
+		PathJoin(self.path, "src/ecs_system.cpp"),
+		PathJoin(self.path, "src/spatial.cpp"),
 	}
 
 	local game_obj = Compile(self.settings, game_src)
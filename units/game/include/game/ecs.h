@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 /******************************************************************************\
 *
@@ -9,6 +10,10 @@
 \******************************************************************************/
 
 struct allocator_t;
+struct job_system_t;
+struct job_context_t;
+struct job_event_t;
+struct transform_t;
 
 /******************************************************************************\
 *
@@ -16,6 +21,17 @@ struct allocator_t;
 *
 \******************************************************************************/
 
+#define ECS_CHUNK_SIZE (16 * 1024)
+#define ECS_MAX_COMPONENTS_PER_ENTITY (32)
+#define ECS_MAX_COMPONENT_TYPES (256) // Each entity has a signature with one bit per type
+#define ECS_MAX_QUERY_COMPONENTS (16)
+#define ECS_MAX_SYSTEMS (64)
+#define ECS_HIERARCHY_MAX_DEPTH (16)
+
+// Entity ids pack an index in the low bits and a generation in the high bits
+#define ECS_ENTITY_INDEX_BITS (22)
+#define ECS_ENTITY_INDEX_MASK ((1U << ECS_ENTITY_INDEX_BITS) - 1)
+
 /******************************************************************************\
 *
 *  Enumerations
@@ -25,7 +41,35 @@ struct allocator_t;
 enum ecs_result_t
 {
 	ECS_RESULT_OK,
-	ECS_RESULT_NO_SUCH_COMPONENT
+	ECS_RESULT_NO_SUCH_COMPONENT,
+	ECS_RESULT_COMPONENT_EXISTS,
+	ECS_RESULT_NO_SUCH_ENTITY,
+	ECS_RESULT_INVALID_SNAPSHOT,
+};
+
+enum ecs_storage_t
+{
+	/**
+	 * One densely packed array per component type, an entity is looked up in
+	 * each array through a sparse set. Cheap structural changes. The arrays
+	 * grow in ECS_CHUNK_SIZE pages, so components never move when they grow.
+	 */
+	ECS_STORAGE_ARRAYS,
+
+	/**
+	 * Entities with the same set of components share ECS_CHUNK_SIZE chunks
+	 * with one array per component in each chunk. Iterating several
+	 * components is linear, adding or removing a component moves the entity
+	 * to another archetype.
+	 */
+	ECS_STORAGE_ARCHETYPES,
+};
+
+enum ecs_observer_event_t
+{
+	ECS_OBSERVER_EVENT_ADD = 1 << 0,
+	ECS_OBSERVER_EVENT_REMOVE = 1 << 1,
+	ECS_OBSERVER_EVENT_CHANGE = 1 << 2, // Written by a query with write_mask, marked changed or given another shared value
 };
 
 /******************************************************************************\
@@ -35,17 +79,37 @@ enum ecs_result_t
 \******************************************************************************/
 
 struct ecs_t;
+struct ecs_query_t;
+struct ecs_prefab_t;
+struct ecs_command_buffer_t;
+struct ecs_hierarchy_t;
+struct ecs_observer_t;
 
 struct entity_id_t 
 {
 	uint32_t id;
 };
 
+inline uint32_t ecs_entity_index(entity_id_t eid)
+{
+	return eid.id & ECS_ENTITY_INDEX_MASK;
+}
+
+inline uint32_t ecs_entity_generation(entity_id_t eid)
+{
+	return eid.id >> ECS_ENTITY_INDEX_BITS;
+}
+
 struct component_type_id_t 
 {
 	uint32_t id;
 };
 
+struct ecs_system_id_t
+{
+	uint32_t id;
+};
+
 /******************************************************************************\
 *
 *  Structures
@@ -55,14 +119,39 @@ struct component_type_id_t
 struct ecs_create_info_t
 {
 	allocator_t* allocator;
+	ecs_storage_t storage;
 	uint32_t max_entities;
-	uint32_t max_component_types;
+	uint32_t max_component_types; // At most ECS_MAX_COMPONENT_TYPES
+	uint32_t max_archetypes; // Only used with ECS_STORAGE_ARCHETYPES
 };
 
 struct component_type_create_info_t
 {
-	uint32_t max_components;
+	uint32_t max_components; // With ECS_STORAGE_ARRAYS an optional limit, 0 for none. Pages are allocated on demand. For shared types the max distinct values, 0 for 256
+
+	/**
+	 * 0 registers a tag. Tags have no data and are not stored in tables or
+	 * arrays, they only set a bit in the signature of the entity, so adding
+	 * and removing them never moves components. Tags are passed with nullptr
+	 * data and show up as nullptr in query batches.
+	 */
 	uint32_t component_size;
+
+	/**
+	 * Stores the component as this many equally sized fields, each in its own
+	 * array (SoA), e.g. TRANSFORM_NUM_FIELDS for transform_t. Components are
+	 * still passed in and out whole when creating entities or adding
+	 * components. 0 or 1 keeps components whole.
+	 */
+	uint32_t num_fields;
+
+	/**
+	 * Entities store a reference to a deduplicated value instead of their own
+	 * copy, e.g. a material or mesh. Entities with different values end up in
+	 * different archetypes, so every query batch sees a single value. Only
+	 * supported with ECS_STORAGE_ARCHETYPES and a single field.
+	 */
+	bool shared;
 };
 
 struct component_data_t
@@ -80,17 +169,139 @@ struct entity_create_info_t
 struct query_result_t
 {
 	uint32_t component_size;
-	uint8_t* component_data;
+	uint8_t* component_data; // First field of a split component
+	uint32_t field_stride; // Bytes between the fields of a split component, 0 when not split
 };
 
 struct query_all_result_t
 {
-	uint32_t count;
+	uint32_t num_pages;
+	uint32_t count; // In the requested page
 	uint32_t component_size;
 	uint8_t* component_data;
+	uint32_t field_stride; // Bytes between the field arrays of a split component, 0 when not split
 	entity_id_t* eids;
 };
 
+/**
+ * Entities having all with components and none of the without components.
+ * Optional components are returned when present. With and without can hold
+ * tags, optional components can not. With ECS_STORAGE_ARRAYS at least one
+ * with component has to be a non tag type.
+ */
+struct ecs_query_create_info_t
+{
+	uint32_t num_with;
+	const component_type_id_t* with;
+	uint32_t num_without;
+	const component_type_id_t* without;
+	uint32_t num_optional;
+	const component_type_id_t* optional;
+	uint32_t batch_size; // Max entities per batch, batches start at multiples of this inside a chunk. 0 for whole chunks
+
+	// Bit i refers to with[i] for i < num_with and to optional[i - num_with] after that
+	uint32_t write_mask; // Components written through the batches, iterating marks them changed. Bits of shared types are ignored
+	uint32_t changed_mask; // Skip batches where none of these changed since ecs_query_set_changed_since
+};
+
+/**
+ * A run of matching entities with their components stored consecutively.
+ * components holds the with components followed by the optional ones, in
+ * the order they were declared. Optional components missing for the batch
+ * are nullptr. For split components the pointer is to the array of the first
+ * field, the next field array starts field_strides bytes later. Shared
+ * components point to the one value of the whole batch, which is read only.
+ */
+struct ecs_query_batch_t
+{
+	uint32_t count;
+	const entity_id_t* eids;
+	void* components[ECS_MAX_QUERY_COMPONENTS];
+	uint32_t field_strides[ECS_MAX_QUERY_COMPONENTS];
+	uint32_t shared_mask; // Bit i is set when components[i] is a shared value
+};
+
+struct ecs_query_iter_t
+{
+	ecs_t* ecs;
+	ecs_query_t* query;
+	uint32_t table;
+	uint32_t row;
+};
+
+typedef void (*ecs_query_job_func_t)(job_context_t* context, const ecs_query_batch_t* batch, void* user_data);
+
+/**
+ * A system waits for the systems registered before it that write anything
+ * it reads or writes, or read anything it writes. All other systems run in
+ * parallel. The query is only used for the batches, reads and writes must
+ * cover everything func touches.
+ */
+struct ecs_system_create_info_t
+{
+	const char* name; // Has to outlive the ECS
+	uint32_t num_reads;
+	const component_type_id_t* reads;
+	uint32_t num_writes;
+	const component_type_id_t* writes;
+	ecs_query_t* query; // func is called once per batch, or once with a nullptr batch without a query
+	ecs_query_job_func_t func;
+	void* user_data;
+	uint32_t max_jobs;
+};
+
+struct ecs_system_info_t
+{
+	const char* name;
+	uint32_t level; // Length of the longest chain of systems this one waits for
+	uint32_t num_jobs;
+	uint64_t start; // From the start of the frame, in time_frequency() units
+	uint64_t duration;
+	bool critical; // On the critical path
+};
+
+struct ecs_schedule_info_t
+{
+	uint32_t num_systems;
+	const ecs_system_info_t* systems;
+	uint64_t frame_time;
+	uint64_t critical_path_time;
+	uint32_t num_critical_path;
+	const uint32_t* critical_path; // System indices, first to last
+};
+
+struct ecs_command_buffer_create_info_t
+{
+	uint32_t num_workers; // One stream per worker, see job_system_get_num_workers
+	uint32_t arena_size; // Bytes of commands each worker can record between playbacks
+	uint32_t max_creates; // Entities each worker can create between playbacks
+};
+
+struct ecs_hierarchy_create_info_t
+{
+	uint32_t max_nodes;
+	uint32_t batch_size; // Nodes per job when updating, 0 for a default
+};
+
+typedef uint64_t (*ecs_sort_key_func_t)(ecs_t* ecs, entity_id_t eid, void* user_data);
+
+struct ecs_defrag_info_t
+{
+	uint32_t max_rows; // Rows to look at this call, roughly, the work carries over to the next call
+	ecs_sort_key_func_t key_func; // nullptr sorts on entity index, giving every table the same order
+	void* user_data;
+};
+
+typedef void (*ecs_observer_func_t)(ecs_t* ecs, ecs_observer_event_t event, const entity_id_t* eids, uint32_t count, void* user_data);
+
+struct ecs_observer_create_info_t
+{
+	component_type_id_t type;
+	uint32_t events; // ecs_observer_event_t flags
+	ecs_observer_func_t func;
+	void* user_data;
+};
+
 /******************************************************************************\
 *
 *  ECS operations
@@ -107,6 +318,303 @@ ecs_result_t ecs_entity_create(ecs_t* ecs, const entity_create_info_t* create_in
 
 ecs_result_t ecs_entity_destroy(ecs_t* ecs, entity_id_t eid);
 
+/**
+ * False once the entity is destroyed, even if its index has been reused.
+ */
+bool ecs_entity_is_alive(const ecs_t* ecs, entity_id_t eid);
+
+/**
+ * Creates count entities with the same set of components. The data of each
+ * component_data points to count consecutive components, one per entity. For
+ * shared components each run of equal values goes to its own archetype.
+ */
+ecs_result_t ecs_entities_create_batch(ecs_t* ecs, const entity_create_info_t* create_info, uint32_t count, entity_id_t* out_eids);
+
+/**
+ * Destroys all entities in eids. Removals are sorted so each table is compacted in one pass.
+ * Dead and repeated ids are skipped, ECS_RESULT_NO_SUCH_ENTITY is returned if there were any,
+ * the same as destroying the entities one by one.
+ */
+ecs_result_t ecs_entities_destroy_batch(ecs_t* ecs, const entity_id_t* eids, uint32_t count);
+
+/**
+ * Prefabs keep a copy of a set of components, every instance starts out with the same values.
+ */
+ecs_result_t ecs_prefab_create(ecs_t* ecs, const entity_create_info_t* create_info, ecs_prefab_t** out_prefab);
+
+ecs_result_t ecs_prefab_destroy(ecs_t* ecs, ecs_prefab_t* prefab);
+
+ecs_result_t ecs_prefab_instantiate(ecs_t* ecs, const ecs_prefab_t* prefab, uint32_t count, entity_id_t* out_eids);
+
+ecs_result_t ecs_entity_add_component(ecs_t* ecs, entity_id_t eid, const component_data_t* component_data);
+
+ecs_result_t ecs_entity_remove_component(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid);
+
 ecs_result_t ecs_query_component(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid, query_result_t* out_result);
 
-ecs_result_t ecs_query_all_components(ecs_t* ecs, component_type_id_t ctid, query_all_result_t* out_result);
+/**
+ * Points the entity at another value of a shared component, moving it to the
+ * archetype of that value. Shared values are never written in place.
+ */
+ecs_result_t ecs_entity_set_shared_component(ecs_t* ecs, entity_id_t eid, const component_data_t* component_data);
+
+/**
+ * One instance of a component type owned by the ECS rather than an entity,
+ * e.g. the camera or frame time. ecs_singleton_get returns nullptr until set.
+ */
+ecs_result_t ecs_singleton_set(ecs_t* ecs, component_type_id_t ctid, const void* data);
+
+void* ecs_singleton_get(ecs_t* ecs, component_type_id_t ctid);
+
+/**
+ * Writes through ecs_query_component are not tracked, mark them for changed queries to pick them up.
+ */
+ecs_result_t ecs_component_mark_changed(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid);
+
+/**
+ * Version of the last change. Changes are tracked per column for blocks of
+ * about ECS_CHUNK_SIZE bytes, and every change made after this call gets a
+ * higher version.
+ */
+uint64_t ecs_get_version(ecs_t* ecs);
+
+/**
+ * Only supported with ECS_STORAGE_ARRAYS, archetype storage splits a component type over many archetypes.
+ * Components are stored in pages of ECS_CHUNK_SIZE bytes, page 0 tells the number of pages.
+ */
+ecs_result_t ecs_query_all_components(ecs_t* ecs, component_type_id_t ctid, uint32_t page, query_all_result_t* out_result);
+
+/******************************************************************************\
+*
+*  Queries
+*
+\******************************************************************************/
+
+ecs_result_t ecs_query_create(ecs_t* ecs, const ecs_query_create_info_t* create_info, ecs_query_t** out_query);
+
+ecs_result_t ecs_query_destroy(ecs_t* ecs, ecs_query_t* query);
+
+/**
+ * Only used with a changed_mask. Systems set this to the version of their previous run.
+ */
+void ecs_query_set_changed_since(ecs_query_t* query, uint64_t version);
+
+/**
+ * Whether the entity has all with components and none of the without
+ * components of the query, a single test of its signature.
+ */
+bool ecs_query_matches(ecs_t* ecs, const ecs_query_t* query, entity_id_t eid);
+
+/**
+ * Iterating is not allowed to overlap with structural changes. With
+ * ECS_STORAGE_ARRAYS a batch is a run of entities whose components are
+ * consecutive in every array, so the arrays should be filled in the same
+ * order for long batches. Entities are filtered on their signatures, so
+ * with tags a batch ends at the first entity missing one.
+ */
+void ecs_query_iter_begin(ecs_t* ecs, ecs_query_t* query, ecs_query_iter_t* out_iter);
+
+bool ecs_query_iter_next(ecs_query_iter_t* iter, ecs_query_batch_t* out_batch);
+
+/**
+ * Collects all batches of the query and kicks up to max_jobs jobs calling
+ * func on them, each job getting about the same number of entities. The
+ * batches are stored in the query, so only one kick per query can be in
+ * flight and no structural changes can happen until event is done.
+ */
+ecs_result_t ecs_query_kick(ecs_t* ecs, ecs_query_t* query, job_system_t* job_system, uint32_t max_jobs, ecs_query_job_func_t func, void* user_data, job_event_t* depends = nullptr, job_event_t* event = nullptr);
+
+/******************************************************************************\
+*
+*  Systems
+*
+\******************************************************************************/
+
+ecs_result_t ecs_system_register(ecs_t* ecs, const ecs_system_create_info_t* create_info, ecs_system_id_t* out_id);
+
+/**
+ * Kicks every system with its dependencies expressed as job events and
+ * waits for all of them. No structural changes can be made while running,
+ * record them in a command buffer instead.
+ */
+ecs_result_t ecs_systems_run(ecs_t* ecs, job_system_t* job_system);
+
+/**
+ * Timings of the last ecs_systems_run. The critical path is the chain of
+ * dependent systems with the longest total duration.
+ */
+ecs_result_t ecs_systems_get_schedule(ecs_t* ecs, ecs_schedule_info_t* out_info);
+
+/******************************************************************************\
+*
+*  Command buffers
+*
+\******************************************************************************/
+
+/**
+ * Deferred structural changes. Every worker records into its own stream, so
+ * jobs can record without locking as long as each passes its own worker
+ * index. Nothing touches the ECS until ecs_command_buffer_playback.
+ *
+ * Created entities get their id right away from a per worker reserve, so
+ * later commands in the same frame can refer to them. A reserved id only
+ * becomes alive when its create command is played back. Until then
+ * ecs_entity_is_alive is false for it and destroying it or adding or removing
+ * components returns ECS_RESULT_NO_SUCH_ENTITY, also for commands of an
+ * earlier stream played back before it. The reserved indices are held until
+ * the command buffer is destroyed, so destroy it before the ECS.
+ */
+ecs_result_t ecs_command_buffer_create(ecs_t* ecs, const ecs_command_buffer_create_info_t* create_info, ecs_command_buffer_t** out_buffer);
+
+ecs_result_t ecs_command_buffer_destroy(ecs_t* ecs, ecs_command_buffer_t* buffer);
+
+ecs_result_t ecs_command_create_entity(ecs_command_buffer_t* buffer, uint32_t worker, const entity_create_info_t* create_info, entity_id_t* out_eid);
+
+ecs_result_t ecs_command_destroy_entity(ecs_command_buffer_t* buffer, uint32_t worker, entity_id_t eid);
+
+ecs_result_t ecs_command_add_component(ecs_command_buffer_t* buffer, uint32_t worker, entity_id_t eid, const component_data_t* component_data);
+
+ecs_result_t ecs_command_remove_component(ecs_command_buffer_t* buffer, uint32_t worker, entity_id_t eid, component_type_id_t ctid);
+
+/**
+ * Applies all recorded commands stream by stream in recording order and
+ * resets the streams. Has to run on a single thread at a sync point, when no
+ * jobs are recording or iterating.
+ */
+ecs_result_t ecs_command_buffer_playback(ecs_t* ecs, ecs_command_buffer_t* buffer);
+
+/******************************************************************************\
+*
+*  Hierarchies
+*
+\******************************************************************************/
+
+/**
+ * Parent/child relationships between entities with a local transform per
+ * entity and the local-to-world matrix derived from it. Nodes are kept
+ * sorted on depth, so all nodes of a depth are updated in one linear pass
+ * after their parents. A node is only recomputed when its local transform
+ * or the world matrix of its parent changed.
+ *
+ * Entities should be removed from the hierarchy before they are destroyed.
+ * The node of an entity destroyed without that is not found by its id or by
+ * a later entity reusing its index, and is dropped when that entity is added.
+ * A parent id of 0 means no parent, entity ids are never 0.
+ */
+ecs_result_t ecs_hierarchy_create(ecs_t* ecs, const ecs_hierarchy_create_info_t* create_info, ecs_hierarchy_t** out_hierarchy);
+
+ecs_result_t ecs_hierarchy_destroy(ecs_t* ecs, ecs_hierarchy_t* hierarchy);
+
+ecs_result_t ecs_hierarchy_add(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, entity_id_t parent, const transform_t* local);
+
+/**
+ * The children of a removed entity become roots.
+ */
+ecs_result_t ecs_hierarchy_remove(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid);
+
+/**
+ * Moves an entity and everything below it, the local transform is kept.
+ */
+ecs_result_t ecs_hierarchy_set_parent(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, entity_id_t parent);
+
+ecs_result_t ecs_hierarchy_set_local(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, const transform_t* local);
+
+/**
+ * Column major 4x4 matrix as of the last ecs_hierarchy_update.
+ */
+ecs_result_t ecs_hierarchy_get_world(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, const float** out_matrix);
+
+/**
+ * Recomputes the world matrices of everything below a changed node, one
+ * depth after the other with the nodes of each depth split over jobs. Runs
+ * on the calling thread without a job system. Waits for the jobs, no
+ * changes to the hierarchy can be made while updating.
+ */
+ecs_result_t ecs_hierarchy_update(ecs_t* ecs, ecs_hierarchy_t* hierarchy, job_system_t* job_system);
+
+/******************************************************************************\
+*
+*  Defragmentation
+*
+\******************************************************************************/
+
+/**
+ * Removing by swapping in the last row keeps tables dense but scrambles their
+ * order. Each call sorts a bit more of the tables on the key, one table after
+ * the other, by swapping rows into place. Sorting on entity index puts the
+ * component arrays of ECS_STORAGE_ARRAYS in the same order, so iterating
+ * over several components walks all arrays forward. A key like the spatial
+ * cell or material keeps entities that are used together next to each other.
+ *
+ * Building the order of a table spreads over calls as well: collecting the key
+ * of a row, merging an entry of the sorted runs and each swap all count as one
+ * row. Moved rows count as changed. out_done is set once a
+ * whole round over the tables found nothing to move. Has to be called at a
+ * sync point, when no jobs are iterating.
+ */
+ecs_result_t ecs_defragment(ecs_t* ecs, const ecs_defrag_info_t* info, bool* out_done);
+
+/******************************************************************************\
+*
+*  Observers
+*
+\******************************************************************************/
+
+/**
+ * Gets told which entities got, lost or changed a component type. Structural
+ * changes and writes only flag the entity index, the events are worked out
+ * and handed over in ecs_observers_flush, one array of entity ids per event
+ * kind. Events are the net effect since the last flush: a component added
+ * and removed again in between is not reported, an entity destroyed and its
+ * index reused reports the old id as removed and the new one as added.
+ *
+ * Entities already holding the type when the observer is created are
+ * reported as added by the first flush. Writes through ecs_query_kick and
+ * ecs_systems_run are flagged on the calling thread. Batches taken with
+ * ecs_query_iter_next are not, as jobs may iterate at the same time, mark
+ * those with ecs_component_mark_changed once the jobs are done.
+ */
+ecs_result_t ecs_observer_create(ecs_t* ecs, const ecs_observer_create_info_t* create_info, ecs_observer_t** out_observer);
+
+ecs_result_t ecs_observer_destroy(ecs_t* ecs, ecs_observer_t* observer);
+
+/**
+ * Calls the observers with the removes, then the adds, then the changes.
+ * Nothing is allocated per event, the ids are collected in scratch that only
+ * grows. Has to be called at a sync point, when no jobs are iterating. The
+ * callbacks can only read components, structural changes have to go through
+ * a command buffer. Changes the callbacks make are reported by the next flush.
+ */
+ecs_result_t ecs_observers_flush(ecs_t* ecs);
+
+/******************************************************************************\
+*
+*  Snapshots
+*
+\******************************************************************************/
+
+/**
+ * Saves all entities and components into one blob. The blob only holds
+ * offsets, never pointers, and the component data is stored as whole chunks
+ * aligned to CACHE_LINE_SIZE, so it can be written straight to a file and
+ * read back from a memory mapping of it.
+ *
+ * With a nullptr buffer only the size is returned. Has to be called at a
+ * sync point, when no jobs are iterating.
+ */
+ecs_result_t ecs_snapshot_write(ecs_t* ecs, void* buffer, size_t buffer_size, size_t* out_size);
+
+/**
+ * Replaces all entities and components with the ones in the snapshot. The
+ * ECS has to use the same storage and max_entities as the one written, with
+ * the same component types registered in the same order. Chunks are copied
+ * whole and only table indices are fixed up, nothing is done per entity.
+ *
+ * Every component counts as changed afterwards. Queries and prefabs stay
+ * valid, command buffers, hierarchies and anything else holding entity ids
+ * have to be recreated. buffer has to be 16 byte aligned. Shared values and
+ * singletons are restored too, including the references prefabs hold on
+ * shared values, so prefabs with shared components have to be the same ones
+ * as when written.
+ */
+ecs_result_t ecs_snapshot_read(ecs_t* ecs, const void* buffer, size_t buffer_size);
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "ecs.h"
+
+#include <foundation/assert.h>
+
+#include <type_traits>
+
+/**
+ * Typed layer over the ECS. Component ids live in a static per type, so they
+ * are assigned by ecs_register_component<T> and have to come out the same in
+ * every ECS using the type. Each module gets its own copy of the statics.
+ */
+template<class T>
+struct ecs_component_type_t
+{
+	static component_type_id_t id;
+	static bool shared;
+	static bool tag;
+};
+
+template<class T>
+component_type_id_t ecs_component_type_t<T>::id = { UINT32_MAX };
+
+template<class T>
+bool ecs_component_type_t<T>::shared = false;
+
+template<class T>
+bool ecs_component_type_t<T>::tag = false;
+
+template<class T>
+inline component_type_id_t ecs_component_id()
+{
+	component_type_id_t id = ecs_component_type_t<typename std::remove_const<T>::type>::id;
+	ASSERT(id.id != UINT32_MAX, "Component type not registered");
+	return id;
+}
+
+template<class T>
+inline ecs_result_t ecs_register_component(ecs_t* ecs, uint32_t max_components = 0, uint32_t num_fields = 1)
+{
+	component_type_create_info_t create_info = {};
+	create_info.max_components = max_components;
+	create_info.component_size = sizeof(T);
+	create_info.num_fields = num_fields;
+
+	component_type_id_t id;
+	ecs_result_t res = ecs_register_component_type(ecs, &create_info, &id);
+	component_type_id_t& stored = ecs_component_type_t<T>::id;
+	ASSERT(stored.id == UINT32_MAX || stored.id == id.id, "Component type got different ids in different ECSs");
+	stored = id;
+	return res;
+}
+
+template<class T>
+inline ecs_result_t ecs_register_shared_component(ecs_t* ecs, uint32_t max_values = 0)
+{
+	component_type_create_info_t create_info = {};
+	create_info.max_components = max_values;
+	create_info.component_size = sizeof(T);
+	create_info.num_fields = 1;
+	create_info.shared = true;
+
+	component_type_id_t id;
+	ecs_result_t res = ecs_register_component_type(ecs, &create_info, &id);
+	component_type_id_t& stored = ecs_component_type_t<T>::id;
+	ASSERT(stored.id == UINT32_MAX || stored.id == id.id, "Component type got different ids in different ECSs");
+	stored = id;
+	ecs_component_type_t<T>::shared = true;
+	return res;
+}
+
+/**
+ * T is only used for its id, tags have no data.
+ */
+template<class T>
+inline ecs_result_t ecs_register_tag(ecs_t* ecs)
+{
+	component_type_create_info_t create_info = {};
+
+	component_type_id_t id;
+	ecs_result_t res = ecs_register_component_type(ecs, &create_info, &id);
+	component_type_id_t& stored = ecs_component_type_t<T>::id;
+	ASSERT(stored.id == UINT32_MAX || stored.id == id.id, "Component type got different ids in different ECSs");
+	stored = id;
+	ecs_component_type_t<T>::tag = true;
+	return res;
+}
+
+template<class T>
+inline T* ecs_entity_get(ecs_t* ecs, entity_id_t eid)
+{
+	query_result_t result;
+	if (ecs_query_component(ecs, eid, ecs_component_id<T>(), &result) != ECS_RESULT_OK)
+		return nullptr;
+	ASSERT(result.field_stride == 0, "Split components can not be accessed as a whole");
+	return static_cast<T*>(static_cast<void*>(result.component_data));
+}
+
+template<class T>
+inline ecs_result_t ecs_entity_add(ecs_t* ecs, entity_id_t eid, const T& component)
+{
+	component_data_t component_data;
+	component_data.type = ecs_component_id<T>();
+	component_data.data = &component;
+	return ecs_entity_add_component(ecs, eid, &component_data);
+}
+
+template<class T>
+inline ecs_result_t ecs_entity_add_tag(ecs_t* ecs, entity_id_t eid)
+{
+	component_data_t component_data;
+	component_data.type = ecs_component_id<T>();
+	component_data.data = nullptr;
+	return ecs_entity_add_component(ecs, eid, &component_data);
+}
+
+template<class T>
+inline ecs_result_t ecs_entity_set_shared(ecs_t* ecs, entity_id_t eid, const T& component)
+{
+	component_data_t component_data;
+	component_data.type = ecs_component_id<T>();
+	component_data.data = &component;
+	return ecs_entity_set_shared_component(ecs, eid, &component_data);
+}
+
+template<class T>
+inline ecs_result_t ecs_singleton_set(ecs_t* ecs, const T& component)
+{
+	return ecs_singleton_set(ecs, ecs_component_id<T>(), &component);
+}
+
+template<class T>
+inline T* ecs_singleton_get(ecs_t* ecs)
+{
+	return static_cast<T*>(ecs_singleton_get(ecs, ecs_component_id<T>()));
+}
+
+// Position of T in Ts, as a compile time constant
+template<class T, class... Ts>
+struct ecs_type_index_t;
+
+template<class T, class... Ts>
+struct ecs_type_index_t<T, T, Ts...>
+{
+	enum { value = 0 };
+};
+
+template<class T, class U, class... Ts>
+struct ecs_type_index_t<T, U, Ts...>
+{
+	enum { value = 1 + ecs_type_index_t<T, Ts...>::value };
+};
+
+// Bit per non const type, matching ecs_query_create_info_t::write_mask
+template<class... Ts>
+struct ecs_write_mask_t;
+
+template<>
+struct ecs_write_mask_t<>
+{
+	enum { value = 0 };
+};
+
+template<class T, class... Ts>
+struct ecs_write_mask_t<T, Ts...>
+{
+	enum { value = (std::is_const<T>::value ? 0 : 1) | (ecs_write_mask_t<Ts...>::value << 1) };
+};
+
+/**
+ * Batch with typed access, get<T> has to name the type exactly as in the view.
+ */
+template<class... Ts>
+struct ecs_view_batch_t : public ecs_query_batch_t
+{
+	ecs_view_batch_t()
+	{
+	}
+
+	explicit ecs_view_batch_t(const ecs_query_batch_t& batch)
+		: ecs_query_batch_t(batch)
+	{
+	}
+
+	template<class T>
+	T* get() const
+	{
+		uint32_t index = ecs_type_index_t<T, Ts...>::value;
+		ASSERT(field_strides[index] == 0, "Split components can not be accessed as a whole, use fields<T>()");
+		return static_cast<T*>(components[index]);
+	}
+
+	// Component of entity i, shared components give the one value of the batch
+	template<class T>
+	T& at(uint32_t i) const
+	{
+		uint32_t index = ecs_type_index_t<T, Ts...>::value;
+		return get<T>()[(shared_mask >> index) & 1 ? 0 : i];
+	}
+
+	// First field of a split component, field i starts i * field_stride<T>() bytes later
+	template<class T>
+	void* fields() const
+	{
+		return components[ecs_type_index_t<T, Ts...>::value];
+	}
+
+	template<class T>
+	uint32_t field_stride() const
+	{
+		return field_strides[ecs_type_index_t<T, Ts...>::value];
+	}
+};
+
+/**
+ * Query over entities having all of Ts. Components without const are
+ * written, which marks them changed while iterating. Shared components
+ * have to be const, their values are set with ecs_entity_set_shared.
+ * Tags have no column to reference and can not be in Ts, filter on them
+ * with the with list of a plain ecs_query_t.
+ *
+ *   ecs_view_t<const position_t, render_t> view;
+ *   view.create(ecs);
+ *   for (const auto& batch : view)
+ *       for (uint32_t i = 0; i < batch.count; ++i)
+ *           batch.get<render_t>()[i].pos = batch.get<const position_t>()[i].pos;
+ *   view.destroy();
+ */
+template<class... Ts>
+struct ecs_view_t
+{
+	static_assert(sizeof...(Ts) <= ECS_MAX_QUERY_COMPONENTS, "Too many components in view");
+
+	typedef ecs_view_batch_t<Ts...> batch_t;
+
+	struct iterator
+	{
+		ecs_query_iter_t iter;
+		batch_t batch;
+		bool done;
+
+		const batch_t& operator*() const
+		{
+			return batch;
+		}
+
+		iterator& operator++()
+		{
+			done = !ecs_query_iter_next(&iter, &batch);
+			return *this;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return done != other.done;
+		}
+	};
+
+	ecs_t* ecs;
+	ecs_query_t* query;
+
+	ecs_result_t create(ecs_t* in_ecs, uint32_t batch_size = 0, uint32_t changed_mask = 0)
+	{
+		component_type_id_t with[] = { ecs_component_id<Ts>()... };
+		bool writes_shared[] = { !std::is_const<Ts>::value && ecs_component_type_t<typename std::remove_const<Ts>::type>::shared... };
+		bool tags[] = { ecs_component_type_t<typename std::remove_const<Ts>::type>::tag... };
+		for (size_t i = 0; i < sizeof...(Ts); ++i)
+		{
+			ASSERT(!writes_shared[i], "Shared components have to be const in views");
+			ASSERT(!tags[i], "Tags have no data and can not be in views");
+		}
+
+		ecs_query_create_info_t create_info = {};
+		create_info.num_with = sizeof...(Ts);
+		create_info.with = with;
+		create_info.batch_size = batch_size;
+		create_info.write_mask = ecs_write_mask_t<Ts...>::value;
+		create_info.changed_mask = changed_mask;
+
+		ecs = in_ecs;
+		return ecs_query_create(ecs, &create_info, &query);
+	}
+
+	ecs_result_t destroy()
+	{
+		return ecs_query_destroy(ecs, query);
+	}
+
+	iterator begin()
+	{
+		iterator it = {};
+		ecs_query_iter_begin(ecs, query, &it.iter);
+		it.done = false;
+		++it;
+		return it;
+	}
+
+	iterator end()
+	{
+		iterator it = {};
+		it.done = true;
+		return it;
+	}
+
+	/**
+	 * Calls func(Ts&...) for every entity.
+	 */
+	template<class F>
+	void each(F func)
+	{
+		for (iterator it = begin(); it != end(); ++it)
+		{
+			const batch_t& batch = *it;
+			for (uint32_t i = 0; i < batch.count; ++i)
+				func(batch.template at<Ts>(i)...);
+		}
+	}
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ecs.h"
+
+/******************************************************************************\
+*
+*  Forward declares
+*
+\******************************************************************************/
+
+struct allocator_t;
+
+/******************************************************************************\
+*
+*  Enumerations
+*
+\******************************************************************************/
+
+enum spatial_result_t
+{
+	SPATIAL_RESULT_OK,
+	SPATIAL_RESULT_NO_SUCH_ENTITY,
+	SPATIAL_RESULT_ENTITY_EXISTS,
+};
+
+/******************************************************************************\
+*
+*  Structures
+*
+\******************************************************************************/
+
+struct spatial_grid_t;
+
+struct spatial_aabb_t
+{
+	float min[3];
+	float max[3];
+};
+
+struct spatial_grid_create_info_t
+{
+	allocator_t* allocator;
+	uint32_t max_entities; // Entity indices have to be below this, usually the max_entities of the ECS
+	uint32_t max_cells; // Occupied cells at the same time
+	float cell_size; // About the size of a typical query works well
+};
+
+/**
+ * Planes as (nx, ny, nz, d), a point p is inside when dot(n, p) + d >= 0 for all planes.
+ */
+struct spatial_frustum_t
+{
+	float planes[6][4];
+};
+
+/******************************************************************************\
+*
+*  Spatial grid operations
+*
+\******************************************************************************/
+
+/**
+ * Loose uniform grid over entity bounds. Cells are hashed, so only occupied
+ * cells take memory and the world has no fixed extent. An entity belongs to
+ * the cell holding the center of its box, and queries look as far out as the
+ * largest half extent seen so far. Each cell keeps its boxes in SoA blocks
+ * of 16, tested four or more at a time.
+ *
+ * Queries only read, so any number of jobs can query at the same time as long
+ * as nothing updates the grid.
+ */
+spatial_result_t spatial_grid_create(const spatial_grid_create_info_t* create_info, spatial_grid_t** out_grid);
+
+spatial_result_t spatial_grid_destroy(spatial_grid_t* grid);
+
+spatial_result_t spatial_grid_insert(spatial_grid_t* grid, entity_id_t eid, const spatial_aabb_t* aabb);
+
+spatial_result_t spatial_grid_remove(spatial_grid_t* grid, entity_id_t eid);
+
+/**
+ * Entities staying in their cell are updated in place, only entities moving
+ * to another cell are relinked. Feed it the entities whose transform changed,
+ * e.g. from a query with a changed_mask.
+ */
+spatial_result_t spatial_grid_update(spatial_grid_t* grid, entity_id_t eid, const spatial_aabb_t* aabb);
+
+spatial_result_t spatial_grid_update_batch(spatial_grid_t* grid, uint32_t count, const entity_id_t* eids, const spatial_aabb_t* aabbs);
+
+spatial_result_t spatial_grid_get(const spatial_grid_t* grid, entity_id_t eid, spatial_aabb_t* out_aabb);
+
+/**
+ * Entities overlapping the query. out_count gets the number of matches, of
+ * which the first max_results are written to out_eids.
+ */
+spatial_result_t spatial_grid_query_aabb(const spatial_grid_t* grid, const spatial_aabb_t* aabb, uint32_t max_results, entity_id_t* out_eids, uint32_t* out_count);
+
+spatial_result_t spatial_grid_query_sphere(const spatial_grid_t* grid, const float center[3], float radius, uint32_t max_results, entity_id_t* out_eids, uint32_t* out_count);
+
+spatial_result_t spatial_grid_query_frustum(const spatial_grid_t* grid, const spatial_frustum_t* frustum, uint32_t max_results, entity_id_t* out_eids, uint32_t* out_count);
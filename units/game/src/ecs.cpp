@@ -1,34 +1,604 @@
-#include <foundation/allocator.h>
-#include <foundation/array.h>
-#include <foundation/idpool.h>
-#include <foundation/table.h>
-#include <game/ecs.h>
+#include "ecs_private.h"
 
-struct component_desc_t
+#include <foundation/hash.h>
+
+#include <cstring>
+
+/******************************************************************************\
+*
+*  Tables
+*
+\******************************************************************************/
+
+/**
+ * Chunks of up to ECS_CHUNK_SIZE bytes all come from the same block pool, so
+ * tables can hand chunks back to each other without going to the allocator.
+ */
+static uint8_t* ecs_chunk_alloc(ecs_t* ecs, uint32_t size)
+{
+	if (size <= ECS_CHUNK_SIZE && ecs->free_chunks.any())
+	{
+		uint8_t* chunk = ecs->free_chunks.back();
+		ecs->free_chunks.remove_back();
+		return chunk;
+	}
+	return (uint8_t*)ALLOCATOR_ALLOC(ecs->allocator, size <= ECS_CHUNK_SIZE ? ECS_CHUNK_SIZE : size, CACHE_LINE_SIZE);
+}
+
+static void ecs_chunk_free(ecs_t* ecs, uint8_t* chunk, uint32_t size)
+{
+	if (size <= ECS_CHUNK_SIZE && ecs->free_chunks.length() < ECS_MAX_FREE_CHUNKS)
+		ecs_array_push(ecs->allocator, &ecs->free_chunks, chunk);
+	else
+		ALLOCATOR_FREE(ecs->allocator, chunk);
+}
+
+static void ecs_table_create(ecs_t* ecs, ecs_table_t* table, const component_type_id_t* types, uint32_t num_types, const uint32_t* shared_values)
+{
+	memset(table, 0, sizeof(ecs_table_t));
+	table->num_columns = num_types;
+	table->columns = num_types ? ALLOCATOR_ALLOC_ARRAY(ecs->allocator, num_types, ecs_column_t) : nullptr;
+
+	uint32_t row_size = sizeof(entity_id_t);
+	uint32_t num_arrays = 1;
+	for (uint32_t i = 0; i < num_types; ++i)
+	{
+		const component_desc_t* desc = &ecs->component_descs[types[i].id];
+		ecs_column_t* column = &table->columns[i];
+		column->type = types[i];
+		column->size = desc->shared ? 0 : desc->component_size;
+		column->num_fields = desc->shared ? 1 : desc->num_fields;
+		column->field_size = column->size / column->num_fields;
+		column->shared_value = shared_values ? shared_values[i] : UINT32_MAX;
+		ASSERT(!desc->shared || column->shared_value != UINT32_MAX, "Shared component without a value");
+		ASSERT(!desc->tag, "Tags are not stored in tables");
+		ecs_signature_set(&table->signature, types[i]);
+		row_size += column->size;
+		num_arrays += column->num_fields;
+	}
+
+	// Fill a chunk, leaving room to align every array
+	uint32_t padding = num_arrays * 16;
+	uint32_t rows_per_chunk = ECS_CHUNK_SIZE > padding + row_size ? (ECS_CHUNK_SIZE - padding) / row_size : 1;
+
+	uint32_t offset = (uint32_t)ALIGN_UP(rows_per_chunk * sizeof(entity_id_t), 16);
+	for (uint32_t i = 0; i < num_types; ++i)
+	{
+		ecs_column_t* column = &table->columns[i];
+		uint32_t field_stride = (uint32_t)ALIGN_UP(rows_per_chunk * column->field_size, 16);
+		column->offset = offset;
+		column->field_stride = column->num_fields > 1 ? field_stride : 0;
+		offset += column->num_fields * field_stride;
+	}
+	table->rows_per_chunk = rows_per_chunk;
+	table->chunk_size = offset;
+	table->chunks.create(ecs->allocator, 0);
+
+	table->rows_per_version = rows_per_chunk;
+	table->versions.create(ecs->allocator, 0);
+}
+
+void ecs_table_mark_rows(ecs_t* ecs, ecs_table_t* table, uint32_t first, uint32_t count)
+{
+	uint64_t version = ++ecs->version;
+	uint32_t end = (first + count + table->rows_per_version - 1) / table->rows_per_version;
+	while (table->versions.length() < end * table->num_columns)
+		ecs_array_push(ecs->allocator, &table->versions, version);
+	for (uint32_t i = first / table->rows_per_version * table->num_columns; i < end * table->num_columns; ++i)
+		table->versions[i] = version;
+}
+
+static void ecs_table_destroy(ecs_t* ecs, ecs_table_t* table)
+{
+	for (size_t i = 0; i < table->chunks.length(); ++i)
+		ALLOCATOR_FREE(ecs->allocator, table->chunks[i]);
+	table->chunks.destroy(ecs->allocator);
+	table->versions.destroy(ecs->allocator);
+	ALLOCATOR_FREE(ecs->allocator, table->columns);
+}
+
+uint32_t ecs_table_push_rows(ecs_t* ecs, ecs_table_t* table, uint32_t count)
+{
+	uint32_t first = table->count;
+	uint32_t num_chunks = (first + count + table->rows_per_chunk - 1) / table->rows_per_chunk;
+	if (num_chunks > table->chunks.capacity())
+		table->chunks.set_capacity(ecs->allocator, num_chunks > table->chunks.capacity() * 2 ? num_chunks : table->chunks.capacity() * 2);
+	while (table->chunks.length() < num_chunks)
+		table->chunks.append(ecs_chunk_alloc(ecs, table->chunk_size));
+
+	table->count += count;
+	if (count > 0)
+		ecs_table_mark_rows(ecs, table, first, count);
+	return first;
+}
+
+static uint32_t ecs_table_push_row(ecs_t* ecs, ecs_table_t* table, entity_id_t eid)
+{
+	uint32_t row = ecs_table_push_rows(ecs, table, 1);
+	*ecs_table_eid(table, row) = eid;
+	return row;
+}
+
+/**
+ * Copies a whole component into a row, scattering the fields of split columns.
+ */
+static void ecs_table_write(ecs_table_t* table, uint32_t row, uint32_t column, const void* src)
+{
+	const ecs_column_t* col = &table->columns[column];
+	uint8_t* dst = ecs_table_get(table, row, column);
+	if (col->num_fields == 1)
+	{
+		memcpy(dst, src, col->size);
+		return;
+	}
+	for (uint32_t f = 0; f < col->num_fields; ++f)
+		memcpy(dst + f * col->field_stride, (const uint8_t*)src + f * col->field_size, col->field_size);
+}
+
+/**
+ * Copies count consecutive components from src into a column, one memcpy per chunk.
+ */
+static void ecs_table_copy_column(ecs_table_t* table, uint32_t first, uint32_t count, uint32_t column, const uint8_t* src)
+{
+	uint32_t size = table->columns[column].size;
+	for (uint32_t row = first, end = first + count; row < end;)
+	{
+		uint32_t n = table->rows_per_chunk - row % table->rows_per_chunk;
+		n = n < end - row ? n : end - row;
+		if (table->columns[column].num_fields == 1)
+			memcpy(ecs_table_get(table, row, column), src, n * size);
+		else
+		{
+			for (uint32_t i = 0; i < n; ++i)
+				ecs_table_write(table, row + i, column, src + i * size);
+		}
+		src += n * size;
+		row += n;
+	}
+}
+
+/**
+ * Sets count consecutive components to value, doubling the copied range for each memcpy.
+ */
+static void ecs_table_fill_column(ecs_table_t* table, uint32_t first, uint32_t count, uint32_t column, const uint8_t* value)
+{
+	const ecs_column_t* col = &table->columns[column];
+	uint32_t size = col->field_size;
+	for (uint32_t row = first, end = first + count; row < end;)
+	{
+		uint32_t n = table->rows_per_chunk - row % table->rows_per_chunk;
+		n = n < end - row ? n : end - row;
+		for (uint32_t f = 0; f < col->num_fields; ++f)
+		{
+			uint8_t* dst = ecs_table_get(table, row, column) + f * col->field_stride;
+			memcpy(dst, value + f * size, size);
+			for (uint32_t filled = 1; filled < n;)
+			{
+				uint32_t copy = filled < n - filled ? filled : n - filled;
+				memcpy(dst + filled * size, dst, copy * size);
+				filled += copy;
+			}
+		}
+		row += n;
+	}
+}
+
+/**
+ * Copies the entity id and all components the tables have in common.
+ */
+static void ecs_table_copy_row(ecs_table_t* dst, uint32_t dst_row, ecs_table_t* src, uint32_t src_row)
+{
+	*ecs_table_eid(dst, dst_row) = *ecs_table_eid(src, src_row);
+
+	uint32_t is = 0;
+	uint32_t id = 0;
+	while (is < src->num_columns && id < dst->num_columns)
+	{
+		uint32_t ts = src->columns[is].type.id;
+		uint32_t td = dst->columns[id].type.id;
+		if (ts == td)
+		{
+			const ecs_column_t* col = &src->columns[is];
+			uint8_t* d = ecs_table_get(dst, dst_row, id);
+			const uint8_t* s = ecs_table_get(src, src_row, is);
+			for (uint32_t f = 0; f < col->num_fields; ++f)
+				memcpy(d + f * dst->columns[id].field_stride, s + f * col->field_stride, col->field_size);
+			++is;
+			++id;
+		}
+		else if (ts < td)
+			++is;
+		else
+			++id;
+	}
+}
+
+/**
+ * Moves a row within a table, same as ecs_table_copy_row but without matching up columns.
+ */
+static void ecs_table_move_row(ecs_table_t* table, uint32_t dst_row, uint32_t src_row)
+{
+	uint8_t* dst = table->chunks[dst_row / table->rows_per_chunk];
+	const uint8_t* src = table->chunks[src_row / table->rows_per_chunk];
+	dst_row %= table->rows_per_chunk;
+	src_row %= table->rows_per_chunk;
+	((entity_id_t*)dst)[dst_row] = ((const entity_id_t*)src)[src_row];
+
+	for (uint32_t c = 0; c < table->num_columns; ++c)
+	{
+		const ecs_column_t* col = &table->columns[c];
+		uint8_t* d = dst + col->offset + dst_row * col->field_size;
+		const uint8_t* s = src + col->offset + src_row * col->field_size;
+		for (uint32_t f = 0; f < col->num_fields; ++f)
+			memcpy(d + f * col->field_stride, s + f * col->field_stride, col->field_size);
+	}
+}
+
+/**
+ * Drops the rows from count on, releasing the chunks that run empty. The first chunk is kept around.
+ */
+static void ecs_table_truncate(ecs_t* ecs, ecs_table_t* table, uint32_t count)
+{
+	table->count = count;
+	size_t num_chunks = count ? (count + table->rows_per_chunk - 1) / table->rows_per_chunk : 1;
+	if (table->chunks.length() <= num_chunks)
+		return;
+
+	while (table->chunks.length() > num_chunks)
+	{
+		ecs_chunk_free(ecs, table->chunks.back(), table->chunk_size);
+		table->chunks.remove_back();
+	}
+
+	uint32_t num_blocks = ((uint32_t)num_chunks * table->rows_per_chunk + table->rows_per_version - 1) / table->rows_per_version;
+	if (table->versions.length() > num_blocks * table->num_columns)
+		table->versions.set_length(num_blocks * table->num_columns);
+}
+
+/**
+ * Removes a row by moving the last row into it. Returns the index of the moved
+ * entity or UINT32_MAX if no entity moved.
+ */
+static uint32_t ecs_table_remove_row(ecs_t* ecs, ecs_table_t* table, uint32_t row)
+{
+	uint32_t last = table->count - 1;
+	uint32_t moved = UINT32_MAX;
+	if (row != last)
+	{
+		ecs_table_move_row(table, row, last);
+		moved = ecs_entity_index(*ecs_table_eid(table, row));
+		ecs_table_mark_rows(ecs, table, row, 1);
+	}
+	ecs_table_truncate(ecs, table, last);
+	return moved;
+}
+
+/**
+ * Removes the rows in any order by clearing their entity ids and filling the holes
+ * below the new count with the last live rows. Afterwards each of the rows that is
+ * still below table->count holds a moved entity.
+ */
+static void ecs_table_remove_rows(ecs_t* ecs, ecs_table_t* table, const uint64_t* rows, uint32_t num_rows)
+{
+	for (uint32_t i = 0; i < num_rows; ++i)
+		ecs_table_eid(table, (uint32_t)rows[i])->id = 0;
+
+	// There are as many holes below count as live rows from count on, which
+	// are found walking the tail backwards a chunk at a time
+	uint32_t count = table->count - num_rows;
+	uint32_t last = table->count;
+	uint32_t tail_first = last;
+	const entity_id_t* tail_eids = nullptr;
+	uint32_t first_moved = count;
+	for (uint32_t i = 0; i < num_rows; ++i)
+	{
+		uint32_t row = (uint32_t)rows[i];
+		if (row >= count)
+			continue;
+		do
+		{
+			if (last-- == tail_first)
+			{
+				tail_first = last - last % table->rows_per_chunk;
+				tail_eids = (const entity_id_t*)table->chunks[last / table->rows_per_chunk];
+			}
+		} while (tail_eids[last - tail_first].id == 0);
+		ecs_table_move_row(table, row, last);
+		first_moved = row < first_moved ? row : first_moved;
+	}
+
+	// The holes are spread out, marking the blocks from the first one on is close enough
+	if (first_moved < count)
+		ecs_table_mark_rows(ecs, table, first_moved, count - first_moved);
+	ecs_table_truncate(ecs, table, count);
+}
+
+void ecs_table_clear(ecs_t* ecs, ecs_table_t* table)
+{
+	while (table->chunks.length() > 1)
+	{
+		ecs_chunk_free(ecs, table->chunks.back(), table->chunk_size);
+		table->chunks.remove_back();
+	}
+	table->count = 0;
+	table->versions.set_length(0);
+}
+
+/******************************************************************************\
+*
+*  Array storage
+*
+\******************************************************************************/
+
+static ecs_result_t ecs_array_add(ecs_t* ecs, entity_id_t eid, const component_data_t* component_data)
+{
+	component_desc_t* desc = &ecs->component_descs[component_data->type.id];
+	if (desc->rows[ecs_entity_index(eid)] != UINT32_MAX)
+		return ECS_RESULT_COMPONENT_EXISTS;
+
+	ecs_table_t* table = &ecs->tables[desc->table];
+	ASSERT(desc->max_components == 0 || table->count < desc->max_components, "Out of components");
+	uint32_t row = ecs_table_push_row(ecs, table, eid);
+	ecs_table_write(table, row, 0, component_data->data);
+	desc->rows[ecs_entity_index(eid)] = row;
+	return ECS_RESULT_OK;
+}
+
+static void ecs_array_remove(ecs_t* ecs, uint32_t index, component_desc_t* desc)
+{
+	uint32_t row = desc->rows[index];
+	uint32_t moved = ecs_table_remove_row(ecs, &ecs->tables[desc->table], row);
+	if (moved != UINT32_MAX)
+		desc->rows[moved] = row;
+	desc->rows[index] = UINT32_MAX;
+}
+
+/******************************************************************************\
+*
+*  Archetype storage
+*
+\******************************************************************************/
+
+static void ecs_sort_types(component_type_id_t* types, uint32_t num_types)
+{
+	for (uint32_t i = 1; i < num_types; ++i)
+	{
+		component_type_id_t type = types[i];
+		uint32_t j = i;
+		for (; j > 0 && types[j - 1].id > type.id; --j)
+			types[j] = types[j - 1];
+		types[j] = type;
+	}
+}
+
+static bool ecs_archetype_matches(const ecs_table_t* table, const component_type_id_t* types, uint32_t num_types, const uint32_t* shared_values)
 {
-	uint32_t component_size;
-	uint8_t* component_data;
-	entity_id_t* eids;
-	uint32_t count;
-	uint32_t max;
-};
+	if (table->num_columns != num_types)
+		return false;
+	for (uint32_t i = 0; i < num_types; ++i)
+	{
+		if (table->columns[i].type.id != types[i].id || table->columns[i].shared_value != (shared_values ? shared_values[i] : UINT32_MAX))
+			return false;
+	}
+	return true;
+}
 
-struct ecs_t
+uint32_t ecs_archetype_find_or_create(ecs_t* ecs, const component_type_id_t* types, uint32_t num_types, const uint32_t* shared_values)
 {
-	allocator_t* allocator;
-	idpool_t<uint32_t> entity_id_pool;
-	array_t<component_desc_t> component_descs;
-};
+	// Every distinct shared value gets its own archetype
+	bool any_shared = false;
+	for (uint32_t i = 0; i < num_types && shared_values; ++i)
+		any_shared = any_shared || shared_values[i] != UINT32_MAX;
+	shared_values = any_shared ? shared_values : nullptr;
+	uint64_t key = hash_buffer_64(types, num_types * sizeof(component_type_id_t));
+	if (any_shared)
+		key = key * 31 + hash_buffer_64(shared_values, num_types * sizeof(uint32_t));
+
+	// Another archetype with the same hash took the key, the next free one is used instead.
+	// Archetypes are never removed, so a probe can stop at the first missing key.
+	for (const uint32_t* found; (found = ecs->table_lookup.find(key)) != nullptr; ++key)
+	{
+		if (ecs_archetype_matches(&ecs->tables[*found], types, num_types, shared_values))
+			return *found;
+	}
+
+	ASSERT(!ecs->tables.full(), "Out of archetypes");
+	uint32_t index = (uint32_t)ecs->tables.length();
+	ecs->tables.set_length(index + 1);
+	ecs_table_create(ecs, &ecs->tables[index], types, num_types, shared_values);
+	ecs->table_lookup.insert(key, index);
+	return index;
+}
+
+static void ecs_archetype_remove_row(ecs_t* ecs, uint32_t table, uint32_t row)
+{
+	uint32_t moved = ecs_table_remove_row(ecs, &ecs->tables[table], row);
+	if (moved != UINT32_MAX)
+		ecs->records[moved].row = row;
+}
+
+/**
+ * Moves an entity to another archetype, keeping the components they have in common.
+ */
+static void ecs_archetype_move(ecs_t* ecs, entity_id_t eid, uint32_t dst_table)
+{
+	ecs_record_t* record = &ecs->records[ecs_entity_index(eid)];
+	ecs_table_t* src = &ecs->tables[record->table];
+	ecs_table_t* dst = &ecs->tables[dst_table];
+
+	uint32_t dst_row = ecs_table_push_row(ecs, dst, eid);
+	ecs_table_copy_row(dst, dst_row, src, record->row);
+	ecs_archetype_remove_row(ecs, record->table, record->row);
+
+	record->table = dst_table;
+	record->row = dst_row;
+}
+
+/**
+ * Drops the references count rows of the table hold on shared values.
+ */
+static void ecs_archetype_release_shared(ecs_t* ecs, uint32_t table, uint32_t count)
+{
+	const ecs_table_t* t = &ecs->tables[table];
+	for (uint32_t i = 0; i < t->num_columns; ++i)
+	{
+		if (t->columns[i].shared_value != UINT32_MAX)
+			ecs_shared_release(ecs, t->columns[i].type, t->columns[i].shared_value, count);
+	}
+}
+
+/******************************************************************************\
+*
+*  Shared components
+*
+\******************************************************************************/
+
+/**
+ * Values are looked up by the hash of their bytes. A different value with the
+ * same hash takes the next free key, so a lookup probes key, key + 1, ...
+ * comparing the bytes until a key is missing. Returns UINT32_MAX if the value
+ * is not there, out_key is the key holding the value or the first free one.
+ */
+static uint32_t ecs_shared_find(ecs_t* ecs, component_type_id_t type, const void* data, uint64_t* out_key)
+{
+	component_desc_t* desc = &ecs->component_descs[type.id];
+	uint64_t key = hash_buffer_64(data, desc->component_size);
+	const uint32_t* found;
+	for (; (found = desc->shared_lookup.find(key)) != nullptr; ++key)
+	{
+		if (memcmp(ecs_shared_get(ecs, type, *found), data, desc->component_size) == 0)
+			break;
+	}
+	*out_key = key;
+	return found ? *found : UINT32_MAX;
+}
+
+void ecs_shared_lookup_insert(ecs_t* ecs, component_type_id_t type, uint32_t value)
+{
+	uint64_t key;
+	uint32_t found = ecs_shared_find(ecs, type, ecs_shared_get(ecs, type, value), &key);
+	ASSERT(found == UINT32_MAX, "Shared value is already in the lookup");
+	(void)found;
+	ecs->component_descs[type.id].shared_lookup.insert(key, value);
+}
+
+/**
+ * Removes the key of the value and moves later keys of the same probe back
+ * into the hole, so lookups never stop early at a gap.
+ */
+static void ecs_shared_lookup_remove(ecs_t* ecs, component_type_id_t type, uint32_t value)
+{
+	component_desc_t* desc = &ecs->component_descs[type.id];
+	uint64_t hole;
+	uint32_t found = ecs_shared_find(ecs, type, ecs_shared_get(ecs, type, value), &hole);
+	ASSERT(found == value, "Shared value is not in the lookup");
+	(void)found;
+	desc->shared_lookup.remove(hole);
+
+	for (uint64_t next = hole + 1;; ++next)
+	{
+		const uint32_t* moved = desc->shared_lookup.find(next);
+		if (moved == nullptr)
+			break;
+
+		// Only keys whose probe started at or before the hole can move into it
+		uint64_t home = hash_buffer_64(ecs_shared_get(ecs, type, *moved), desc->component_size);
+		if (hole - home < next - home)
+		{
+			uint32_t moved_value = *moved;
+			desc->shared_lookup.remove(next);
+			desc->shared_lookup.insert(hole, moved_value);
+			hole = next;
+		}
+	}
+}
+
+uint32_t ecs_shared_acquire(ecs_t* ecs, component_type_id_t type, const void* data, uint32_t count)
+{
+	component_desc_t* desc = &ecs->component_descs[type.id];
+	ASSERT(desc->shared, "Component type is not shared");
+
+	uint64_t key;
+	uint32_t found = ecs_shared_find(ecs, type, data, &key);
+	if (found != UINT32_MAX)
+	{
+		desc->shared_refs[found] += count;
+		return found;
+	}
+
+	ASSERT(!desc->shared_lookup.full(), "Out of shared values");
+	uint32_t value;
+	if (desc->shared_free.any())
+	{
+		value = desc->shared_free.back();
+		desc->shared_free.remove_back();
+	}
+	else
+	{
+		value = (uint32_t)desc->shared_refs.length();
+		ecs_array_push(ecs->allocator, &desc->shared_refs, 0U);
+		desc->shared_values.ensure_capacity(ecs->allocator, desc->shared_refs.capacity() * desc->component_size);
+		desc->shared_values.set_length(desc->shared_refs.length() * desc->component_size);
+	}
+
+	memcpy(ecs_shared_get(ecs, type, value), data, desc->component_size);
+	desc->shared_refs[value] = count;
+	desc->shared_lookup.insert(key, value);
+	return value;
+}
+
+void ecs_shared_release(ecs_t* ecs, component_type_id_t type, uint32_t value, uint32_t count)
+{
+	component_desc_t* desc = &ecs->component_descs[type.id];
+	ASSERT(desc->shared_refs[value] >= count, "Shared value released too many times");
+	desc->shared_refs[value] -= count;
+	if (desc->shared_refs[value] == 0)
+	{
+		// Archetypes keep the index, a new value in the slot reuses them
+		ecs_shared_lookup_remove(ecs, type, value);
+		ecs_array_push(ecs->allocator, &desc->shared_free, value);
+	}
+}
+
+/******************************************************************************\
+*
+*  ECS operations
+*
+\******************************************************************************/
 
 ecs_result_t ecs_create(const ecs_create_info_t* create_info, ecs_t** out_ecs)
 {
 	ecs_t* ecs = ALLOCATOR_ALLOC_TYPE(create_info->allocator, ecs_t);
 	memset(ecs, 0, sizeof(ecs_t));
-	
+
 	ecs->allocator = create_info->allocator;
+	ecs->storage = create_info->storage;
+	ecs->max_entities = create_info->max_entities;
+	ASSERT(create_info->max_entities <= ECS_ENTITY_INDEX_MASK + 1, "Too many entities for the index bits");
+	ASSERT(create_info->max_component_types <= ECS_MAX_COMPONENT_TYPES, "Too many component types for the signatures");
 	ecs->entity_id_pool.create(ecs->allocator, create_info->max_entities);
+	ecs->entity_ids = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, create_info->max_entities, entity_id_t);
+	for (uint32_t i = 0; i < create_info->max_entities; ++i)
+		ecs->entity_ids[i].id = (i | (1U << ECS_ENTITY_INDEX_BITS)) ^ ECS_ENTITY_INDEX_MASK; // Free, generation 0 is never used
+	ecs->signatures = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, create_info->max_entities, ecs_signature_t);
+	memset(ecs->signatures, 0, create_info->max_entities * sizeof(ecs_signature_t));
 	ecs->component_descs.create(ecs->allocator, create_info->max_component_types);
 
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		ASSERT(create_info->max_archetypes > 0);
+		ecs->tables.create(ecs->allocator, create_info->max_archetypes);
+		ecs->table_lookup.create(ecs->allocator, create_info->max_archetypes);
+		ecs->records = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, create_info->max_entities, ecs_record_t);
+
+		// Entities without components live in the empty archetype
+		ecs_archetype_find_or_create(ecs, nullptr, 0, nullptr);
+	}
+	else
+	{
+		ecs->tables.create(ecs->allocator, create_info->max_component_types);
+	}
+
 	*out_ecs = ecs;
 	return ECS_RESULT_OK;
 }
@@ -37,14 +607,39 @@ ecs_result_t ecs_destroy(ecs_t* ecs)
 {
 	ASSERT(ecs->entity_id_pool.num_used() == 0, "Still live entities while destroiung ECS");
 
+	ecs_systems_destroy(ecs);
+	while (ecs->observers.length() > 0)
+		ecs_observer_destroy(ecs, ecs->observers[ecs->observers.length() - 1]);
+	ecs->observers.destroy(ecs->allocator);
+
+	for (size_t i = 0; i < ecs->tables.length(); ++i)
+		ecs_table_destroy(ecs, &ecs->tables[i]);
+	ecs->tables.destroy(ecs->allocator);
+	for (size_t i = 0; i < ecs->free_chunks.length(); ++i)
+		ALLOCATOR_FREE(ecs->allocator, ecs->free_chunks[i]);
+	ecs->free_chunks.destroy(ecs->allocator);
+	ecs->table_lookup.destroy(ecs->allocator);
+	ALLOCATOR_FREE(ecs->allocator, ecs->records);
+
 	for (size_t i = 0; i < ecs->component_descs.length(); ++i)
 	{
-		ALLOCATOR_FREE(ecs->allocator, ecs->component_descs[i].component_data);
-		ALLOCATOR_FREE(ecs->allocator, ecs->component_descs[i].eids);
+		component_desc_t* desc = &ecs->component_descs[i];
+		ALLOCATOR_FREE(ecs->allocator, desc->rows);
+		ALLOCATOR_FREE(ecs->allocator, desc->singleton);
+		desc->shared_values.destroy(ecs->allocator);
+		desc->shared_refs.destroy(ecs->allocator);
+		desc->shared_free.destroy(ecs->allocator);
+		desc->shared_lookup.destroy(ecs->allocator);
 	}
 	ecs->component_descs.destroy(ecs->allocator);
 
 	ecs->entity_id_pool.destroy(ecs->allocator);
+	ALLOCATOR_FREE(ecs->allocator, ecs->entity_ids);
+	ALLOCATOR_FREE(ecs->allocator, ecs->signatures);
+	ecs->scratch.destroy(ecs->allocator);
+	ecs->defrag_order.destroy(ecs->allocator);
+	ecs->defrag_merge.destroy(ecs->allocator);
+	ecs->observer_events.destroy(ecs->allocator);
 
 	ALLOCATOR_FREE(ecs->allocator, ecs);
 	return ECS_RESULT_OK;
@@ -57,90 +652,617 @@ ecs_result_t ecs_register_component_type(ecs_t* ecs, const component_type_create
 	component_desc_t* desc = &ecs->component_descs[cid];
 	memset(desc, 0, sizeof(component_desc_t));
 	desc->component_size = create_info->component_size;
-	desc->component_data = (uint8_t*)ALLOCATOR_ALLOC(ecs->allocator, create_info->max_components * create_info->component_size, 16);
-	desc->eids = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, create_info->max_components, entity_id_t);
-	desc->count = 0;
-	desc->max = create_info->max_components;
+	desc->num_fields = create_info->num_fields > 1 ? create_info->num_fields : 1;
+	desc->max_components = create_info->max_components;
+	ASSERT(desc->component_size % desc->num_fields == 0, "Component size has to be a multiple of the number of fields");
+	desc->table = UINT32_MAX;
 
 	out_id->id = cid;
+
+	if (create_info->component_size == 0)
+	{
+		ASSERT(!create_info->shared, "Tags can not be shared");
+		desc->tag = true;
+		return ECS_RESULT_OK;
+	}
+
+	if (create_info->shared)
+	{
+		ASSERT(ecs->storage == ECS_STORAGE_ARCHETYPES, "Shared components need archetype storage");
+		ASSERT(desc->num_fields == 1, "Shared components can not be split");
+		desc->shared = true;
+		desc->shared_lookup.create(ecs->allocator, create_info->max_components ? create_info->max_components : 256);
+	}
+
+	if (ecs->storage == ECS_STORAGE_ARRAYS)
+	{
+		desc->table = static_cast<uint32_t>(ecs->tables.length());
+		ecs->tables.set_length(ecs->tables.length() + 1);
+		ecs_table_create(ecs, &ecs->tables[desc->table], out_id, 1, nullptr);
+
+		desc->rows = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, ecs->max_entities, uint32_t);
+		memset(desc->rows, 0xFF, ecs->max_entities * sizeof(uint32_t));
+	}
+
 	return ECS_RESULT_OK;
 }
 
 ecs_result_t ecs_entity_create(ecs_t* ecs, const entity_create_info_t* create_info, entity_id_t* out_id)
 {
-	uint32_t eid = ecs->entity_id_pool.alloc_handle();
+	return ecs_entities_create_batch(ecs, create_info, 1, out_id);
+}
+
+ecs_result_t ecs_entity_destroy(ecs_t* ecs, entity_id_t eid)
+{
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+
+	uint32_t index = ecs_entity_index(eid);
+	ecs_observe_signature(ecs, index, ECS_OBSERVE_TOUCHED);
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		ecs_archetype_release_shared(ecs, ecs->records[index].table, 1);
+		ecs_archetype_remove_row(ecs, ecs->records[index].table, ecs->records[index].row);
+	}
+	else
+	{
+		// Only the arrays holding the entity are touched
+		const ecs_signature_t* signature = &ecs->signatures[index];
+		for (uint32_t i = 0; i < ECS_MAX_COMPONENT_TYPES / 64; ++i)
+		{
+			for (uint64_t bits = signature->bits[i]; bits; bits &= bits - 1)
+			{
+				component_desc_t* desc = &ecs->component_descs[i * 64 + bits_lsb(bits)];
+				if (!desc->tag)
+					ecs_array_remove(ecs, index, desc);
+			}
+		}
+	}
+
+	memset(&ecs->signatures[index], 0, sizeof(ecs_signature_t));
+	ecs_entity_free(ecs, eid);
+	return ECS_RESULT_OK;
+}
+
+bool ecs_entity_is_alive(const ecs_t* ecs, entity_id_t eid)
+{
+	return ecs_entity_alive(ecs, eid);
+}
 
+void ecs_entities_insert(ecs_t* ecs, const entity_create_info_t* create_info, uint32_t count, const entity_id_t* eids)
+{
+	// Tags only end up in the signature
+	ASSERT(create_info->num_components <= ECS_MAX_COMPONENTS_PER_ENTITY, "Too many components");
+	ecs_signature_t signature;
+	memset(&signature, 0, sizeof(signature));
+	const component_data_t* component_datas[ECS_MAX_COMPONENTS_PER_ENTITY];
+	uint32_t num_components = 0;
 	for (uint32_t i = 0; i < create_info->num_components; ++i)
 	{
-		component_desc_t* desc = &ecs->component_descs[create_info->component_datas[i].type.id];
-		ASSERT(desc->count < desc->max);
-		uint8_t* dst = desc->component_data + (desc->component_size + desc->count);
-		memcpy(dst, create_info->component_datas[i].data, desc->component_size);
-		desc->eids[desc->count].id = eid;
-		desc->count += 1;
+		const component_data_t* component_data = &create_info->component_datas[i];
+		ASSERT(!ecs_signature_test(&signature, component_data->type), "Component type added twice to the same entity");
+		ecs_signature_set(&signature, component_data->type);
+		if (!ecs->component_descs[component_data->type.id].tag)
+			component_datas[num_components++] = component_data;
 	}
 
-	out_id->id = eid;
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		component_type_id_t types[ECS_MAX_COMPONENTS_PER_ENTITY];
+		for (uint32_t i = 0; i < num_components; ++i)
+			types[i] = component_datas[i]->type;
+		ecs_sort_types(types, num_components);
+
+		// Entities with different shared values end up in different archetypes, each run of equal values is inserted at once
+		uint32_t run = 0;
+		for (uint32_t begin = 0; begin < count; begin += run)
+		{
+			run = count - begin;
+			for (uint32_t i = 0; i < num_components; ++i)
+			{
+				const component_desc_t* desc = &ecs->component_descs[component_datas[i]->type.id];
+				if (!desc->shared)
+					continue;
+				const uint8_t* value = (const uint8_t*)component_datas[i]->data + begin * desc->component_size;
+				uint32_t n = 1;
+				while (n < run && memcmp(value + n * desc->component_size, value, desc->component_size) == 0)
+					++n;
+				run = n;
+			}
+
+			uint32_t shared_values[ECS_MAX_COMPONENTS_PER_ENTITY];
+			for (uint32_t i = 0; i < num_components; ++i)
+			{
+				const component_data_t* component_data = component_datas[i];
+				const component_desc_t* desc = &ecs->component_descs[component_data->type.id];
+				uint32_t j = 0;
+				while (types[j].id != component_data->type.id)
+					++j;
+				shared_values[j] = desc->shared ? ecs_shared_acquire(ecs, component_data->type, (const uint8_t*)component_data->data + begin * desc->component_size, run) : UINT32_MAX;
+			}
+
+			uint32_t table_index = ecs_archetype_find_or_create(ecs, types, num_components, shared_values);
+			ecs_table_t* table = &ecs->tables[table_index];
+			uint32_t first = ecs_table_push_rows(ecs, table, run);
+			for (uint32_t i = 0; i < run; ++i)
+			{
+				*ecs_table_eid(table, first + i) = eids[begin + i];
+				ecs->records[ecs_entity_index(eids[begin + i])].table = table_index;
+				ecs->records[ecs_entity_index(eids[begin + i])].row = first + i;
+			}
+
+			for (uint32_t i = 0; i < num_components; ++i)
+			{
+				const component_data_t* component_data = component_datas[i];
+				uint32_t column = ecs_table_find_column(table, component_data->type);
+				const uint8_t* src = (const uint8_t*)component_data->data + begin * ecs->component_descs[component_data->type.id].component_size;
+				ecs_table_copy_column(table, first, run, column, src);
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < num_components; ++i)
+		{
+			const component_data_t* component_data = component_datas[i];
+			component_desc_t* desc = &ecs->component_descs[component_data->type.id];
+			ecs_table_t* table = &ecs->tables[desc->table];
+			ASSERT(desc->max_components == 0 || table->count + count <= desc->max_components, "Out of components");
+
+			uint32_t first = ecs_table_push_rows(ecs, table, count);
+			for (uint32_t j = 0; j < count; ++j)
+			{
+				desc->rows[ecs_entity_index(eids[j])] = first + j;
+				*ecs_table_eid(table, first + j) = eids[j];
+			}
+			ecs_table_copy_column(table, first, count, 0, (const uint8_t*)component_data->data);
+		}
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		ecs->signatures[ecs_entity_index(eids[i])] = signature;
+		ecs_observe_signature(ecs, ecs_entity_index(eids[i]), ECS_OBSERVE_TOUCHED);
+	}
+}
+
+ecs_result_t ecs_entities_create_batch(ecs_t* ecs, const entity_create_info_t* create_info, uint32_t count, entity_id_t* out_eids)
+{
+	ASSERT(ecs->entity_id_pool.num_free() >= count, "Out of entities");
+	for (uint32_t i = 0; i < count; ++i)
+		out_eids[i] = ecs_entity_alloc(ecs);
+
+	ecs_entities_insert(ecs, create_info, count, out_eids);
 	return ECS_RESULT_OK;
 }
 
-static uint32_t ecs_find_eid_in_arr(const entity_id_t* haystack, uint32_t haystack_count, entity_id_t needle)
+ecs_result_t ecs_entities_destroy_batch(ecs_t* ecs, const entity_id_t* eids, uint32_t count)
 {
-	for (uint32_t i = 0; i < haystack_count; ++i)
+	uint32_t num_tables = (uint32_t)ecs->tables.length();
+	array_t<uint64_t>* scratch = &ecs->scratch;
+	scratch->ensure_capacity(ecs->allocator, (size_t)count + num_tables + 1);
+
+	// The ids are freed up front, so dead and repeated ids fail the generation check and are skipped.
+	// No id is allocated before the rows are removed, the freed indices keep their records until then.
+	uint64_t* indices = scratch->begin();
+	uint32_t num_indices = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (!ecs_entity_alive(ecs, eids[i]))
+			continue;
+		uint32_t index = ecs_entity_index(eids[i]);
+		ecs_observe_signature(ecs, index, ECS_OBSERVE_TOUCHED);
+		ecs_entity_free(ecs, eids[i]);
+		indices[num_indices++] = index;
+	}
+
+	// Counting sort of the rows on their table, so each table is compacted once.
+	// offsets[t + 1] first counts the rows of table t, then holds where they start.
+	uint64_t* offsets = indices + count;
+	memset(offsets, 0, (num_tables + 1) * sizeof(uint64_t));
+	for (uint32_t i = 0; i < num_indices; ++i)
+	{
+		uint32_t index = (uint32_t)indices[i];
+		if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+		{
+			++offsets[ecs->records[index].table + 1];
+			continue;
+		}
+		const ecs_signature_t* signature = &ecs->signatures[index];
+		for (uint32_t w = 0; w < ECS_MAX_COMPONENT_TYPES / 64; ++w)
+		{
+			for (uint64_t bits = signature->bits[w]; bits; bits &= bits - 1)
+			{
+				const component_desc_t* desc = &ecs->component_descs[w * 64 + bits_lsb(bits)];
+				if (!desc->tag)
+					++offsets[desc->table + 1];
+			}
+		}
+	}
+	for (uint32_t t = 0; t < num_tables; ++t)
+		offsets[t + 1] += offsets[t];
+
+	// Scattering moves offsets[t] on to the end of the rows of table t
+	uint32_t num_rows = (uint32_t)offsets[num_tables];
+	scratch->ensure_capacity(ecs->allocator, (size_t)count + num_tables + 1 + num_rows);
+	indices = scratch->begin();
+	offsets = indices + count;
+	uint64_t* rows = offsets + num_tables + 1;
+	for (uint32_t i = 0; i < num_indices; ++i)
+	{
+		uint32_t index = (uint32_t)indices[i];
+		if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+		{
+			const ecs_record_t* record = &ecs->records[index];
+			rows[offsets[record->table]++] = record->row;
+			continue;
+		}
+		const ecs_signature_t* signature = &ecs->signatures[index];
+		for (uint32_t w = 0; w < ECS_MAX_COMPONENT_TYPES / 64; ++w)
+		{
+			for (uint64_t bits = signature->bits[w]; bits; bits &= bits - 1)
+			{
+				component_desc_t* desc = &ecs->component_descs[w * 64 + bits_lsb(bits)];
+				if (desc->tag)
+					continue;
+				rows[offsets[desc->table]++] = desc->rows[index];
+				desc->rows[index] = UINT32_MAX;
+			}
+		}
+	}
+
+	for (uint32_t t = 0; t < num_tables; ++t)
 	{
-		if (haystack[i].id == needle.id)
-			return i;
+		uint32_t begin = t ? (uint32_t)offsets[t - 1] : 0;
+		uint32_t num_table_rows = (uint32_t)offsets[t] - begin;
+		if (num_table_rows == 0)
+			continue;
+
+		ecs_table_t* table = &ecs->tables[t];
+		if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+			ecs_archetype_release_shared(ecs, t, num_table_rows);
+		ecs_table_remove_rows(ecs, table, rows + begin, num_table_rows);
+
+		// Array tables hold a single component type
+		uint32_t* desc_rows = ecs->storage == ECS_STORAGE_ARRAYS ? ecs->component_descs[table->columns[0].type.id].rows : nullptr;
+		for (uint32_t i = begin; i < begin + num_table_rows; ++i)
+		{
+			uint32_t row = (uint32_t)rows[i];
+			if (row >= table->count)
+				continue;
+			uint32_t moved = ecs_entity_index(*ecs_table_eid(table, row));
+			if (desc_rows)
+				desc_rows[moved] = row;
+			else
+				ecs->records[moved].row = row;
+		}
 	}
 
-	return UINT32_MAX;
+	for (uint32_t i = 0; i < num_indices; ++i)
+		memset(&ecs->signatures[indices[i]], 0, sizeof(ecs_signature_t));
+	return num_indices == count ? ECS_RESULT_OK : ECS_RESULT_NO_SUCH_ENTITY;
 }
 
-ecs_result_t ecs_entity_destroy(ecs_t* ecs, entity_id_t eid)
+ecs_result_t ecs_prefab_create(ecs_t* ecs, const entity_create_info_t* create_info, ecs_prefab_t** out_prefab)
 {
-	// TODO: perhaps add a component mask to each entity?
-	// TODO: super slow when removing a lot of entities in a bad pattern =)
-	for (size_t i = 0; i < ecs->component_descs.length(); ++i)
+	ASSERT(create_info->num_components <= ECS_MAX_COMPONENTS_PER_ENTITY, "Too many components");
+
+	ecs_prefab_t* prefab = ALLOCATOR_ALLOC_TYPE(ecs->allocator, ecs_prefab_t);
+	memset(prefab, 0, sizeof(ecs_prefab_t));
+	for (uint32_t i = 0; i < create_info->num_components; ++i)
 	{
-		component_desc_t* desc = &ecs->component_descs[i];
-		uint32_t index = ecs_find_eid_in_arr(desc->eids, desc->count, eid);
+		component_type_id_t type = create_info->component_datas[i].type;
+		ASSERT(!ecs_signature_test(&prefab->signature, type), "Component type added twice to the same prefab");
+		ecs_signature_set(&prefab->signature, type);
+		if (!ecs->component_descs[type.id].tag)
+			prefab->types[prefab->num_components++] = type;
+	}
+	ecs_sort_types(prefab->types, prefab->num_components);
+
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < prefab->num_components; ++i)
+	{
+		prefab->offsets[i] = size;
+		size += (uint32_t)ALIGN_UP(ecs->component_descs[prefab->types[i].id].component_size, 16);
+	}
+	prefab->data = (uint8_t*)ALLOCATOR_ALLOC(ecs->allocator, size ? size : 16, 16);
+
+	for (uint32_t i = 0; i < create_info->num_components; ++i)
+	{
+		const component_data_t* component_data = &create_info->component_datas[i];
+		if (ecs->component_descs[component_data->type.id].tag)
+			continue;
+		uint32_t j = 0;
+		while (prefab->types[j].id != component_data->type.id)
+			++j;
+		memcpy(prefab->data + prefab->offsets[j], component_data->data, ecs->component_descs[component_data->type.id].component_size);
+	}
 
-		if (index != UINT32_MAX)
+	// The prefab holds a reference to its shared values, so the archetype keeps matching them
+	for (uint32_t i = 0; i < prefab->num_components; ++i)
+	{
+		bool shared = ecs->component_descs[prefab->types[i].id].shared;
+		prefab->shared_values[i] = shared ? ecs_shared_acquire(ecs, prefab->types[i], prefab->data + prefab->offsets[i], 1) : UINT32_MAX;
+	}
+
+	prefab->table = UINT32_MAX;
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+		prefab->table = ecs_archetype_find_or_create(ecs, prefab->types, prefab->num_components, prefab->shared_values);
+
+	*out_prefab = prefab;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_prefab_destroy(ecs_t* ecs, ecs_prefab_t* prefab)
+{
+	for (uint32_t i = 0; i < prefab->num_components; ++i)
+	{
+		if (prefab->shared_values[i] != UINT32_MAX)
+			ecs_shared_release(ecs, prefab->types[i], prefab->shared_values[i], 1);
+	}
+	ALLOCATOR_FREE(ecs->allocator, prefab->data);
+	ALLOCATOR_FREE(ecs->allocator, prefab);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_prefab_instantiate(ecs_t* ecs, const ecs_prefab_t* prefab, uint32_t count, entity_id_t* out_eids)
+{
+	ASSERT(ecs->entity_id_pool.num_free() >= count, "Out of entities");
+	for (uint32_t i = 0; i < count; ++i)
+		out_eids[i] = ecs_entity_alloc(ecs);
+
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		// The table columns are the prefab types in the same order
+		ecs_table_t* table = &ecs->tables[prefab->table];
+		uint32_t first = ecs_table_push_rows(ecs, table, count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			*ecs_table_eid(table, first + i) = out_eids[i];
+			ecs->records[ecs_entity_index(out_eids[i])].table = prefab->table;
+			ecs->records[ecs_entity_index(out_eids[i])].row = first + i;
+		}
+
+		for (uint32_t i = 0; i < prefab->num_components; ++i)
+		{
+			if (prefab->shared_values[i] != UINT32_MAX)
+				ecs->component_descs[prefab->types[i].id].shared_refs[prefab->shared_values[i]] += count;
+			else
+				ecs_table_fill_column(table, first, count, i, prefab->data + prefab->offsets[i]);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < prefab->num_components; ++i)
 		{
-			uint32_t end = --desc->count;
-			if (index != end)
+			component_desc_t* desc = &ecs->component_descs[prefab->types[i].id];
+			ecs_table_t* table = &ecs->tables[desc->table];
+			ASSERT(desc->max_components == 0 || table->count + count <= desc->max_components, "Out of components");
+
+			uint32_t first = ecs_table_push_rows(ecs, table, count);
+			for (uint32_t j = 0; j < count; ++j)
 			{
-				// We need to copy in the end element
-				desc->eids[index].id = desc->eids[end].id;
-				uint8_t* dst = desc->component_data + index * desc->component_size;
-				uint8_t* src = desc->component_data + end * desc->component_size;
-				memcpy(dst, src, desc->component_size);
+				desc->rows[ecs_entity_index(out_eids[j])] = first + j;
+				*ecs_table_eid(table, first + j) = out_eids[j];
 			}
+			ecs_table_fill_column(table, first, count, 0, prefab->data + prefab->offsets[i]);
 		}
 	}
 
-	ecs->entity_id_pool.free_handle(eid.id);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		ecs->signatures[ecs_entity_index(out_eids[i])] = prefab->signature;
+		ecs_observe_signature(ecs, ecs_entity_index(out_eids[i]), ECS_OBSERVE_TOUCHED);
+	}
 	return ECS_RESULT_OK;
 }
 
-ecs_result_t ecs_query_component(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid, query_result_t* out_result)
+ecs_result_t ecs_entity_add_component(ecs_t* ecs, entity_id_t eid, const component_data_t* component_data)
 {
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+
+	uint32_t index = ecs_entity_index(eid);
+	if (ecs_signature_test(&ecs->signatures[index], component_data->type))
+		return ECS_RESULT_COMPONENT_EXISTS;
+	ecs_signature_set(&ecs->signatures[index], component_data->type);
+	ecs_observe(ecs, component_data->type, index, ECS_OBSERVE_TOUCHED);
+	if (ecs->component_descs[component_data->type.id].tag)
+		return ECS_RESULT_OK;
+	if (ecs->storage == ECS_STORAGE_ARRAYS)
+		return ecs_array_add(ecs, eid, component_data);
+
+	const ecs_table_t* src = &ecs->tables[ecs->records[index].table];
+
+	ASSERT(src->num_columns < ECS_MAX_COMPONENTS_PER_ENTITY, "Too many components");
+	component_type_id_t types[ECS_MAX_COMPONENTS_PER_ENTITY];
+	uint32_t shared_values[ECS_MAX_COMPONENTS_PER_ENTITY];
+	uint32_t num_types = 0;
+	uint32_t i = 0;
+	for (; i < src->num_columns && src->columns[i].type.id < component_data->type.id; ++i)
+	{
+		shared_values[num_types] = src->columns[i].shared_value;
+		types[num_types++] = src->columns[i].type;
+	}
+	bool shared = ecs->component_descs[component_data->type.id].shared;
+	shared_values[num_types] = shared ? ecs_shared_acquire(ecs, component_data->type, component_data->data, 1) : UINT32_MAX;
+	types[num_types++] = component_data->type;
+	for (; i < src->num_columns; ++i)
+	{
+		shared_values[num_types] = src->columns[i].shared_value;
+		types[num_types++] = src->columns[i].type;
+	}
+
+	uint32_t table_index = ecs_archetype_find_or_create(ecs, types, num_types, shared_values);
+	ecs_archetype_move(ecs, eid, table_index);
+
+	ecs_table_t* dst = &ecs->tables[table_index];
+	uint32_t column = ecs_table_find_column(dst, component_data->type);
+	ecs_table_write(dst, ecs->records[index].row, column, component_data->data);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_entity_remove_component(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid)
+{
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+
+	uint32_t index = ecs_entity_index(eid);
+	if (!ecs_signature_test(&ecs->signatures[index], ctid))
+		return ECS_RESULT_NO_SUCH_COMPONENT;
+	ecs_signature_clear(&ecs->signatures[index], ctid);
+	ecs_observe(ecs, ctid, index, ECS_OBSERVE_TOUCHED);
+	if (ecs->component_descs[ctid.id].tag)
+		return ECS_RESULT_OK;
+	if (ecs->storage == ECS_STORAGE_ARRAYS)
+	{
+		ecs_array_remove(ecs, index, &ecs->component_descs[ctid.id]);
+		return ECS_RESULT_OK;
+	}
+
+	const ecs_table_t* src = &ecs->tables[ecs->records[index].table];
+	uint32_t removed = ecs_table_find_column(src, ctid);
+
+	component_type_id_t types[ECS_MAX_COMPONENTS_PER_ENTITY];
+	uint32_t shared_values[ECS_MAX_COMPONENTS_PER_ENTITY];
+	uint32_t num_types = 0;
+	for (uint32_t i = 0; i < src->num_columns; ++i)
+	{
+		if (i == removed)
+			continue;
+		shared_values[num_types] = src->columns[i].shared_value;
+		types[num_types++] = src->columns[i].type;
+	}
+
+	uint32_t removed_value = src->columns[removed].shared_value;
+	ecs_archetype_move(ecs, eid, ecs_archetype_find_or_create(ecs, types, num_types, shared_values));
+	if (removed_value != UINT32_MAX)
+		ecs_shared_release(ecs, ctid, removed_value, 1);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_entity_set_shared_component(ecs_t* ecs, entity_id_t eid, const component_data_t* component_data)
+{
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+	ASSERT(ecs->component_descs[component_data->type.id].shared, "Component type is not shared");
+
+	const ecs_table_t* src = &ecs->tables[ecs->records[ecs_entity_index(eid)].table];
+	uint32_t column = ecs_table_find_column(src, component_data->type);
+	if (column == UINT32_MAX)
+		return ECS_RESULT_NO_SUCH_COMPONENT;
+
+	uint32_t old_value = src->columns[column].shared_value;
+	uint32_t new_value = ecs_shared_acquire(ecs, component_data->type, component_data->data, 1);
+	if (new_value != old_value)
+	{
+		component_type_id_t types[ECS_MAX_COMPONENTS_PER_ENTITY];
+		uint32_t shared_values[ECS_MAX_COMPONENTS_PER_ENTITY];
+		for (uint32_t i = 0; i < src->num_columns; ++i)
+		{
+			types[i] = src->columns[i].type;
+			shared_values[i] = src->columns[i].shared_value;
+		}
+		shared_values[column] = new_value;
+		ecs_archetype_move(ecs, eid, ecs_archetype_find_or_create(ecs, types, src->num_columns, shared_values));
+		ecs_observe(ecs, component_data->type, ecs_entity_index(eid), ECS_OBSERVE_CHANGED);
+	}
+	ecs_shared_release(ecs, component_data->type, old_value, 1);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_singleton_set(ecs_t* ecs, component_type_id_t ctid, const void* data)
+{
+	component_desc_t* desc = &ecs->component_descs[ctid.id];
+	if (desc->singleton == nullptr)
+		desc->singleton = (uint8_t*)ALLOCATOR_ALLOC(ecs->allocator, desc->component_size, 16);
+	memcpy(desc->singleton, data, desc->component_size);
+	return ECS_RESULT_OK;
+}
+
+void* ecs_singleton_get(ecs_t* ecs, component_type_id_t ctid)
+{
+	return ecs->component_descs[ctid.id].singleton;
+}
+
+static bool ecs_find_component(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid, ecs_table_t** out_table, uint32_t* out_row, uint32_t* out_column)
+{
+	uint32_t index = ecs_entity_index(eid);
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		*out_table = &ecs->tables[ecs->records[index].table];
+		*out_row = ecs->records[index].row;
+		*out_column = ecs_table_find_column(*out_table, ctid);
+		return *out_column != UINT32_MAX;
+	}
+
 	component_desc_t* desc = &ecs->component_descs[ctid.id];
-	uint32_t index = ecs_find_eid_in_arr(desc->eids, desc->count, eid);
-	if (index == UINT32_MAX)
+	*out_table = &ecs->tables[desc->table];
+	*out_row = desc->rows[index];
+	*out_column = 0;
+	return *out_row != UINT32_MAX;
+}
+
+ecs_result_t ecs_query_component(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid, query_result_t* out_result)
+{
+	ecs_table_t* table;
+	uint32_t row;
+	uint32_t column;
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+	if (ecs->component_descs[ctid.id].tag)
+	{
+		memset(out_result, 0, sizeof(query_result_t));
+		return ecs_signature_test(&ecs->signatures[ecs_entity_index(eid)], ctid) ? ECS_RESULT_OK : ECS_RESULT_NO_SUCH_COMPONENT;
+	}
+	if (!ecs_find_component(ecs, eid, ctid, &table, &row, &column))
 		return ECS_RESULT_NO_SUCH_COMPONENT;
 
-	out_result->component_size = desc->component_size;
-	out_result->component_data = desc->component_data + desc->component_size * index;
+	const ecs_column_t* col = &table->columns[column];
+	out_result->component_size = ecs->component_descs[ctid.id].component_size;
+	out_result->component_data = col->shared_value != UINT32_MAX ? ecs_shared_get(ecs, ctid, col->shared_value) : ecs_table_get(table, row, column);
+	out_result->field_stride = table->columns[column].field_stride;
 	return ECS_RESULT_OK;
 }
 
-ecs_result_t ecs_query_all_components(ecs_t* ecs, component_type_id_t ctid, query_all_result_t* out_result)
+ecs_result_t ecs_component_mark_changed(ecs_t* ecs, entity_id_t eid, component_type_id_t ctid)
 {
+	ecs_table_t* table;
+	uint32_t row;
+	uint32_t column;
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+	if (!ecs_signature_test(&ecs->signatures[ecs_entity_index(eid)], ctid))
+		return ECS_RESULT_NO_SUCH_COMPONENT;
+	ecs_observe(ecs, ctid, ecs_entity_index(eid), ECS_OBSERVE_CHANGED);
+	if (ecs->component_descs[ctid.id].tag)
+		return ECS_RESULT_OK;
+	ecs_find_component(ecs, eid, ctid, &table, &row, &column);
+
+	*ecs_table_version(table, row, column) = ++ecs->version;
+	return ECS_RESULT_OK;
+}
+
+uint64_t ecs_get_version(ecs_t* ecs)
+{
+	return ecs->version;
+}
+
+ecs_result_t ecs_query_all_components(ecs_t* ecs, component_type_id_t ctid, uint32_t page, query_all_result_t* out_result)
+{
+	ASSERT(ecs->storage == ECS_STORAGE_ARRAYS, "Querying all components is only supported for array storage");
+
 	// TODO: allow for better filtering
 	component_desc_t* desc = &ecs->component_descs[ctid.id];
-	out_result->count = desc->count;
+	ASSERT(!desc->tag, "Tags have no components");
+	ecs_table_t* table = &ecs->tables[desc->table];
+	uint32_t first = page * table->rows_per_chunk;
+	uint8_t* chunk = first < table->count ? table->chunks[page] : nullptr;
+	out_result->num_pages = (table->count + table->rows_per_chunk - 1) / table->rows_per_chunk;
+	out_result->count = chunk ? (table->count - first < table->rows_per_chunk ? table->count - first : table->rows_per_chunk) : 0;
 	out_result->component_size = desc->component_size;
-	out_result->component_data = desc->component_data;
-	out_result->eids = desc->eids;
+	out_result->component_data = chunk ? chunk + table->columns[0].offset : nullptr;
+	out_result->field_stride = table->columns[0].field_stride;
+	out_result->eids = (entity_id_t*)chunk;
 	return ECS_RESULT_OK;
-}
\ No newline at end of file
+}
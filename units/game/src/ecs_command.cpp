@@ -0,0 +1,184 @@
+#include "ecs_private.h"
+
+#include <foundation/defines.h>
+
+#include <cstring>
+
+static void ecs_command_stream_reserve(ecs_t* ecs, ecs_command_stream_t* stream)
+{
+	// Used ids became entities on playback, the rest are still reserved
+	for (uint32_t i = 0; i < stream->num_reserved_used; ++i)
+		stream->reserved_eids[i] = ecs_entity_reserve(ecs);
+	stream->num_reserved_used = 0;
+}
+
+static ecs_command_t* ecs_command_alloc(ecs_command_buffer_t* buffer, uint32_t worker, uint32_t type, entity_id_t eid, uint32_t arg, uint32_t data_size)
+{
+	ASSERT(worker < buffer->num_streams, "Worker index out of range");
+	ecs_command_stream_t* stream = &buffer->streams[worker];
+
+	uint32_t size = (uint32_t)ALIGN_UP(sizeof(ecs_command_t) + data_size, 16);
+	ecs_command_t* command = (ecs_command_t*)ALLOCATOR_ALLOC(stream->arena, size, 16);
+	command->type = type;
+	command->size = size;
+	command->eid = eid;
+	command->arg = arg;
+	++stream->num_commands;
+	return command;
+}
+
+ecs_result_t ecs_command_buffer_create(ecs_t* ecs, const ecs_command_buffer_create_info_t* create_info, ecs_command_buffer_t** out_buffer)
+{
+	ASSERT(create_info->num_workers > 0);
+
+	ecs_command_buffer_t* buffer = ALLOCATOR_ALLOC_TYPE(ecs->allocator, ecs_command_buffer_t);
+	memset(buffer, 0, sizeof(ecs_command_buffer_t));
+	buffer->ecs = ecs;
+	buffer->num_streams = create_info->num_workers;
+	buffer->max_creates = create_info->max_creates;
+	buffer->streams = (ecs_command_stream_t*)ALLOCATOR_ALLOC(ecs->allocator, create_info->num_workers * sizeof(ecs_command_stream_t), CACHE_LINE_SIZE);
+	memset(buffer->streams, 0, create_info->num_workers * sizeof(ecs_command_stream_t));
+
+	for (uint32_t i = 0; i < buffer->num_streams; ++i)
+	{
+		ecs_command_stream_t* stream = &buffer->streams[i];
+		stream->arena = allocator_incheap_create(ecs->allocator, create_info->arena_size);
+		stream->reserved_eids = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, create_info->max_creates ? create_info->max_creates : 1, entity_id_t);
+		stream->num_reserved_used = create_info->max_creates;
+		ecs_command_stream_reserve(ecs, stream);
+	}
+
+	*out_buffer = buffer;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_command_buffer_destroy(ecs_t* ecs, ecs_command_buffer_t* buffer)
+{
+	for (uint32_t i = 0; i < buffer->num_streams; ++i)
+	{
+		ecs_command_stream_t* stream = &buffer->streams[i];
+		ASSERT(stream->num_commands == 0, "Destroying a command buffer that was not played back");
+		for (uint32_t j = stream->num_reserved_used; j < buffer->max_creates; ++j)
+			ecs_entity_free(ecs, stream->reserved_eids[j]);
+		ALLOCATOR_FREE(ecs->allocator, stream->reserved_eids);
+		allocator_incheap_destroy(stream->arena);
+	}
+	ALLOCATOR_FREE(ecs->allocator, buffer->streams);
+	ALLOCATOR_FREE(ecs->allocator, buffer);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_command_create_entity(ecs_command_buffer_t* buffer, uint32_t worker, const entity_create_info_t* create_info, entity_id_t* out_eid)
+{
+	ASSERT(worker < buffer->num_streams, "Worker index out of range");
+	ecs_command_stream_t* stream = &buffer->streams[worker];
+	ASSERT(stream->num_reserved_used < buffer->max_creates, "Out of reserved entities");
+	entity_id_t eid = stream->reserved_eids[stream->num_reserved_used++];
+
+	// Each component is a type and size header followed by the data, both padded to 16 bytes
+	const ecs_t* ecs = buffer->ecs;
+	uint32_t data_size = 0;
+	for (uint32_t i = 0; i < create_info->num_components; ++i)
+		data_size += 16 + (uint32_t)ALIGN_UP(ecs->component_descs[create_info->component_datas[i].type.id].component_size, 16);
+
+	ecs_command_t* command = ecs_command_alloc(buffer, worker, ECS_COMMAND_CREATE_ENTITY, eid, create_info->num_components, data_size);
+	uint8_t* data = (uint8_t*)(command + 1);
+	for (uint32_t i = 0; i < create_info->num_components; ++i)
+	{
+		const component_data_t* component_data = &create_info->component_datas[i];
+		uint32_t size = ecs->component_descs[component_data->type.id].component_size;
+		((uint32_t*)data)[0] = component_data->type.id;
+		((uint32_t*)data)[1] = size;
+		if (size)
+			memcpy(data + 16, component_data->data, size);
+		data += 16 + ALIGN_UP(size, 16);
+	}
+
+	*out_eid = eid;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_command_destroy_entity(ecs_command_buffer_t* buffer, uint32_t worker, entity_id_t eid)
+{
+	ecs_command_alloc(buffer, worker, ECS_COMMAND_DESTROY_ENTITY, eid, 0, 0);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_command_add_component(ecs_command_buffer_t* buffer, uint32_t worker, entity_id_t eid, const component_data_t* component_data)
+{
+	uint32_t size = buffer->ecs->component_descs[component_data->type.id].component_size;
+	ecs_command_t* command = ecs_command_alloc(buffer, worker, ECS_COMMAND_ADD_COMPONENT, eid, component_data->type.id, size);
+	if (size)
+		memcpy(command + 1, component_data->data, size);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_command_remove_component(ecs_command_buffer_t* buffer, uint32_t worker, entity_id_t eid, component_type_id_t ctid)
+{
+	ecs_command_alloc(buffer, worker, ECS_COMMAND_REMOVE_COMPONENT, eid, ctid.id, 0);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_command_buffer_playback(ecs_t* ecs, ecs_command_buffer_t* buffer)
+{
+	ASSERT(buffer->ecs == ecs);
+
+	for (uint32_t i = 0; i < buffer->num_streams; ++i)
+	{
+		ecs_command_stream_t* stream = &buffer->streams[i];
+		const uint8_t* ptr = (const uint8_t*)ALIGN_UP(allocator_incheap_start(stream->arena), 16);
+		for (uint32_t c = 0; c < stream->num_commands; ++c)
+		{
+			const ecs_command_t* command = (const ecs_command_t*)ptr;
+			const uint8_t* data = (const uint8_t*)(command + 1);
+			switch (command->type)
+			{
+			case ECS_COMMAND_CREATE_ENTITY:
+			{
+				component_data_t component_datas[ECS_MAX_COMPONENTS_PER_ENTITY];
+				ASSERT(command->arg <= ECS_MAX_COMPONENTS_PER_ENTITY, "Too many components");
+				for (uint32_t j = 0; j < command->arg; ++j)
+				{
+					component_datas[j].type.id = ((const uint32_t*)data)[0];
+					component_datas[j].data = data + 16;
+					data += 16 + ALIGN_UP(((const uint32_t*)data)[1], 16);
+				}
+
+				entity_create_info_t create_info;
+				create_info.num_components = command->arg;
+				create_info.component_datas = component_datas;
+				ecs_entities_insert(ecs, &create_info, 1, &command->eid);
+				ecs_entity_publish(ecs, command->eid);
+				break;
+			}
+			case ECS_COMMAND_DESTROY_ENTITY:
+				ecs_entity_destroy(ecs, command->eid);
+				break;
+			case ECS_COMMAND_ADD_COMPONENT:
+			{
+				component_data_t component_data;
+				component_data.type.id = command->arg;
+				component_data.data = data;
+				ecs_entity_add_component(ecs, command->eid, &component_data);
+				break;
+			}
+			case ECS_COMMAND_REMOVE_COMPONENT:
+			{
+				component_type_id_t ctid;
+				ctid.id = command->arg;
+				ecs_entity_remove_component(ecs, command->eid, ctid);
+				break;
+			}
+			default:
+				ASSERT(0, "Unknown command %u", command->type);
+			}
+			ptr += command->size;
+		}
+
+		stream->num_commands = 0;
+		allocator_incheap_reset(stream->arena);
+		ecs_command_stream_reserve(ecs, stream);
+	}
+
+	return ECS_RESULT_OK;
+}
@@ -0,0 +1,227 @@
+#include "ecs_private.h"
+
+#include <algorithm>
+#include <cstring>
+
+static void ecs_defrag_swap_bytes(uint8_t* a, uint8_t* b, uint32_t size)
+{
+	uint8_t tmp[64];
+	while (size > 0)
+	{
+		uint32_t n = size < sizeof(tmp) ? size : (uint32_t)sizeof(tmp);
+		memcpy(tmp, a, n);
+		memcpy(a, b, n);
+		memcpy(b, tmp, n);
+		a += n;
+		b += n;
+		size -= n;
+	}
+}
+
+static void ecs_defrag_swap_rows(ecs_t* ecs, ecs_table_t* table, uint32_t a, uint32_t b)
+{
+	ecs_defrag_swap_bytes((uint8_t*)ecs_table_eid(table, a), (uint8_t*)ecs_table_eid(table, b), sizeof(entity_id_t));
+	for (uint32_t c = 0; c < table->num_columns; ++c)
+	{
+		const ecs_column_t* col = &table->columns[c];
+		uint8_t* pa = ecs_table_get(table, a, c);
+		uint8_t* pb = ecs_table_get(table, b, c);
+		for (uint32_t f = 0; f < col->num_fields; ++f)
+			ecs_defrag_swap_bytes(pa + f * col->field_stride, pb + f * col->field_stride, col->field_size);
+	}
+	ecs_table_mark_rows(ecs, table, a, 1);
+	ecs_table_mark_rows(ecs, table, b, 1);
+}
+
+/**
+ * Row of the entity in the table being sorted, UINT32_MAX when it is not in there anymore.
+ */
+static uint32_t ecs_defrag_find_row(ecs_t* ecs, entity_id_t eid)
+{
+	if (!ecs_entity_alive(ecs, eid))
+		return UINT32_MAX;
+	uint32_t index = ecs_entity_index(eid);
+	if (ecs->storage == ECS_STORAGE_ARRAYS)
+		return ecs->component_descs[ecs->tables[ecs->defrag_table].columns[0].type.id].rows[index];
+	const ecs_record_t* record = &ecs->records[index];
+	return record->table == ecs->defrag_table ? record->row : UINT32_MAX;
+}
+
+static void ecs_defrag_set_row(ecs_t* ecs, entity_id_t eid, uint32_t row)
+{
+	uint32_t index = ecs_entity_index(eid);
+	if (ecs->storage == ECS_STORAGE_ARRAYS)
+		ecs->component_descs[ecs->tables[ecs->defrag_table].columns[0].type.id].rows[index] = row;
+	else
+		ecs->records[index].row = row;
+}
+
+static bool ecs_defrag_entry_less(const ecs_defrag_entry_t& a, const ecs_defrag_entry_t& b)
+{
+	return a.key != b.key ? a.key < b.key : ecs_entity_index(a.eid) < ecs_entity_index(b.eid);
+}
+
+static const uint32_t ECS_DEFRAG_RUN_LENGTH = 64; // Rows sorted at once while collecting keys, the runs are merged after
+
+/**
+ * Collects keys from defrag_row on, one row per row of budget, and sorts every run as it fills up.
+ */
+static void ecs_defrag_collect(ecs_t* ecs, ecs_table_t* table, const ecs_defrag_info_t* info, int64_t* budget)
+{
+	array_t<ecs_defrag_entry_t>* order = &ecs->defrag_order;
+	for (; *budget > 0 && ecs->defrag_row < order->length(); --*budget)
+	{
+		uint32_t row = ecs->defrag_row++;
+		ecs_defrag_entry_t* entry = &(*order)[row];
+		entry->eid = *ecs_table_eid(table, row);
+		entry->key = info->key_func ? info->key_func(ecs, entry->eid, info->user_data) : ecs_entity_index(entry->eid);
+		if (ecs->defrag_row % ECS_DEFRAG_RUN_LENGTH != 0 && ecs->defrag_row != order->length())
+			continue;
+
+		// The previous run is only untouched by its sort when everything so far was in order
+		ecs_defrag_entry_t* first = order->begin() + (row - row % ECS_DEFRAG_RUN_LENGTH);
+		ecs_defrag_entry_t* last = order->begin() + ecs->defrag_row;
+		bool run_sorted = std::is_sorted(first, last, ecs_defrag_entry_less);
+		ecs->defrag_sorted = ecs->defrag_sorted && run_sorted && (first == order->begin() || !ecs_defrag_entry_less(*first, first[-1]));
+		if (!run_sorted)
+			std::sort(first, last, ecs_defrag_entry_less);
+	}
+}
+
+/**
+ * Merges pairs of sorted runs of defrag_width from defrag_order into defrag_merge, one entry per row of budget,
+ * and swaps the two after each pass. Returns true once the whole order is one sorted run.
+ */
+static bool ecs_defrag_merge(ecs_t* ecs, int64_t* budget)
+{
+	uint32_t count = (uint32_t)ecs->defrag_order.length();
+	uint32_t width = ecs->defrag_width;
+	uint32_t out = ecs->defrag_row;
+	uint32_t left = ecs->defrag_left;
+	uint32_t right = ecs->defrag_right;
+	while (width < count && *budget > 0)
+	{
+		const ecs_defrag_entry_t* src = ecs->defrag_order.begin();
+		ecs_defrag_entry_t* dst = ecs->defrag_merge.begin();
+		uint32_t begin = out - out % (2 * width);
+		uint32_t mid = begin + width < count ? begin + width : count;
+		uint32_t end = mid + width < count ? mid + width : count;
+		if (out == begin)
+		{
+			left = begin;
+			right = mid;
+		}
+		for (; *budget > 0 && out < end; --*budget, ++out)
+		{
+			bool take_right = left == mid || (right < end && ecs_defrag_entry_less(src[right], src[left]));
+			dst[out] = take_right ? src[right++] : src[left++];
+		}
+
+		if (out == count)
+		{
+			std::swap(ecs->defrag_order, ecs->defrag_merge);
+			width *= 2;
+			out = 0;
+		}
+	}
+	ecs->defrag_width = width;
+	ecs->defrag_row = out;
+	ecs->defrag_left = left;
+	ecs->defrag_right = right;
+	return width >= count;
+}
+
+ecs_result_t ecs_defragment(ecs_t* ecs, const ecs_defrag_info_t* info, bool* out_done)
+{
+	*out_done = false;
+	int64_t budget = info->max_rows;
+	while (budget > 0)
+	{
+		if (ecs->defrag_table >= ecs->tables.length())
+		{
+			// A round without moves means everything is in order
+			ecs->defrag_table = 0;
+			bool done = ecs->defrag_moves == 0;
+			ecs->defrag_moves = 0;
+			if (done)
+			{
+				*out_done = true;
+				break;
+			}
+		}
+
+		ecs_table_t* table = &ecs->tables[ecs->defrag_table];
+		array_t<ecs_defrag_entry_t>* order = &ecs->defrag_order;
+		if (ecs->defrag_phase == ECS_DEFRAG_PHASE_KEYS && ecs->defrag_row == 0)
+		{
+			// Rows of the empty archetype have nothing to keep together
+			if (table->num_columns == 0 || table->count < 2)
+			{
+				++ecs->defrag_table;
+				continue;
+			}
+			order->ensure_capacity(ecs->allocator, table->count);
+			order->set_length(table->count);
+			ecs->defrag_sorted = true;
+		}
+
+		// Entities created, destroyed or moved in between calls make the order stale, the next round picks them up
+		bool stale = order->length() != table->count;
+		if (!stale && ecs->defrag_phase == ECS_DEFRAG_PHASE_KEYS)
+		{
+			ecs_defrag_collect(ecs, table, info, &budget);
+			if (ecs->defrag_row < order->length())
+				continue;
+			if (ecs->defrag_sorted)
+			{
+				ecs->defrag_row = 0;
+				++ecs->defrag_table;
+				continue;
+			}
+			ecs->defrag_merge.ensure_capacity(ecs->allocator, order->length());
+			ecs->defrag_merge.set_length(order->length());
+			ecs->defrag_phase = ECS_DEFRAG_PHASE_MERGE;
+			ecs->defrag_width = ECS_DEFRAG_RUN_LENGTH;
+			ecs->defrag_row = 0;
+		}
+
+		if (!stale && ecs->defrag_phase == ECS_DEFRAG_PHASE_MERGE)
+		{
+			if (!ecs_defrag_merge(ecs, &budget))
+				continue;
+			ecs->defrag_phase = ECS_DEFRAG_PHASE_PLACE;
+			ecs->defrag_row = 0;
+		}
+
+		for (; !stale && budget > 0 && ecs->defrag_row < order->length(); --budget)
+		{
+			uint32_t row = ecs->defrag_row;
+			entity_id_t eid = (*order)[row].eid;
+			uint32_t current = ecs_defrag_find_row(ecs, eid);
+			if (current == UINT32_MAX || current < row || current >= table->count)
+			{
+				stale = true;
+				break;
+			}
+			if (current != row)
+			{
+				entity_id_t other = *ecs_table_eid(table, row);
+				ecs_defrag_swap_rows(ecs, table, row, current);
+				ecs_defrag_set_row(ecs, eid, row);
+				ecs_defrag_set_row(ecs, other, current);
+				++ecs->defrag_moves;
+			}
+			++ecs->defrag_row;
+		}
+
+		if (stale || ecs->defrag_row >= order->length())
+		{
+			ecs->defrag_moves += stale ? 1 : 0;
+			ecs->defrag_phase = ECS_DEFRAG_PHASE_KEYS;
+			ecs->defrag_row = 0;
+			++ecs->defrag_table;
+		}
+	}
+
+	return ECS_RESULT_OK;
+}
@@ -0,0 +1,453 @@
+#include "ecs_private.h"
+
+#include <foundation/job_system.h>
+#include <foundation/simd_math.h>
+
+#include <cstring>
+
+#define ECS_HIERARCHY_DEFAULT_BATCH_SIZE (256)
+#define ECS_HIERARCHY_RUN_SIZE (32) // Nodes composed and multiplied at a time
+
+struct ecs_hierarchy_node_t
+{
+	entity_id_t eid;
+	uint32_t parent;
+	float local[TRANSFORM_NUM_FIELDS];
+	float world[16];
+	uint8_t dirty;
+};
+
+static void ecs_hierarchy_read(const ecs_hierarchy_t* hierarchy, uint32_t node, ecs_hierarchy_node_t* out_node)
+{
+	out_node->eid = hierarchy->eids[node];
+	out_node->parent = hierarchy->parents[node];
+	for (uint32_t f = 0; f < TRANSFORM_NUM_FIELDS; ++f)
+		out_node->local[f] = hierarchy->local_fields[f * hierarchy->max_nodes + node];
+	memcpy(out_node->world, hierarchy->worlds + node * 16, sizeof(out_node->world));
+	out_node->dirty = hierarchy->dirty[node];
+}
+
+static void ecs_hierarchy_write(ecs_hierarchy_t* hierarchy, uint32_t node, const ecs_hierarchy_node_t* in_node)
+{
+	hierarchy->eids[node] = in_node->eid;
+	hierarchy->parents[node] = in_node->parent;
+	for (uint32_t f = 0; f < TRANSFORM_NUM_FIELDS; ++f)
+		hierarchy->local_fields[f * hierarchy->max_nodes + node] = in_node->local[f];
+	memcpy(hierarchy->worlds + node * 16, in_node->world, sizeof(in_node->world));
+	hierarchy->dirty[node] = in_node->dirty;
+	hierarchy->nodes[ecs_entity_index(in_node->eid)] = node;
+}
+
+static void ecs_hierarchy_move(ecs_hierarchy_t* hierarchy, uint32_t from, uint32_t to)
+{
+	ecs_hierarchy_node_t node;
+	ecs_hierarchy_read(hierarchy, from, &node);
+	ecs_hierarchy_write(hierarchy, to, &node);
+}
+
+static uint32_t ecs_hierarchy_depth(const ecs_hierarchy_t* hierarchy, uint32_t node)
+{
+	uint32_t depth = 0;
+	while (node >= hierarchy->level_start[depth + 1])
+		++depth;
+	return depth;
+}
+
+static void ecs_hierarchy_mark_dirty(ecs_hierarchy_t* hierarchy, uint32_t node, uint32_t depth)
+{
+	hierarchy->dirty[node] = 1;
+	if (depth < hierarchy->first_dirty_level)
+		hierarchy->first_dirty_level = depth;
+}
+
+/**
+ * Makes room for a node at the end of a depth by moving the first node of
+ * every deeper level to the end of that level. Returns the free node.
+ */
+static uint32_t ecs_hierarchy_insert(ecs_hierarchy_t* hierarchy, uint32_t depth)
+{
+	uint32_t* start = hierarchy->level_start;
+	uint32_t hole = start[ECS_HIERARCHY_MAX_DEPTH];
+	for (uint32_t level = ECS_HIERARCHY_MAX_DEPTH - 1; level > depth; --level)
+	{
+		if (start[level] < start[level + 1])
+			ecs_hierarchy_move(hierarchy, start[level], hole);
+		hole = start[level];
+	}
+	for (uint32_t level = depth + 1; level <= ECS_HIERARCHY_MAX_DEPTH; ++level)
+		++start[level];
+	if (depth >= hierarchy->num_levels)
+		hierarchy->num_levels = depth + 1;
+	return hole;
+}
+
+/**
+ * Fills the hole left by a node with the last node of its depth and then
+ * moves the last node of every deeper level down into the hole before it.
+ */
+static void ecs_hierarchy_erase(ecs_hierarchy_t* hierarchy, uint32_t node)
+{
+	uint32_t* start = hierarchy->level_start;
+	uint32_t depth = ecs_hierarchy_depth(hierarchy, node);
+	hierarchy->nodes[ecs_entity_index(hierarchy->eids[node])] = UINT32_MAX;
+
+	uint32_t hole = start[depth + 1] - 1;
+	if (node != hole)
+		ecs_hierarchy_move(hierarchy, hole, node);
+	for (uint32_t level = depth + 1; level < ECS_HIERARCHY_MAX_DEPTH; ++level)
+	{
+		if (start[level] < start[level + 1])
+		{
+			ecs_hierarchy_move(hierarchy, start[level + 1] - 1, hole);
+			hole = start[level + 1] - 1;
+		}
+	}
+	for (uint32_t level = depth + 1; level <= ECS_HIERARCHY_MAX_DEPTH; ++level)
+		--start[level];
+	while (hierarchy->num_levels > 0 && start[hierarchy->num_levels - 1] == start[hierarchy->num_levels])
+		--hierarchy->num_levels;
+}
+
+static bool ecs_hierarchy_needs_update(const ecs_hierarchy_t* hierarchy, uint32_t node, bool root)
+{
+	return hierarchy->dirty[node] || (!root && hierarchy->dirty[hierarchy->nodes[hierarchy->parents[node]]]);
+}
+
+/**
+ * world = parent world * local for every node in the range that changed or
+ * has a recomputed parent, in runs of consecutive nodes.
+ */
+static void ecs_hierarchy_update_range(ecs_hierarchy_t* hierarchy, uint32_t begin, uint32_t end, bool root)
+{
+	float parent_worlds[ECS_HIERARCHY_RUN_SIZE * 16];
+	uint32_t node = begin;
+	while (node < end)
+	{
+		if (!ecs_hierarchy_needs_update(hierarchy, node, root))
+		{
+			++node;
+			continue;
+		}
+
+		uint32_t first = node;
+		while (node < end && node - first < ECS_HIERARCHY_RUN_SIZE && ecs_hierarchy_needs_update(hierarchy, node, root))
+			hierarchy->dirty[node++] = 1;
+		uint32_t count = node - first;
+
+		float* worlds = hierarchy->worlds + first * 16;
+		transform_soa_t local = transform_soa_from_fields(hierarchy->local_fields + first, hierarchy->max_nodes * sizeof(float));
+		simd_transform_compose(&local, count, worlds);
+		if (!root)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				memcpy(parent_worlds + i * 16, hierarchy->worlds + hierarchy->nodes[hierarchy->parents[first + i]] * 16, 16 * sizeof(float));
+			simd_mat4_mul(parent_worlds, worlds, worlds, count);
+		}
+	}
+}
+
+static void ecs_hierarchy_job(job_context_t* context, void* arg)
+{
+	ecs_hierarchy_job_arg_t* job_arg = (ecs_hierarchy_job_arg_t*)arg;
+	ecs_hierarchy_update_range(job_arg->hierarchy, job_arg->begin, job_arg->end, job_arg->root);
+}
+
+/**
+ * Node of the entity, UINT32_MAX if it has none. A node left behind by a destroyed
+ * entity whose index has been reused holds another generation and is not returned.
+ */
+static uint32_t ecs_hierarchy_node(const ecs_hierarchy_t* hierarchy, entity_id_t eid)
+{
+	uint32_t node = hierarchy->nodes[ecs_entity_index(eid)];
+	return node != UINT32_MAX && hierarchy->eids[node].id == eid.id ? node : UINT32_MAX;
+}
+
+static ecs_result_t ecs_hierarchy_find(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, uint32_t* out_node)
+{
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+	*out_node = ecs_hierarchy_node(hierarchy, eid);
+	return *out_node != UINT32_MAX ? ECS_RESULT_OK : ECS_RESULT_NO_SUCH_COMPONENT;
+}
+
+/**
+ * Moves the node and everything below it under the parent entity index, UINT32_MAX for none.
+ */
+static void ecs_hierarchy_move_subtree(ecs_t* ecs, ecs_hierarchy_t* hierarchy, uint32_t node, uint32_t parent_index, uint32_t new_depth)
+{
+	uint32_t depth = ecs_hierarchy_depth(hierarchy, node);
+	hierarchy->parents[node] = parent_index;
+	if (depth == new_depth)
+	{
+		ecs_hierarchy_mark_dirty(hierarchy, node, depth);
+		return;
+	}
+
+	// Collect the subtree level by level, marked parents have their children marked
+	hierarchy->dirty[node] = 1;
+	hierarchy->scratch.clear();
+	ecs_array_push(ecs->allocator, &hierarchy->scratch, hierarchy->eids[node].id);
+	hierarchy->marks[node] = 1;
+	for (uint32_t level = depth + 1; level < hierarchy->num_levels; ++level)
+	{
+		for (uint32_t child = hierarchy->level_start[level]; child < hierarchy->level_start[level + 1]; ++child)
+		{
+			if (hierarchy->marks[hierarchy->nodes[hierarchy->parents[child]]])
+			{
+				hierarchy->marks[child] = 1;
+				ecs_array_push(ecs->allocator, &hierarchy->scratch, hierarchy->eids[child].id);
+			}
+		}
+	}
+	for (uint32_t i = 0; i < hierarchy->scratch.length(); ++i)
+	{
+		entity_id_t moved = { hierarchy->scratch[i] };
+		hierarchy->marks[hierarchy->nodes[ecs_entity_index(moved)]] = 0;
+	}
+
+	// Parents are moved before their children, so each child lands one level below its parent's new depth
+	for (uint32_t i = 0; i < hierarchy->scratch.length(); ++i)
+	{
+		entity_id_t moved = { hierarchy->scratch[i] };
+		ecs_hierarchy_node_t data;
+		ecs_hierarchy_read(hierarchy, hierarchy->nodes[ecs_entity_index(moved)], &data);
+		uint32_t moved_depth = data.parent != UINT32_MAX ? ecs_hierarchy_depth(hierarchy, hierarchy->nodes[data.parent]) + 1 : 0;
+		ASSERT(moved_depth < ECS_HIERARCHY_MAX_DEPTH, "Hierarchy too deep");
+
+		ecs_hierarchy_erase(hierarchy, hierarchy->nodes[ecs_entity_index(moved)]);
+		uint32_t index = ecs_hierarchy_insert(hierarchy, moved_depth);
+		ecs_hierarchy_write(hierarchy, index, &data);
+		if (data.dirty)
+			ecs_hierarchy_mark_dirty(hierarchy, index, moved_depth);
+	}
+}
+
+/**
+ * Erases the node, its children become roots. Works on nodes of destroyed entities too.
+ */
+static void ecs_hierarchy_remove_node(ecs_t* ecs, ecs_hierarchy_t* hierarchy, uint32_t node)
+{
+	// Children are found before anything moves, they are looked up again by id when reparenting
+	entity_id_t eid = hierarchy->eids[node];
+	uint32_t depth = ecs_hierarchy_depth(hierarchy, node);
+	uint32_t index = ecs_entity_index(eid);
+	hierarchy->children.clear();
+	for (uint32_t child = hierarchy->level_start[depth + 1]; depth + 1 < ECS_HIERARCHY_MAX_DEPTH && child < hierarchy->level_start[depth + 2]; ++child)
+	{
+		if (hierarchy->parents[child] == index)
+			ecs_array_push(ecs->allocator, &hierarchy->children, hierarchy->eids[child].id);
+	}
+
+	for (uint32_t i = 0; i < hierarchy->children.length(); ++i)
+	{
+		entity_id_t child = { hierarchy->children[i] };
+		ecs_hierarchy_move_subtree(ecs, hierarchy, hierarchy->nodes[ecs_entity_index(child)], UINT32_MAX, 0);
+	}
+
+	ecs_hierarchy_erase(hierarchy, hierarchy->nodes[index]);
+}
+
+ecs_result_t ecs_hierarchy_create(ecs_t* ecs, const ecs_hierarchy_create_info_t* create_info, ecs_hierarchy_t** out_hierarchy)
+{
+	ASSERT(create_info->max_nodes > 0);
+
+	uint32_t max_nodes = create_info->max_nodes;
+	ecs_hierarchy_t* hierarchy = ALLOCATOR_ALLOC_TYPE(ecs->allocator, ecs_hierarchy_t);
+	memset(hierarchy, 0, sizeof(ecs_hierarchy_t));
+	hierarchy->max_nodes = max_nodes;
+	hierarchy->batch_size = create_info->batch_size ? create_info->batch_size : ECS_HIERARCHY_DEFAULT_BATCH_SIZE;
+	hierarchy->first_dirty_level = ECS_HIERARCHY_MAX_DEPTH;
+
+	hierarchy->nodes = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, ecs->max_entities, uint32_t);
+	memset(hierarchy->nodes, 0xFF, ecs->max_entities * sizeof(uint32_t));
+	hierarchy->eids = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, max_nodes, entity_id_t);
+	hierarchy->parents = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, max_nodes, uint32_t);
+	hierarchy->local_fields = (float*)ALLOCATOR_ALLOC(ecs->allocator, TRANSFORM_NUM_FIELDS * max_nodes * sizeof(float), 16);
+	hierarchy->worlds = (float*)ALLOCATOR_ALLOC(ecs->allocator, 16 * max_nodes * sizeof(float), 16);
+	hierarchy->dirty = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, max_nodes, uint8_t);
+	hierarchy->marks = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, max_nodes, uint8_t);
+	memset(hierarchy->dirty, 0, max_nodes);
+	memset(hierarchy->marks, 0, max_nodes);
+	hierarchy->scratch.create(ecs->allocator, 0);
+	hierarchy->children.create(ecs->allocator, 0);
+	hierarchy->job_args.create(ecs->allocator, 0);
+
+	*out_hierarchy = hierarchy;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_destroy(ecs_t* ecs, ecs_hierarchy_t* hierarchy)
+{
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->nodes);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->eids);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->parents);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->local_fields);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->worlds);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->dirty);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy->marks);
+	hierarchy->scratch.destroy(ecs->allocator);
+	hierarchy->children.destroy(ecs->allocator);
+	hierarchy->job_args.destroy(ecs->allocator);
+	ALLOCATOR_FREE(ecs->allocator, hierarchy);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_add(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, entity_id_t parent, const transform_t* local)
+{
+	if (!ecs_entity_alive(ecs, eid))
+		return ECS_RESULT_NO_SUCH_ENTITY;
+
+	// A node of an earlier entity with the same index was never removed, it goes before its index is reused
+	uint32_t existing = hierarchy->nodes[ecs_entity_index(eid)];
+	if (existing != UINT32_MAX && hierarchy->eids[existing].id == eid.id)
+		return ECS_RESULT_COMPONENT_EXISTS;
+	if (existing != UINT32_MAX)
+		ecs_hierarchy_remove_node(ecs, hierarchy, existing);
+
+	uint32_t depth = 0;
+	if (parent.id != 0)
+	{
+		uint32_t parent_node;
+		ecs_result_t res = ecs_hierarchy_find(ecs, hierarchy, parent, &parent_node);
+		if (res != ECS_RESULT_OK)
+			return res;
+		depth = ecs_hierarchy_depth(hierarchy, parent_node) + 1;
+	}
+	ASSERT(depth < ECS_HIERARCHY_MAX_DEPTH, "Hierarchy too deep");
+	ASSERT(hierarchy->level_start[ECS_HIERARCHY_MAX_DEPTH] < hierarchy->max_nodes, "Out of hierarchy nodes");
+
+	ecs_hierarchy_node_t node;
+	node.eid = eid;
+	node.parent = parent.id != 0 ? ecs_entity_index(parent) : UINT32_MAX;
+	memcpy(node.local, local, sizeof(node.local));
+	memset(node.world, 0, sizeof(node.world));
+	node.dirty = 1;
+
+	uint32_t index = ecs_hierarchy_insert(hierarchy, depth);
+	ecs_hierarchy_write(hierarchy, index, &node);
+	ecs_hierarchy_mark_dirty(hierarchy, index, depth);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_remove(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid)
+{
+	uint32_t node;
+	ecs_result_t res = ecs_hierarchy_find(ecs, hierarchy, eid, &node);
+	if (res != ECS_RESULT_OK)
+		return res;
+
+	ecs_hierarchy_remove_node(ecs, hierarchy, node);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_set_parent(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, entity_id_t parent)
+{
+	uint32_t node;
+	ecs_result_t res = ecs_hierarchy_find(ecs, hierarchy, eid, &node);
+	if (res != ECS_RESULT_OK)
+		return res;
+
+	uint32_t parent_index = UINT32_MAX;
+	uint32_t new_depth = 0;
+	if (parent.id != 0)
+	{
+		uint32_t parent_node;
+		res = ecs_hierarchy_find(ecs, hierarchy, parent, &parent_node);
+		if (res != ECS_RESULT_OK)
+			return res;
+		parent_index = ecs_entity_index(parent);
+		new_depth = ecs_hierarchy_depth(hierarchy, parent_node) + 1;
+
+		for (uint32_t ancestor = parent_index; ancestor != UINT32_MAX; ancestor = hierarchy->parents[hierarchy->nodes[ancestor]])
+			ASSERT(ancestor != ecs_entity_index(eid), "Parenting an entity to its own descendant");
+	}
+
+	ecs_hierarchy_move_subtree(ecs, hierarchy, node, parent_index, new_depth);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_set_local(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, const transform_t* local)
+{
+	uint32_t node;
+	ecs_result_t res = ecs_hierarchy_find(ecs, hierarchy, eid, &node);
+	if (res != ECS_RESULT_OK)
+		return res;
+
+	const float* fields = (const float*)local;
+	for (uint32_t f = 0; f < TRANSFORM_NUM_FIELDS; ++f)
+		hierarchy->local_fields[f * hierarchy->max_nodes + node] = fields[f];
+	ecs_hierarchy_mark_dirty(hierarchy, node, ecs_hierarchy_depth(hierarchy, node));
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_get_world(ecs_t* ecs, ecs_hierarchy_t* hierarchy, entity_id_t eid, const float** out_matrix)
+{
+	uint32_t node;
+	ecs_result_t res = ecs_hierarchy_find(ecs, hierarchy, eid, &node);
+	if (res != ECS_RESULT_OK)
+		return res;
+
+	*out_matrix = hierarchy->worlds + node * 16;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_hierarchy_update(ecs_t* ecs, ecs_hierarchy_t* hierarchy, job_system_t* job_system)
+{
+	uint32_t first_level = hierarchy->first_dirty_level;
+	if (first_level >= hierarchy->num_levels)
+	{
+		hierarchy->first_dirty_level = ECS_HIERARCHY_MAX_DEPTH;
+		return ECS_RESULT_OK;
+	}
+
+	// Levels above the first dirty one are untouched, everything below may have a changed parent
+	uint32_t num_level_jobs[ECS_HIERARCHY_MAX_DEPTH];
+	hierarchy->job_args.clear();
+	for (uint32_t level = first_level; level < hierarchy->num_levels; ++level)
+	{
+		uint32_t begin = hierarchy->level_start[level];
+		uint32_t end = hierarchy->level_start[level + 1];
+		num_level_jobs[level] = 0;
+		for (uint32_t first = begin; first < end; first += hierarchy->batch_size)
+		{
+			ecs_hierarchy_job_arg_t job_arg;
+			job_arg.hierarchy = hierarchy;
+			job_arg.begin = first;
+			job_arg.end = end - first < hierarchy->batch_size ? end : first + hierarchy->batch_size;
+			job_arg.root = level == 0;
+			ecs_array_push(ecs->allocator, &hierarchy->job_args, job_arg);
+			++num_level_jobs[level];
+		}
+	}
+
+	if (job_system)
+	{
+		// Each level waits for the one above it
+		job_event_t* events[ECS_HIERARCHY_MAX_DEPTH];
+		job_event_t* depends = nullptr;
+		ecs_hierarchy_job_arg_t* job_args = hierarchy->job_args.begin();
+		for (uint32_t level = first_level; level < hierarchy->num_levels; ++level)
+		{
+			job_system_acquire_event(job_system, &events[level]);
+			job_system_result_t res = job_system_kick_ptr(job_system, ecs_hierarchy_job, num_level_jobs[level], job_args, depends, events[level]);
+			ASSERT(res == JOB_SYSTEM_OK);
+			(void)res;
+			job_args += num_level_jobs[level];
+			depends = events[level];
+		}
+
+		job_system_wait_event(job_system, depends);
+		for (uint32_t level = first_level; level < hierarchy->num_levels; ++level)
+			job_system_release_event(job_system, events[level]);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < hierarchy->job_args.length(); ++i)
+			ecs_hierarchy_job(nullptr, &hierarchy->job_args[i]);
+	}
+
+	uint32_t begin = hierarchy->level_start[first_level];
+	memset(hierarchy->dirty + begin, 0, hierarchy->level_start[ECS_HIERARCHY_MAX_DEPTH] - begin);
+	hierarchy->first_dirty_level = ECS_HIERARCHY_MAX_DEPTH;
+	return ECS_RESULT_OK;
+}
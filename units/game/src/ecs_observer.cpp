@@ -0,0 +1,136 @@
+#include "ecs_private.h"
+
+#include <cstring>
+
+/**
+ * Entity holding the component at the index, 0 when there is none. Free indices have an empty signature.
+ */
+static uint32_t ecs_observer_holder(const ecs_t* ecs, component_type_id_t type, uint32_t index)
+{
+	return ecs_signature_test(&ecs->signatures[index], type) ? ecs->entity_ids[index].id : 0;
+}
+
+void ecs_observe_all(ecs_t* ecs, component_type_id_t type, uint8_t flags)
+{
+	if (ecs->component_descs[type.id].observe_flags == nullptr)
+		return;
+	for (uint32_t i = 0; i < ecs->max_entities; ++i)
+		ecs_observe(ecs, type, i, flags);
+}
+
+ecs_result_t ecs_observer_create(ecs_t* ecs, const ecs_observer_create_info_t* create_info, ecs_observer_t** out_observer)
+{
+	ASSERT(create_info->func != nullptr, "Observer needs a callback");
+	component_desc_t* desc = &ecs->component_descs[create_info->type.id];
+	if (desc->num_observers++ == 0)
+	{
+		desc->observe_flags = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, ecs->max_entities, uint8_t);
+		memset(desc->observe_flags, 0, ecs->max_entities);
+		desc->observe_dirty.create(ecs->allocator, ecs->max_entities);
+		desc->observe_flush.create(ecs->allocator, ecs->max_entities);
+	}
+
+	ecs_observer_t* observer = ALLOCATOR_ALLOC_TYPE(ecs->allocator, ecs_observer_t);
+	memset(observer, 0, sizeof(ecs_observer_t));
+	observer->type = create_info->type;
+	observer->events = create_info->events;
+	observer->func = create_info->func;
+	observer->user_data = create_info->user_data;
+	observer->known = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, ecs->max_entities, entity_id_t);
+	memset(observer->known, 0, ecs->max_entities * sizeof(entity_id_t));
+	ecs_array_push(ecs->allocator, &ecs->observers, observer);
+
+	// Other observers of the type already know these, only the new one sees them as added
+	ecs_observe_all(ecs, create_info->type, ECS_OBSERVE_TOUCHED);
+
+	*out_observer = observer;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_observer_destroy(ecs_t* ecs, ecs_observer_t* observer)
+{
+	for (size_t i = 0; i < ecs->observers.length(); ++i)
+	{
+		if (ecs->observers[i] == observer)
+		{
+			ecs->observers.remove_at(i);
+			break;
+		}
+	}
+
+	component_desc_t* desc = &ecs->component_descs[observer->type.id];
+	if (--desc->num_observers == 0)
+	{
+		ALLOCATOR_FREE(ecs->allocator, desc->observe_flags);
+		desc->observe_flags = nullptr;
+		desc->observe_dirty.destroy(ecs->allocator);
+		desc->observe_flush.destroy(ecs->allocator);
+	}
+
+	ALLOCATOR_FREE(ecs->allocator, observer->known);
+	ALLOCATOR_FREE(ecs->allocator, observer);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_observers_flush(ecs_t* ecs)
+{
+	// The dirty lists are taken over before any callback runs, so whatever the
+	// callbacks touch is flagged again and reported by the next flush
+	for (size_t c = 0; c < ecs->component_descs.length(); ++c)
+	{
+		component_desc_t* desc = &ecs->component_descs[c];
+		if (desc->observe_flags == nullptr)
+			continue;
+		desc->observe_flush.clear();
+		for (size_t i = 0; i < desc->observe_dirty.length(); ++i)
+		{
+			uint32_t index = desc->observe_dirty[i];
+			desc->observe_flush.append(index | ((desc->observe_flags[index] & ECS_OBSERVE_CHANGED) ? ECS_OBSERVE_FLUSH_CHANGED : 0));
+			desc->observe_flags[index] = 0;
+		}
+		desc->observe_dirty.clear();
+	}
+
+	for (size_t o = 0; o < ecs->observers.length(); ++o)
+	{
+		ecs_observer_t* observer = ecs->observers[o];
+		const component_desc_t* desc = &ecs->component_descs[observer->type.id];
+		uint32_t num_dirty = (uint32_t)desc->observe_flush.length();
+		if (num_dirty == 0)
+			continue;
+
+		// Removes, adds and changes each get num_dirty entries of the scratch
+		ecs->observer_events.ensure_capacity(ecs->allocator, 3 * (size_t)num_dirty);
+		entity_id_t* removes = ecs->observer_events.begin();
+		entity_id_t* adds = removes + num_dirty;
+		entity_id_t* changes = adds + num_dirty;
+		uint32_t num_removes = 0;
+		uint32_t num_adds = 0;
+		uint32_t num_changes = 0;
+
+		for (uint32_t i = 0; i < num_dirty; ++i)
+		{
+			uint32_t index = desc->observe_flush[i] & ~ECS_OBSERVE_FLUSH_CHANGED;
+			entity_id_t known = observer->known[index];
+			entity_id_t current;
+			current.id = ecs_observer_holder(ecs, observer->type, index);
+
+			if (known.id != 0 && known.id != current.id)
+				removes[num_removes++] = known;
+			if (current.id != 0 && current.id != known.id)
+				adds[num_adds++] = current;
+			else if (current.id != 0 && (desc->observe_flush[i] & ECS_OBSERVE_FLUSH_CHANGED))
+				changes[num_changes++] = current;
+			observer->known[index] = current;
+		}
+
+		if (num_removes && (observer->events & ECS_OBSERVER_EVENT_REMOVE))
+			observer->func(ecs, ECS_OBSERVER_EVENT_REMOVE, removes, num_removes, observer->user_data);
+		if (num_adds && (observer->events & ECS_OBSERVER_EVENT_ADD))
+			observer->func(ecs, ECS_OBSERVER_EVENT_ADD, adds, num_adds, observer->user_data);
+		if (num_changes && (observer->events & ECS_OBSERVER_EVENT_CHANGE))
+			observer->func(ecs, ECS_OBSERVER_EVENT_CHANGE, changes, num_changes, observer->user_data);
+	}
+
+	return ECS_RESULT_OK;
+}
@@ -0,0 +1,554 @@
+#pragma once
+
+#include <game/ecs.h>
+#include <foundation/allocator.h>
+#include <foundation/array.h>
+#include <foundation/bits.h>
+#include <foundation/flat_map.h>
+#include <foundation/idpool.h>
+
+#if defined(SIMD_AVX2)
+#	include <immintrin.h>
+#elif defined(SIMD_SSE)
+#	include <emmintrin.h>
+#endif
+
+#define ECS_MAX_FREE_CHUNKS (64) // Empty chunks kept around for reuse
+
+/**
+ * One bit per component type, tags included.
+ */
+struct ALIGN(32) ecs_signature_t
+{
+	uint64_t bits[ECS_MAX_COMPONENT_TYPES / 64];
+};
+
+inline void ecs_signature_set(ecs_signature_t* signature, component_type_id_t type)
+{
+	signature->bits[type.id / 64] |= 1ULL << (type.id % 64);
+}
+
+inline void ecs_signature_clear(ecs_signature_t* signature, component_type_id_t type)
+{
+	signature->bits[type.id / 64] &= ~(1ULL << (type.id % 64));
+}
+
+inline bool ecs_signature_test(const ecs_signature_t* signature, component_type_id_t type)
+{
+	return ((signature->bits[type.id / 64] >> (type.id % 64)) & 1) != 0;
+}
+
+/**
+ * True when all bits of with and none of without are set. The loads are
+ * unaligned, allocators only promise 16 bytes for the signature arrays.
+ */
+inline bool ecs_signature_match(const ecs_signature_t* signature, const ecs_signature_t* with, const ecs_signature_t* without)
+{
+#if defined(SIMD_AVX2)
+	__m256i s = _mm256_loadu_si256((const __m256i*)signature->bits);
+	__m256i miss = _mm256_or_si256(_mm256_andnot_si256(s, _mm256_loadu_si256((const __m256i*)with->bits)), _mm256_and_si256(s, _mm256_loadu_si256((const __m256i*)without->bits)));
+	return _mm256_testz_si256(miss, miss) != 0;
+#elif defined(SIMD_SSE)
+	__m128i s0 = _mm_loadu_si128((const __m128i*)signature->bits);
+	__m128i s1 = _mm_loadu_si128((const __m128i*)signature->bits + 1);
+	__m128i miss0 = _mm_or_si128(_mm_andnot_si128(s0, _mm_loadu_si128((const __m128i*)with->bits)), _mm_and_si128(s0, _mm_loadu_si128((const __m128i*)without->bits)));
+	__m128i miss1 = _mm_or_si128(_mm_andnot_si128(s1, _mm_loadu_si128((const __m128i*)with->bits + 1)), _mm_and_si128(s1, _mm_loadu_si128((const __m128i*)without->bits + 1)));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(miss0, miss1), _mm_setzero_si128())) == 0xFFFF;
+#else
+	uint64_t miss = 0;
+	for (uint32_t i = 0; i < ECS_MAX_COMPONENT_TYPES / 64; ++i)
+		miss |= (with->bits[i] & ~signature->bits[i]) | (signature->bits[i] & without->bits[i]);
+	return miss == 0;
+#endif
+}
+
+struct component_desc_t
+{
+	uint32_t component_size;
+	uint32_t num_fields;
+	uint32_t max_components; // ECS_STORAGE_ARRAYS only, 0 for no limit
+	bool tag; // No data and no storage, only the bit in the signature of the entity
+
+	// ECS_STORAGE_ARRAYS only, maps an entity id to its row in table or UINT32_MAX
+	uint32_t table;
+	uint32_t* rows;
+
+	// Shared types only, each distinct value is stored once and entities refer to it through their archetype
+	bool shared;
+	array_t<uint8_t> shared_values; // component_size bytes per value
+	array_t<uint32_t> shared_refs; // Entities and prefabs using each value, 0 for free slots
+	array_t<uint32_t> shared_free;
+	flat_map_t<uint64_t, uint32_t> shared_lookup; // Hash of a value to its index
+
+	uint8_t* singleton; // Set by ecs_singleton_set
+
+	// While observed, the entity indices touched since the last ecs_observers_flush
+	uint32_t num_observers;
+	uint8_t* observe_flags; // ECS_OBSERVE_* per entity index
+	array_t<uint32_t> observe_dirty; // Indices with flags set, room for max_entities
+	array_t<uint32_t> observe_flush; // observe_dirty taken over by the running flush, ECS_OBSERVE_FLUSH_CHANGED or'ed in
+};
+
+#define ECS_OBSERVE_TOUCHED (1 << 0) // Component may have been added or removed
+#define ECS_OBSERVE_CHANGED (1 << 1)
+#define ECS_OBSERVE_FLUSH_CHANGED (1U << 31)
+
+struct ecs_observer_t
+{
+	component_type_id_t type;
+	uint32_t events;
+	ecs_observer_func_t func;
+	void* user_data;
+	entity_id_t* known; // Holder of the component at each index as of the last flush, 0 for none
+};
+
+struct ecs_column_t
+{
+	component_type_id_t type;
+	uint32_t size;
+	uint32_t offset; // From the start of a chunk
+
+	// Split components keep each field in its own array, field_stride bytes apart
+	uint32_t num_fields;
+	uint32_t field_size;
+	uint32_t field_stride; // 0 when not split
+
+	// Shared columns take no space in the chunks, all rows have the same value
+	uint32_t shared_value; // UINT32_MAX when not shared
+};
+
+/**
+ * Storage for entities sharing the same set of components. Rows are kept
+ * dense by swapping in the last row on removal. Row r lives at r % rows_per_chunk
+ * in chunk r / rows_per_chunk, and every chunk starts with the entity ids
+ * followed by one array per column, or one array per field for split columns.
+ *
+ * With ECS_STORAGE_ARRAYS there is one single column table per component type.
+ * Chunks never move once allocated, so component addresses stay stable as a
+ * table grows.
+ */
+struct ecs_table_t
+{
+	uint32_t num_columns;
+	ecs_column_t* columns; // Sorted on type id
+	uint32_t rows_per_chunk;
+	uint32_t chunk_size;
+	uint32_t count;
+	array_t<uint8_t*> chunks;
+
+	// Version of the last change to each column, num_columns entries per block of rows_per_version rows
+	uint32_t rows_per_version;
+	array_t<uint64_t> versions;
+
+	ecs_signature_t signature; // Types of the columns
+};
+
+struct ecs_record_t
+{
+	uint32_t table;
+	uint32_t row;
+};
+
+struct ecs_defrag_entry_t
+{
+	uint64_t key;
+	entity_id_t eid;
+};
+
+enum ecs_defrag_phase_t
+{
+	ECS_DEFRAG_PHASE_KEYS, // Collecting keys, sorting short runs as they fill up
+	ECS_DEFRAG_PHASE_MERGE, // Merging the sorted runs into one
+	ECS_DEFRAG_PHASE_PLACE, // Swapping rows into place
+};
+
+struct ecs_system_t;
+
+struct ecs_system_job_arg_t
+{
+	ecs_system_t* system;
+	const ecs_query_batch_t* batches;
+	uint32_t num_batches;
+	uint64_t* times; // Start and end of the job
+};
+
+struct ecs_system_t
+{
+	const char* name;
+	uint32_t num_reads;
+	uint32_t num_writes;
+	component_type_id_t reads[ECS_MAX_QUERY_COMPONENTS];
+	component_type_id_t writes[ECS_MAX_QUERY_COMPONENTS];
+	ecs_query_t* query;
+	ecs_query_job_func_t func;
+	void* user_data;
+	uint32_t max_jobs;
+
+	uint64_t preds; // Systems registered earlier that access the same components
+	uint32_t level;
+	uint64_t last_version; // Changes after this version have not been seen by the system
+
+	// State of the current or last run
+	job_event_t* done;
+	job_event_t* join; // Waits for all preds when there is more than one
+	uint32_t num_jobs;
+	ecs_system_job_arg_t* job_args;
+	uint64_t* job_times;
+};
+
+struct ecs_schedule_t
+{
+	array_t<ecs_system_t> systems;
+	ecs_system_info_t infos[ECS_MAX_SYSTEMS];
+	uint32_t critical_path[ECS_MAX_SYSTEMS];
+	uint32_t num_critical_path;
+	uint64_t frame_time;
+	uint64_t critical_path_time;
+};
+
+struct ecs_t
+{
+	allocator_t* allocator;
+	ecs_storage_t storage;
+	uint32_t max_entities;
+	idpool_t<uint32_t> entity_id_pool; // Hands out entity indices
+	entity_id_t* entity_ids; // Current id of each live index, see ecs_entity_reserve for the other indices
+	ecs_signature_t* signatures; // Component types of each index, empty for free indices
+	array_t<component_desc_t> component_descs;
+	array_t<ecs_table_t> tables;
+
+	// ECS_STORAGE_ARCHETYPES only
+	flat_map_t<uint64_t, uint32_t> table_lookup; // Hash of the sorted component types to table
+	ecs_record_t* records;
+
+	array_t<uint8_t*> free_chunks; // Block pool for chunks of ECS_CHUNK_SIZE bytes
+
+	uint64_t version; // Bumped by every structural change and writing query
+
+	array_t<uint64_t> scratch; // Sort keys for batched destroys
+
+	// Incremental defragmentation, see ecs_defragment
+	uint32_t defrag_table;
+	ecs_defrag_phase_t defrag_phase;
+	uint32_t defrag_row; // Next row to collect, merge into or put in place
+	uint32_t defrag_width; // Length of the sorted runs being merged
+	uint32_t defrag_left; // Next entries of the two runs being merged
+	uint32_t defrag_right;
+	uint32_t defrag_moves; // Rows moved since the round over the tables started
+	bool defrag_sorted; // No key collected so far is less than the one before
+	array_t<ecs_defrag_entry_t> defrag_order;
+	array_t<ecs_defrag_entry_t> defrag_merge; // Target of a merge pass, swapped with defrag_order after it
+
+	array_t<ecs_observer_t*> observers;
+	array_t<entity_id_t> observer_events; // Scratch for the entity ids handed to an observer
+
+	ecs_schedule_t schedule;
+};
+
+enum ecs_command_type_t
+{
+	ECS_COMMAND_CREATE_ENTITY,
+	ECS_COMMAND_DESTROY_ENTITY,
+	ECS_COMMAND_ADD_COMPONENT,
+	ECS_COMMAND_REMOVE_COMPONENT,
+};
+
+/**
+ * Commands are packed back to back in the arena of a stream, size covers the
+ * header and the data following it and is a multiple of 16.
+ */
+struct ecs_command_t
+{
+	uint32_t type;
+	uint32_t size;
+	entity_id_t eid;
+	uint32_t arg; // Component type or number of components for ECS_COMMAND_CREATE_ENTITY
+};
+
+struct ALIGN(CACHE_LINE_SIZE) ecs_command_stream_t
+{
+	allocator_t* arena;
+	uint32_t num_commands;
+
+	// Entity ids handed out by create commands, refilled on playback
+	entity_id_t* reserved_eids;
+	uint32_t num_reserved_used;
+};
+
+struct ecs_command_buffer_t
+{
+	ecs_t* ecs;
+	uint32_t num_streams;
+	uint32_t max_creates;
+	ecs_command_stream_t* streams;
+};
+
+struct ecs_hierarchy_job_arg_t
+{
+	ecs_hierarchy_t* hierarchy;
+	uint32_t begin;
+	uint32_t end;
+	bool root;
+};
+
+/**
+ * Nodes of depth d are at [level_start[d], level_start[d + 1]). Each node
+ * refers to its parent by entity index, so nodes can move without touching
+ * their children.
+ */
+struct ecs_hierarchy_t
+{
+	uint32_t max_nodes;
+	uint32_t batch_size;
+	uint32_t num_levels;
+	uint32_t level_start[ECS_HIERARCHY_MAX_DEPTH + 1];
+	uint32_t first_dirty_level; // ECS_HIERARCHY_MAX_DEPTH when nothing changed
+
+	uint32_t* nodes; // Entity index to node or UINT32_MAX
+	entity_id_t* eids;
+	uint32_t* parents; // Entity index of the parent, UINT32_MAX for roots
+	float* local_fields; // TRANSFORM_NUM_FIELDS arrays of max_nodes floats
+	float* worlds; // 16 floats per node
+	uint8_t* dirty; // Set for nodes to recompute, stays set for recomputed nodes until the update is done
+	uint8_t* marks; // Scratch for collecting subtrees
+
+	array_t<uint32_t> scratch; // Entity ids of a subtree being moved
+	array_t<uint32_t> children; // Entity ids of the children of a node being removed
+	array_t<ecs_hierarchy_job_arg_t> job_args;
+};
+
+struct ecs_prefab_t
+{
+	ecs_signature_t signature; // Tags are only in here, not in types
+	uint32_t num_components;
+	component_type_id_t types[ECS_MAX_COMPONENTS_PER_ENTITY]; // Sorted on type id
+	uint32_t offsets[ECS_MAX_COMPONENTS_PER_ENTITY]; // Into data
+	uint32_t shared_values[ECS_MAX_COMPONENTS_PER_ENTITY]; // UINT32_MAX for types that are not shared
+	uint8_t* data;
+	uint32_t table; // ECS_STORAGE_ARCHETYPES only
+};
+
+inline bool ecs_entity_alive(const ecs_t* ecs, entity_id_t eid)
+{
+	return ecs->entity_ids[ecs_entity_index(eid)].id == eid.id;
+}
+
+/**
+ * Takes a free index and returns the id it hands out next, without making it alive.
+ * Free and reserved indices keep that id with the index bits flipped, so no id
+ * passes ecs_entity_alive for them until ecs_entity_publish.
+ */
+inline entity_id_t ecs_entity_reserve(ecs_t* ecs)
+{
+	entity_id_t eid = { ecs->entity_ids[ecs->entity_id_pool.alloc_handle()].id ^ ECS_ENTITY_INDEX_MASK };
+	return eid;
+}
+
+inline void ecs_entity_publish(ecs_t* ecs, entity_id_t eid)
+{
+	ecs->entity_ids[ecs_entity_index(eid)] = eid;
+}
+
+inline entity_id_t ecs_entity_alloc(ecs_t* ecs)
+{
+	entity_id_t eid = ecs_entity_reserve(ecs);
+	ecs_entity_publish(ecs, eid);
+	return eid;
+}
+
+/**
+ * Frees a live or reserved id, the index hands out the next generation.
+ */
+inline void ecs_entity_free(ecs_t* ecs, entity_id_t eid)
+{
+	uint32_t index = ecs_entity_index(eid);
+	uint32_t generation = (ecs_entity_generation(eid) + 1) & (UINT32_MAX >> ECS_ENTITY_INDEX_BITS);
+	ecs->entity_ids[index].id = (index | ((generation ? generation : 1) << ECS_ENTITY_INDEX_BITS)) ^ ECS_ENTITY_INDEX_MASK;
+	ecs->entity_id_pool.free_handle(index);
+}
+
+// Appends to an array, doubling its capacity when full
+template<class T>
+inline void ecs_array_push(allocator_t* allocator, array_t<T>* arr, const T& val)
+{
+	if (arr->full())
+		arr->set_capacity(allocator, arr->capacity() ? arr->capacity() * 2 : 16);
+	arr->append(val);
+}
+
+/**
+ * Flags the entity index for the observers of the type, does nothing when the type is not observed.
+ */
+inline void ecs_observe(ecs_t* ecs, component_type_id_t type, uint32_t index, uint8_t flags)
+{
+	component_desc_t* desc = &ecs->component_descs[type.id];
+	if (desc->observe_flags == nullptr)
+		return;
+	if (desc->observe_flags[index] == 0)
+		desc->observe_dirty.append(index);
+	desc->observe_flags[index] |= flags;
+}
+
+inline void ecs_observe_eids(ecs_t* ecs, component_type_id_t type, const entity_id_t* eids, uint32_t count, uint8_t flags)
+{
+	if (ecs->component_descs[type.id].observe_flags == nullptr)
+		return;
+	for (uint32_t i = 0; i < count; ++i)
+		ecs_observe(ecs, type, ecs_entity_index(eids[i]), flags);
+}
+
+inline uint32_t ecs_table_find_column(const ecs_table_t* table, component_type_id_t type)
+{
+	uint32_t lo = 0;
+	uint32_t hi = table->num_columns;
+	while (lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+		if (table->columns[mid].type.id < type.id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo < table->num_columns && table->columns[lo].type.id == type.id) ? lo : UINT32_MAX;
+}
+
+inline entity_id_t* ecs_table_eid(ecs_table_t* table, uint32_t row)
+{
+	uint8_t* chunk = table->chunks[row / table->rows_per_chunk];
+	return (entity_id_t*)chunk + row % table->rows_per_chunk;
+}
+
+// Gives the first field of split columns
+inline uint8_t* ecs_table_get(ecs_table_t* table, uint32_t row, uint32_t column)
+{
+	uint8_t* chunk = table->chunks[row / table->rows_per_chunk];
+	const ecs_column_t* col = &table->columns[column];
+	return chunk + col->offset + (row % table->rows_per_chunk) * col->field_size;
+}
+
+inline uint64_t* ecs_table_version(ecs_table_t* table, uint32_t row, uint32_t column)
+{
+	return &table->versions[(row / table->rows_per_version) * table->num_columns + column];
+}
+
+// Flags the entity index for the observers of every type in its signature
+inline void ecs_observe_signature(ecs_t* ecs, uint32_t index, uint8_t flags)
+{
+	if (ecs->observers.length() == 0)
+		return;
+	const ecs_signature_t* signature = &ecs->signatures[index];
+	for (uint32_t i = 0; i < ECS_MAX_COMPONENT_TYPES / 64; ++i)
+	{
+		for (uint64_t bits = signature->bits[i]; bits; bits &= bits - 1)
+		{
+			component_type_id_t type = { i * 64 + bits_lsb(bits) };
+			ecs_observe(ecs, type, index, flags);
+		}
+	}
+}
+
+inline uint8_t* ecs_shared_get(ecs_t* ecs, component_type_id_t type, uint32_t value)
+{
+	component_desc_t* desc = &ecs->component_descs[type.id];
+	return &desc->shared_values[value * desc->component_size];
+}
+
+/**
+ * Finds or adds the value and adds count references to it.
+ */
+uint32_t ecs_shared_acquire(ecs_t* ecs, component_type_id_t type, const void* data, uint32_t count);
+
+void ecs_shared_release(ecs_t* ecs, component_type_id_t type, uint32_t value, uint32_t count);
+
+/**
+ * Adds a value already stored in its slot to the lookup, the value must not be in it yet.
+ */
+void ecs_shared_lookup_insert(ecs_t* ecs, component_type_id_t type, uint32_t value);
+
+struct ecs_query_table_t
+{
+	uint32_t table;
+	uint32_t columns[ECS_MAX_QUERY_COMPONENTS]; // Column of each with and optional component, UINT32_MAX when missing
+};
+
+struct ecs_query_job_arg_t
+{
+	ecs_query_job_func_t func;
+	void* user_data;
+	const ecs_query_batch_t* batches;
+	uint32_t num_batches;
+};
+
+struct ecs_query_t
+{
+	uint32_t num_with;
+	uint32_t num_without;
+	uint32_t num_optional;
+	component_type_id_t with[ECS_MAX_QUERY_COMPONENTS];
+	component_type_id_t without[ECS_MAX_QUERY_COMPONENTS];
+	component_type_id_t optional[ECS_MAX_QUERY_COMPONENTS];
+	uint32_t batch_size;
+	uint32_t write_mask;
+	uint32_t changed_mask;
+	uint64_t changed_since;
+	uint64_t write_version; // Version given to the written columns by the current iteration
+
+	// Signature tests for entities, and for tables where tags do not take part
+	ecs_signature_t with_mask;
+	ecs_signature_t without_mask;
+	ecs_signature_t table_with_mask;
+	ecs_signature_t table_without_mask;
+	bool filter_rows; // Tags in with or without, ECS_STORAGE_ARCHETYPES has to test each row
+
+	// ECS_STORAGE_ARCHETYPES only, tables are matched as they get created
+	uint32_t num_tables_checked;
+	array_t<ecs_query_table_t> tables;
+
+	// Kept alive until the jobs of the last kick are done
+	array_t<ecs_query_batch_t> batches;
+	array_t<ecs_query_job_arg_t> job_args;
+};
+
+/**
+ * Adds count rows at the end of the table, returns the first one. Entity ids and components are left uninitialized.
+ */
+uint32_t ecs_table_push_rows(ecs_t* ecs, ecs_table_t* table, uint32_t count);
+
+/**
+ * Gives all columns of the blocks holding the rows a new version.
+ */
+void ecs_table_mark_rows(ecs_t* ecs, ecs_table_t* table, uint32_t first, uint32_t count);
+
+/**
+ * Removes all rows, the first chunk is kept around.
+ */
+void ecs_table_clear(ecs_t* ecs, ecs_table_t* table);
+
+/**
+ * Types have to be sorted on id. shared_values holds the value of each
+ * shared type and UINT32_MAX for the rest, it can be nullptr when no type is shared.
+ */
+uint32_t ecs_archetype_find_or_create(ecs_t* ecs, const component_type_id_t* types, uint32_t num_types, const uint32_t* shared_values);
+
+/**
+ * Adds already allocated entity ids to the storage, see ecs_entities_create_batch.
+ */
+void ecs_entities_insert(ecs_t* ecs, const entity_create_info_t* create_info, uint32_t count, const entity_id_t* eids);
+
+/**
+ * Collects the batches of a query into query->job_args, returns the number of jobs.
+ */
+uint32_t ecs_query_prepare_jobs(ecs_t* ecs, ecs_query_t* query, uint32_t max_jobs, ecs_query_job_func_t func, void* user_data);
+
+/**
+ * Flags the entities of the collected batches as changed for the observers of
+ * the written types. Only called from the thread owning the ECS, never from jobs.
+ */
+void ecs_query_observe_batches(ecs_t* ecs, const ecs_query_t* query);
+
+void ecs_systems_destroy(ecs_t* ecs);
+
+/**
+ * Flags every entity index for the observers of the type, does nothing when the type is not observed.
+ */
+void ecs_observe_all(ecs_t* ecs, component_type_id_t type, uint8_t flags);
@@ -0,0 +1,392 @@
+#include "ecs_private.h"
+
+#include <foundation/bits.h>
+#include <foundation/job_system.h>
+
+#include <cstring>
+
+static void ecs_query_match_tables(ecs_t* ecs, ecs_query_t* query)
+{
+	uint32_t num_tables = static_cast<uint32_t>(ecs->tables.length());
+	for (uint32_t t = query->num_tables_checked; t < num_tables; ++t)
+	{
+		const ecs_table_t* table = &ecs->tables[t];
+		if (!ecs_signature_match(&table->signature, &query->table_with_mask, &query->table_without_mask))
+			continue;
+
+		// Tags have no column
+		ecs_query_table_t match;
+		match.table = t;
+		for (uint32_t i = 0; i < query->num_with; ++i)
+			match.columns[i] = ecs_table_find_column(table, query->with[i]);
+		for (uint32_t i = 0; i < query->num_optional; ++i)
+			match.columns[query->num_with + i] = ecs_table_find_column(table, query->optional[i]);
+
+		ecs_array_push(ecs->allocator, &query->tables, match);
+	}
+	query->num_tables_checked = num_tables;
+}
+
+/**
+ * Batches never cross a version block, so the first row speaks for the whole batch.
+ */
+static bool ecs_query_table_changed(const ecs_query_t* query, ecs_table_t* table, uint32_t row, const uint32_t* columns)
+{
+	for (uint32_t mask = query->changed_mask; mask; mask &= mask - 1)
+	{
+		uint32_t column = columns[bits_lsb(mask)];
+		if (column != UINT32_MAX && *ecs_table_version(table, row, column) > query->changed_since)
+			return true;
+	}
+	return false;
+}
+
+static void ecs_query_table_mark(const ecs_query_t* query, ecs_table_t* table, uint32_t row, const uint32_t* columns)
+{
+	for (uint32_t mask = query->write_mask; mask; mask &= mask - 1)
+	{
+		uint32_t column = columns[bits_lsb(mask)];
+		if (column != UINT32_MAX)
+			*ecs_table_version(table, row, column) = query->write_version;
+	}
+}
+
+/**
+ * Flags the entities of the batch as changed for the observers of the written types.
+ */
+static void ecs_query_observe_writes(ecs_t* ecs, const ecs_query_t* query, const ecs_query_batch_t* batch)
+{
+	for (uint32_t mask = query->write_mask; mask; mask &= mask - 1)
+	{
+		uint32_t i = bits_lsb(mask);
+		if (batch->components[i] != nullptr)
+			ecs_observe_eids(ecs, i < query->num_with ? query->with[i] : query->optional[i - query->num_with], batch->eids, batch->count, ECS_OBSERVE_CHANGED);
+	}
+}
+
+static bool ecs_query_row_matches(const ecs_t* ecs, const ecs_query_t* query, ecs_table_t* table, uint32_t row)
+{
+	return ecs_signature_match(&ecs->signatures[ecs_entity_index(*ecs_table_eid(table, row))], &query->with_mask, &query->without_mask);
+}
+
+static bool ecs_query_next_archetypes(ecs_query_iter_t* iter, ecs_query_batch_t* out_batch)
+{
+	ecs_query_t* query = iter->query;
+	uint32_t num_components = query->num_with + query->num_optional;
+
+	while (iter->table < query->tables.length())
+	{
+		const ecs_query_table_t* match = &query->tables[iter->table];
+		ecs_table_t* table = &iter->ecs->tables[match->table];
+		if (iter->row >= table->count)
+		{
+			++iter->table;
+			iter->row = 0;
+			continue;
+		}
+
+		uint32_t chunk = iter->row / table->rows_per_chunk;
+		uint32_t index = iter->row % table->rows_per_chunk;
+		uint32_t count = table->count - iter->row;
+		if (count > table->rows_per_chunk - index)
+			count = table->rows_per_chunk - index;
+		if (count > query->batch_size - index % query->batch_size)
+			count = query->batch_size - index % query->batch_size;
+
+		uint32_t row = iter->row;
+		iter->row += count;
+		if (query->filter_rows)
+		{
+			// Tags are not part of the archetype, the batch shrinks to the first run of rows having the right ones
+			uint32_t end = row + count;
+			while (row < end && !ecs_query_row_matches(iter->ecs, query, table, row))
+				++row;
+			if (row == end)
+				continue;
+			count = 1;
+			while (row + count < end && ecs_query_row_matches(iter->ecs, query, table, row + count))
+				++count;
+			iter->row = row + count;
+			index = row % table->rows_per_chunk;
+		}
+		if (query->changed_mask && !ecs_query_table_changed(query, table, row, match->columns))
+			continue;
+		ecs_query_table_mark(query, table, row, match->columns);
+
+		uint8_t* base = table->chunks[chunk];
+		out_batch->count = count;
+		out_batch->eids = (const entity_id_t*)base + index;
+		out_batch->shared_mask = 0;
+		for (uint32_t i = 0; i < num_components; ++i)
+		{
+			uint32_t column = match->columns[i];
+			if (column != UINT32_MAX && table->columns[column].shared_value != UINT32_MAX)
+			{
+				out_batch->components[i] = ecs_shared_get(iter->ecs, table->columns[column].type, table->columns[column].shared_value);
+				out_batch->field_strides[i] = 0;
+				out_batch->shared_mask |= 1u << i;
+				continue;
+			}
+			out_batch->components[i] = column != UINT32_MAX ? base + table->columns[column].offset + index * table->columns[column].field_size : nullptr;
+			out_batch->field_strides[i] = column != UINT32_MAX ? table->columns[column].field_stride : 0;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static bool ecs_query_next_arrays(ecs_query_iter_t* iter, ecs_query_batch_t* out_batch)
+{
+	ecs_t* ecs = iter->ecs;
+	ecs_query_t* query = iter->query;
+	ecs_table_t* driver = &ecs->tables[iter->table];
+	uint32_t num_components = query->num_with + query->num_optional;
+
+	const component_desc_t* descs[ECS_MAX_QUERY_COMPONENTS];
+	for (uint32_t i = 0; i < num_components; ++i)
+		descs[i] = &ecs->component_descs[i < query->num_with ? query->with[i].id : query->optional[i - query->num_with].id];
+
+	while (iter->row < driver->count)
+	{
+		uint32_t start = iter->row++;
+		uint32_t eid = ecs_entity_index(*ecs_table_eid(driver, start));
+		if (!ecs_signature_match(&ecs->signatures[eid], &query->with_mask, &query->without_mask))
+			continue;
+
+		// Tags have no rows
+		uint32_t rows[ECS_MAX_QUERY_COMPONENTS];
+		for (uint32_t i = 0; i < num_components; ++i)
+			rows[i] = descs[i]->rows ? descs[i]->rows[eid] : UINT32_MAX;
+
+		// Grow the batch while the next entity has its components right after in every array
+		uint32_t limit = driver->count;
+		if (limit > start - start % query->batch_size + query->batch_size)
+			limit = start - start % query->batch_size + query->batch_size;
+		if (limit > start - start % driver->rows_per_chunk + driver->rows_per_chunk)
+			limit = start - start % driver->rows_per_chunk + driver->rows_per_chunk;
+		for (uint32_t i = 0; i < num_components; ++i)
+		{
+			const ecs_table_t* table = &ecs->tables[descs[i]->table];
+			if (rows[i] != UINT32_MAX && limit > start + table->rows_per_chunk - rows[i] % table->rows_per_chunk)
+				limit = start + table->rows_per_chunk - rows[i] % table->rows_per_chunk;
+			if (rows[i] != UINT32_MAX && limit > start + table->rows_per_version - rows[i] % table->rows_per_version)
+				limit = start + table->rows_per_version - rows[i] % table->rows_per_version;
+		}
+
+		uint32_t end = start + 1;
+		for (; end < limit; ++end)
+		{
+			uint32_t next = ecs_entity_index(*ecs_table_eid(driver, end));
+			uint32_t offset = end - start;
+			bool consecutive = ecs_signature_match(&ecs->signatures[next], &query->with_mask, &query->without_mask);
+			for (uint32_t i = 0; i < num_components && consecutive; ++i)
+				consecutive = descs[i]->rows == nullptr || descs[i]->rows[next] == (rows[i] != UINT32_MAX ? rows[i] + offset : UINT32_MAX);
+			if (!consecutive)
+				break;
+		}
+
+		iter->row = end;
+
+		bool changed = query->changed_mask == 0;
+		for (uint32_t mask = query->changed_mask; mask && !changed; mask &= mask - 1)
+		{
+			uint32_t i = bits_lsb(mask);
+			changed = rows[i] != UINT32_MAX && *ecs_table_version(&ecs->tables[descs[i]->table], rows[i], 0) > query->changed_since;
+		}
+		if (!changed)
+			continue;
+		for (uint32_t mask = query->write_mask; mask; mask &= mask - 1)
+		{
+			uint32_t i = bits_lsb(mask);
+			if (rows[i] != UINT32_MAX)
+				*ecs_table_version(&ecs->tables[descs[i]->table], rows[i], 0) = query->write_version;
+		}
+
+		out_batch->count = end - start;
+		out_batch->shared_mask = 0;
+		out_batch->eids = ecs_table_eid(driver, start);
+		for (uint32_t i = 0; i < num_components; ++i)
+		{
+			out_batch->components[i] = rows[i] != UINT32_MAX ? ecs_table_get(&ecs->tables[descs[i]->table], rows[i], 0) : nullptr;
+			out_batch->field_strides[i] = rows[i] != UINT32_MAX ? ecs->tables[descs[i]->table].columns[0].field_stride : 0;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static void ecs_query_job(job_context_t* context, void* arg)
+{
+	ecs_query_job_arg_t* job_arg = (ecs_query_job_arg_t*)arg;
+	for (uint32_t i = 0; i < job_arg->num_batches; ++i)
+		job_arg->func(context, &job_arg->batches[i], job_arg->user_data);
+}
+
+ecs_result_t ecs_query_create(ecs_t* ecs, const ecs_query_create_info_t* create_info, ecs_query_t** out_query)
+{
+	ASSERT(create_info->num_with + create_info->num_optional <= ECS_MAX_QUERY_COMPONENTS, "Too many components in query");
+	ASSERT(create_info->num_without <= ECS_MAX_QUERY_COMPONENTS, "Too many components in query");
+
+	ecs_query_t* query = ALLOCATOR_ALLOC_TYPE(ecs->allocator, ecs_query_t);
+	memset(query, 0, sizeof(ecs_query_t));
+	query->num_with = create_info->num_with;
+	query->num_without = create_info->num_without;
+	query->num_optional = create_info->num_optional;
+	if (create_info->num_with)
+		memcpy(query->with, create_info->with, create_info->num_with * sizeof(component_type_id_t));
+	if (create_info->num_without)
+		memcpy(query->without, create_info->without, create_info->num_without * sizeof(component_type_id_t));
+	if (create_info->num_optional)
+		memcpy(query->optional, create_info->optional, create_info->num_optional * sizeof(component_type_id_t));
+	query->batch_size = create_info->batch_size ? create_info->batch_size : UINT32_MAX;
+	query->write_mask = create_info->write_mask;
+	query->changed_mask = create_info->changed_mask;
+
+	// Shared values only change through ecs_entity_set_shared_component, never through batches
+	for (uint32_t i = 0; i < create_info->num_with + create_info->num_optional; ++i)
+	{
+		component_type_id_t type = i < create_info->num_with ? create_info->with[i] : create_info->optional[i - create_info->num_with];
+		if (ecs->component_descs[type.id].shared)
+			query->write_mask &= ~(1u << i);
+	}
+
+	bool has_data = false;
+	for (uint32_t i = 0; i < create_info->num_with; ++i)
+	{
+		bool tag = ecs->component_descs[create_info->with[i].id].tag;
+		ecs_signature_set(&query->with_mask, create_info->with[i]);
+		if (!tag)
+			ecs_signature_set(&query->table_with_mask, create_info->with[i]);
+		query->filter_rows = query->filter_rows || tag;
+		has_data = has_data || !tag;
+	}
+	for (uint32_t i = 0; i < create_info->num_without; ++i)
+	{
+		bool tag = ecs->component_descs[create_info->without[i].id].tag;
+		ecs_signature_set(&query->without_mask, create_info->without[i]);
+		if (!tag)
+			ecs_signature_set(&query->table_without_mask, create_info->without[i]);
+		query->filter_rows = query->filter_rows || tag;
+	}
+	for (uint32_t i = 0; i < create_info->num_optional; ++i)
+		ASSERT(!ecs->component_descs[create_info->optional[i].id].tag, "Tags can not be optional");
+	ASSERT(ecs->storage == ECS_STORAGE_ARCHETYPES || has_data, "Array storage needs at least one with component that is not a tag to query");
+
+	*out_query = query;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_query_destroy(ecs_t* ecs, ecs_query_t* query)
+{
+	query->tables.destroy(ecs->allocator);
+	query->batches.destroy(ecs->allocator);
+	query->job_args.destroy(ecs->allocator);
+	ALLOCATOR_FREE(ecs->allocator, query);
+	return ECS_RESULT_OK;
+}
+
+void ecs_query_set_changed_since(ecs_query_t* query, uint64_t version)
+{
+	query->changed_since = version;
+}
+
+bool ecs_query_matches(ecs_t* ecs, const ecs_query_t* query, entity_id_t eid)
+{
+	return ecs_entity_alive(ecs, eid) && ecs_signature_match(&ecs->signatures[ecs_entity_index(eid)], &query->with_mask, &query->without_mask);
+}
+
+void ecs_query_iter_begin(ecs_t* ecs, ecs_query_t* query, ecs_query_iter_t* out_iter)
+{
+	out_iter->ecs = ecs;
+	out_iter->query = query;
+	out_iter->table = 0;
+	out_iter->row = 0;
+
+	if (query->write_mask)
+		query->write_version = ++ecs->version;
+
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		ecs_query_match_tables(ecs, query);
+	}
+	else
+	{
+		// Walk the smallest array and test the signatures of its entities
+		out_iter->table = UINT32_MAX;
+		for (uint32_t i = 0; i < query->num_with; ++i)
+		{
+			uint32_t table = ecs->component_descs[query->with[i].id].table;
+			if (table != UINT32_MAX && (out_iter->table == UINT32_MAX || ecs->tables[table].count < ecs->tables[out_iter->table].count))
+				out_iter->table = table;
+		}
+	}
+}
+
+bool ecs_query_iter_next(ecs_query_iter_t* iter, ecs_query_batch_t* out_batch)
+{
+	if (iter->ecs->storage == ECS_STORAGE_ARCHETYPES)
+		return ecs_query_next_archetypes(iter, out_batch);
+	return ecs_query_next_arrays(iter, out_batch);
+}
+
+uint32_t ecs_query_prepare_jobs(ecs_t* ecs, ecs_query_t* query, uint32_t max_jobs, ecs_query_job_func_t func, void* user_data)
+{
+	ASSERT(max_jobs > 0);
+
+	query->batches.clear();
+	query->job_args.clear();
+
+	uint32_t total = 0;
+	ecs_query_iter_t iter;
+	ecs_query_batch_t batch;
+	ecs_query_iter_begin(ecs, query, &iter);
+	while (ecs_query_iter_next(&iter, &batch))
+	{
+		ecs_array_push(ecs->allocator, &query->batches, batch);
+		total += batch.count;
+	}
+
+	// Hand out consecutive batches until each job has its share of entities
+	uint32_t num_batches = static_cast<uint32_t>(query->batches.length());
+	uint32_t num_jobs = max_jobs < num_batches ? max_jobs : num_batches;
+	uint32_t per_job = num_jobs ? (total + num_jobs - 1) / num_jobs : 0;
+	uint32_t first = 0;
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < num_batches; ++i)
+	{
+		count += query->batches[i].count;
+		if (count >= per_job || i + 1 == num_batches)
+		{
+			ecs_query_job_arg_t job_arg;
+			job_arg.func = func;
+			job_arg.user_data = user_data;
+			job_arg.batches = &query->batches[first];
+			job_arg.num_batches = i + 1 - first;
+			ecs_array_push(ecs->allocator, &query->job_args, job_arg);
+			first = i + 1;
+			count = 0;
+		}
+	}
+
+	return static_cast<uint32_t>(query->job_args.length());
+}
+
+void ecs_query_observe_batches(ecs_t* ecs, const ecs_query_t* query)
+{
+	if (ecs->observers.length() == 0 || query->write_mask == 0)
+		return;
+	for (size_t i = 0; i < query->batches.length(); ++i)
+		ecs_query_observe_writes(ecs, query, &query->batches[i]);
+}
+
+ecs_result_t ecs_query_kick(ecs_t* ecs, ecs_query_t* query, job_system_t* job_system, uint32_t max_jobs, ecs_query_job_func_t func, void* user_data, job_event_t* depends, job_event_t* event)
+{
+	uint32_t num_jobs = ecs_query_prepare_jobs(ecs, query, max_jobs, func, user_data);
+	ecs_query_observe_batches(ecs, query);
+	job_system_result_t res = job_system_kick_ptr(job_system, ecs_query_job, num_jobs, query->job_args.begin(), depends, event);
+	ASSERT(res == JOB_SYSTEM_OK);
+	(void)res;
+	return ECS_RESULT_OK;
+}
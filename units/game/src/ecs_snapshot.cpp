@@ -0,0 +1,371 @@
+#include "ecs_private.h"
+
+#include <foundation/defines.h>
+#include <foundation/hash.h>
+
+#include <cstring>
+
+#define ECS_SNAPSHOT_MAGIC (0x50414E53) // "SNAP"
+#define ECS_SNAPSHOT_FORMAT (4)
+
+/**
+ * All offsets are in bytes from the start of the blob, every array starts at
+ * a multiple of CACHE_LINE_SIZE.
+ */
+struct ecs_snapshot_header_t
+{
+	uint32_t magic;
+	uint32_t format;
+	uint32_t storage;
+	uint32_t max_entities;
+	uint32_t num_component_types;
+	uint32_t num_tables;
+	uint32_t num_free_entities;
+	uint32_t padding;
+	uint64_t size;
+	uint64_t entity_ids; // max_entities entity_id_t
+	uint64_t free_entities; // Free list of the entity id pool, num_free_entities uint32_t
+	uint64_t signatures; // max_entities ecs_signature_t, the only place tags are kept
+	uint64_t records; // ECS_STORAGE_ARCHETYPES only, max_entities ecs_record_t
+	uint64_t components; // num_component_types ecs_snapshot_component_t
+	uint64_t tables; // num_tables ecs_snapshot_table_t
+};
+
+struct ecs_snapshot_component_t
+{
+	uint32_t component_size;
+	uint32_t num_fields;
+	uint32_t shared;
+	uint32_t num_shared_values;
+	uint64_t rows; // ECS_STORAGE_ARRAYS only and not for tags, max_entities uint32_t
+	uint64_t shared_values; // num_shared_values * component_size bytes
+	uint64_t shared_refs; // num_shared_values uint32_t
+	uint64_t singleton; // component_size bytes, 0 when not set
+};
+
+struct ecs_snapshot_table_t
+{
+	uint32_t num_columns;
+	uint32_t rows_per_chunk;
+	uint32_t chunk_size;
+	uint32_t count;
+	uint64_t types; // num_columns component_type_id_t
+	uint64_t shared_values; // num_columns uint32_t
+	uint64_t chunks; // Chunk i starts at chunks + i * chunk_stride
+	uint64_t chunk_stride;
+};
+
+/**
+ * Lays out the blob without writing anything when blob is nullptr, so the
+ * same code gives both the size and the contents.
+ */
+struct ecs_snapshot_writer_t
+{
+	uint8_t* blob;
+	uint64_t size;
+};
+
+static uint64_t ecs_snapshot_align(uint64_t offset)
+{
+	return (offset + CACHE_LINE_SIZE - 1) & ~(uint64_t)(CACHE_LINE_SIZE - 1);
+}
+
+static uint64_t ecs_snapshot_reserve(ecs_snapshot_writer_t* writer, uint64_t size)
+{
+	uint64_t offset = ecs_snapshot_align(writer->size);
+	writer->size = offset + size;
+	return offset;
+}
+
+static uint64_t ecs_snapshot_put(ecs_snapshot_writer_t* writer, const void* data, uint64_t size)
+{
+	uint64_t offset = ecs_snapshot_reserve(writer, size);
+	if (writer->blob && size)
+		memcpy(writer->blob + offset, data, (size_t)size);
+	return offset;
+}
+
+static void ecs_snapshot_emit(ecs_t* ecs, ecs_snapshot_writer_t* writer)
+{
+	ecs_snapshot_header_t header;
+	memset(&header, 0, sizeof(header));
+	ecs_snapshot_reserve(writer, sizeof(header));
+
+	header.magic = ECS_SNAPSHOT_MAGIC;
+	header.format = ECS_SNAPSHOT_FORMAT;
+	header.storage = (uint32_t)ecs->storage;
+	header.max_entities = ecs->max_entities;
+	header.num_component_types = (uint32_t)ecs->component_descs.length();
+	header.num_tables = (uint32_t)ecs->tables.length();
+	header.num_free_entities = (uint32_t)ecs->entity_id_pool.num_free();
+
+	header.entity_ids = ecs_snapshot_put(writer, ecs->entity_ids, ecs->max_entities * sizeof(entity_id_t));
+	header.free_entities = ecs_snapshot_put(writer, ecs->entity_id_pool._handles, header.num_free_entities * sizeof(uint32_t));
+	header.signatures = ecs_snapshot_put(writer, ecs->signatures, ecs->max_entities * sizeof(ecs_signature_t));
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+		header.records = ecs_snapshot_put(writer, ecs->records, ecs->max_entities * sizeof(ecs_record_t));
+
+	header.components = ecs_snapshot_reserve(writer, header.num_component_types * sizeof(ecs_snapshot_component_t));
+	for (uint32_t i = 0; i < header.num_component_types; ++i)
+	{
+		const component_desc_t* desc = &ecs->component_descs[i];
+		ecs_snapshot_component_t component;
+		memset(&component, 0, sizeof(component));
+		component.component_size = desc->component_size;
+		component.num_fields = desc->num_fields;
+		component.shared = desc->shared;
+		component.num_shared_values = (uint32_t)desc->shared_refs.length();
+		if (ecs->storage == ECS_STORAGE_ARRAYS && !desc->tag)
+			component.rows = ecs_snapshot_put(writer, desc->rows, ecs->max_entities * sizeof(uint32_t));
+		if (desc->shared)
+		{
+			component.shared_values = ecs_snapshot_put(writer, desc->shared_values.begin(), component.num_shared_values * desc->component_size);
+			component.shared_refs = ecs_snapshot_put(writer, desc->shared_refs.begin(), component.num_shared_values * sizeof(uint32_t));
+		}
+		if (desc->singleton)
+			component.singleton = ecs_snapshot_put(writer, desc->singleton, desc->component_size);
+		if (writer->blob)
+			memcpy(writer->blob + header.components + i * sizeof(component), &component, sizeof(component));
+	}
+
+	header.tables = ecs_snapshot_reserve(writer, header.num_tables * sizeof(ecs_snapshot_table_t));
+	for (uint32_t i = 0; i < header.num_tables; ++i)
+	{
+		ecs_table_t* table = &ecs->tables[i];
+		component_type_id_t types[ECS_MAX_COMPONENTS_PER_ENTITY];
+		uint32_t shared_values[ECS_MAX_COMPONENTS_PER_ENTITY];
+		for (uint32_t c = 0; c < table->num_columns; ++c)
+		{
+			types[c] = table->columns[c].type;
+			shared_values[c] = table->columns[c].shared_value;
+		}
+
+		ecs_snapshot_table_t snapshot_table;
+		memset(&snapshot_table, 0, sizeof(snapshot_table));
+		snapshot_table.num_columns = table->num_columns;
+		snapshot_table.rows_per_chunk = table->rows_per_chunk;
+		snapshot_table.chunk_size = table->chunk_size;
+		snapshot_table.count = table->count;
+		snapshot_table.types = ecs_snapshot_put(writer, types, table->num_columns * sizeof(component_type_id_t));
+		snapshot_table.shared_values = ecs_snapshot_put(writer, shared_values, table->num_columns * sizeof(uint32_t));
+
+		// Chunks are stored whole, the rows past count in the last one are junk
+		uint32_t num_chunks = (table->count + table->rows_per_chunk - 1) / table->rows_per_chunk;
+		snapshot_table.chunk_stride = ecs_snapshot_align(table->chunk_size);
+		snapshot_table.chunks = ecs_snapshot_reserve(writer, num_chunks * snapshot_table.chunk_stride);
+		if (writer->blob)
+		{
+			for (uint32_t c = 0; c < num_chunks; ++c)
+				memcpy(writer->blob + snapshot_table.chunks + c * snapshot_table.chunk_stride, table->chunks[c], table->chunk_size);
+			memcpy(writer->blob + header.tables + i * sizeof(snapshot_table), &snapshot_table, sizeof(snapshot_table));
+		}
+	}
+
+	header.size = writer->size;
+	if (writer->blob)
+		memcpy(writer->blob, &header, sizeof(header));
+}
+
+static bool ecs_snapshot_in_range(const ecs_snapshot_header_t* header, uint64_t offset, uint64_t size)
+{
+	return offset <= header->size && size <= header->size - offset;
+}
+
+/**
+ * Checks everything ecs_snapshot_read relies on before anything is changed.
+ */
+static bool ecs_snapshot_validate(ecs_t* ecs, const uint8_t* blob, size_t blob_size)
+{
+	const ecs_snapshot_header_t* header = (const ecs_snapshot_header_t*)blob;
+	if (blob_size < sizeof(ecs_snapshot_header_t) || header->magic != ECS_SNAPSHOT_MAGIC || header->format != ECS_SNAPSHOT_FORMAT || header->size > blob_size)
+		return false;
+	if (header->storage != (uint32_t)ecs->storage || header->max_entities != ecs->max_entities || header->num_component_types != ecs->component_descs.length())
+		return false;
+	if (header->num_free_entities > header->max_entities || header->num_tables > ecs->tables.capacity())
+		return false;
+	if (ecs->storage == ECS_STORAGE_ARRAYS && header->num_tables != ecs->tables.length())
+		return false;
+
+	if (!ecs_snapshot_in_range(header, header->entity_ids, header->max_entities * sizeof(entity_id_t))
+		|| !ecs_snapshot_in_range(header, header->free_entities, header->num_free_entities * sizeof(uint32_t))
+		|| !ecs_snapshot_in_range(header, header->signatures, header->max_entities * sizeof(ecs_signature_t))
+		|| (ecs->storage == ECS_STORAGE_ARCHETYPES && !ecs_snapshot_in_range(header, header->records, header->max_entities * sizeof(ecs_record_t)))
+		|| !ecs_snapshot_in_range(header, header->components, header->num_component_types * sizeof(ecs_snapshot_component_t))
+		|| !ecs_snapshot_in_range(header, header->tables, header->num_tables * sizeof(ecs_snapshot_table_t)))
+		return false;
+
+	const ecs_snapshot_component_t* components = (const ecs_snapshot_component_t*)(blob + header->components);
+	for (uint32_t i = 0; i < header->num_component_types; ++i)
+	{
+		const component_desc_t* desc = &ecs->component_descs[i];
+		const ecs_snapshot_component_t* component = &components[i];
+		if (component->component_size != desc->component_size || component->num_fields != desc->num_fields || component->shared != (uint32_t)desc->shared)
+			return false;
+		if (ecs->storage == ECS_STORAGE_ARRAYS && !desc->tag && !ecs_snapshot_in_range(header, component->rows, header->max_entities * sizeof(uint32_t)))
+			return false;
+		if (component->singleton && !ecs_snapshot_in_range(header, component->singleton, desc->component_size))
+			return false;
+		if (!desc->shared)
+			continue;
+		if (component->num_shared_values > desc->shared_lookup.capacity()
+			|| !ecs_snapshot_in_range(header, component->shared_values, (uint64_t)component->num_shared_values * desc->component_size)
+			|| !ecs_snapshot_in_range(header, component->shared_refs, component->num_shared_values * sizeof(uint32_t)))
+			return false;
+	}
+
+	const ecs_snapshot_table_t* tables = (const ecs_snapshot_table_t*)(blob + header->tables);
+	for (uint32_t i = 0; i < header->num_tables; ++i)
+	{
+		const ecs_snapshot_table_t* table = &tables[i];
+		if (table->num_columns > ECS_MAX_COMPONENTS_PER_ENTITY || table->rows_per_chunk == 0 || table->chunk_stride < table->chunk_size)
+			return false;
+		if (!ecs_snapshot_in_range(header, table->types, table->num_columns * sizeof(component_type_id_t))
+			|| !ecs_snapshot_in_range(header, table->shared_values, table->num_columns * sizeof(uint32_t)))
+			return false;
+		uint64_t num_chunks = (table->count + table->rows_per_chunk - 1) / table->rows_per_chunk;
+		if (!ecs_snapshot_in_range(header, table->chunks, num_chunks * table->chunk_stride))
+			return false;
+
+		const component_type_id_t* types = (const component_type_id_t*)(blob + table->types);
+		const uint32_t* shared_values = (const uint32_t*)(blob + table->shared_values);
+		for (uint32_t c = 0; c < table->num_columns; ++c)
+		{
+			if (types[c].id >= header->num_component_types || (c > 0 && types[c - 1].id >= types[c].id))
+				return false;
+			bool shared = components[types[c].id].shared != 0;
+			if (shared ? shared_values[c] >= components[types[c].id].num_shared_values : shared_values[c] != UINT32_MAX)
+				return false;
+		}
+
+		// The layout of a table only depends on its component types
+		if (ecs->storage == ECS_STORAGE_ARRAYS)
+		{
+			const ecs_table_t* existing = &ecs->tables[i];
+			if (table->num_columns != 1 || existing->columns[0].type.id != types[0].id || existing->chunk_size != table->chunk_size || existing->rows_per_chunk != table->rows_per_chunk)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+ecs_result_t ecs_snapshot_write(ecs_t* ecs, void* buffer, size_t buffer_size, size_t* out_size)
+{
+	ecs_snapshot_writer_t writer = { nullptr, 0 };
+	ecs_snapshot_emit(ecs, &writer);
+	*out_size = (size_t)writer.size;
+	if (buffer == nullptr)
+		return ECS_RESULT_OK;
+
+	ASSERT(buffer_size >= writer.size, "Snapshot buffer too small, %llu bytes needed", (unsigned long long)writer.size);
+	ASSERT(((uintptr_t)buffer & 15) == 0, "Snapshot buffer has to be 16 byte aligned");
+	writer.blob = (uint8_t*)buffer;
+	writer.size = 0;
+	ecs_snapshot_emit(ecs, &writer);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_snapshot_read(ecs_t* ecs, const void* buffer, size_t buffer_size)
+{
+	ASSERT(((uintptr_t)buffer & 15) == 0, "Snapshot buffer has to be 16 byte aligned");
+	const uint8_t* blob = (const uint8_t*)buffer;
+	if (!ecs_snapshot_validate(ecs, blob, buffer_size))
+		return ECS_RESULT_INVALID_SNAPSHOT;
+
+	const ecs_snapshot_header_t* header = (const ecs_snapshot_header_t*)blob;
+	const ecs_snapshot_component_t* components = (const ecs_snapshot_component_t*)(blob + header->components);
+	const ecs_snapshot_table_t* tables = (const ecs_snapshot_table_t*)(blob + header->tables);
+
+	for (size_t i = 0; i < ecs->tables.length(); ++i)
+		ecs_table_clear(ecs, &ecs->tables[i]);
+
+	memcpy(ecs->entity_ids, blob + header->entity_ids, header->max_entities * sizeof(entity_id_t));
+	memcpy(ecs->signatures, blob + header->signatures, header->max_entities * sizeof(ecs_signature_t));
+	ecs->entity_id_pool._num_free = header->num_free_entities;
+	memcpy(ecs->entity_id_pool._handles, blob + header->free_entities, header->num_free_entities * sizeof(uint32_t));
+
+	// Shared values keep their indices, archetypes refer to them
+	for (uint32_t i = 0; i < header->num_component_types; ++i)
+	{
+		component_desc_t* desc = &ecs->component_descs[i];
+		const ecs_snapshot_component_t* component = &components[i];
+		component_type_id_t type = { i };
+		if (component->singleton)
+			ecs_singleton_set(ecs, type, blob + component->singleton);
+		else
+		{
+			ALLOCATOR_FREE(ecs->allocator, desc->singleton);
+			desc->singleton = nullptr;
+		}
+		if (!desc->shared)
+			continue;
+
+		uint32_t num_values = component->num_shared_values;
+		desc->shared_refs.ensure_capacity(ecs->allocator, num_values);
+		desc->shared_refs.set_length(num_values);
+		desc->shared_values.ensure_capacity(ecs->allocator, num_values * desc->component_size);
+		desc->shared_values.set_length(num_values * desc->component_size);
+		memcpy(desc->shared_refs.begin(), blob + component->shared_refs, num_values * sizeof(uint32_t));
+		memcpy(desc->shared_values.begin(), blob + component->shared_values, num_values * desc->component_size);
+
+		desc->shared_lookup.clear();
+		desc->shared_free.clear();
+		for (uint32_t v = num_values; v-- > 0;)
+		{
+			if (desc->shared_refs[v])
+				ecs_shared_lookup_insert(ecs, type, v);
+			else
+				ecs_array_push(ecs->allocator, &desc->shared_free, v);
+		}
+	}
+
+	// Archetypes are created in whatever order entities needed them, so they can get other indices than when written
+	bool remapped = false;
+	for (uint32_t i = 0; i < header->num_tables; ++i)
+	{
+		const ecs_snapshot_table_t* snapshot_table = &tables[i];
+		uint32_t index = i;
+		if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+		{
+			index = ecs_archetype_find_or_create(ecs, (const component_type_id_t*)(blob + snapshot_table->types), snapshot_table->num_columns, (const uint32_t*)(blob + snapshot_table->shared_values));
+			remapped = remapped || index != i;
+		}
+
+		ecs_table_t* table = &ecs->tables[index];
+		ASSERT(table->chunk_size == snapshot_table->chunk_size && table->rows_per_chunk == snapshot_table->rows_per_chunk, "Table layout differs from the snapshot");
+		ecs_table_push_rows(ecs, table, snapshot_table->count);
+		for (size_t c = 0; c * table->rows_per_chunk < table->count; ++c)
+			memcpy(table->chunks[c], blob + snapshot_table->chunks + c * snapshot_table->chunk_stride, table->chunk_size);
+	}
+
+	if (ecs->storage == ECS_STORAGE_ARCHETYPES)
+	{
+		memcpy(ecs->records, blob + header->records, header->max_entities * sizeof(ecs_record_t));
+		if (remapped)
+		{
+			for (size_t t = 0; t < ecs->tables.length(); ++t)
+			{
+				ecs_table_t* table = &ecs->tables[t];
+				for (uint32_t row = 0; row < table->count; ++row)
+					ecs->records[ecs_entity_index(*ecs_table_eid(table, row))].table = (uint32_t)t;
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < header->num_component_types; ++i)
+		{
+			if (!ecs->component_descs[i].tag)
+				memcpy(ecs->component_descs[i].rows, blob + components[i].rows, header->max_entities * sizeof(uint32_t));
+		}
+	}
+
+	// Observers sort out what was added, removed or kept on their next flush
+	for (uint32_t i = 0; i < header->num_component_types; ++i)
+	{
+		component_type_id_t type = { i };
+		ecs_observe_all(ecs, type, ECS_OBSERVE_TOUCHED | ECS_OBSERVE_CHANGED);
+	}
+
+	return ECS_RESULT_OK;
+}
@@ -0,0 +1,273 @@
+#include "ecs_private.h"
+
+#include <foundation/bits.h>
+#include <foundation/job_system.h>
+#include <foundation/time.h>
+
+#include <cstring>
+
+static bool ecs_types_overlap(const component_type_id_t* a, uint32_t num_a, const component_type_id_t* b, uint32_t num_b)
+{
+	for (uint32_t i = 0; i < num_a; ++i)
+	{
+		for (uint32_t j = 0; j < num_b; ++j)
+		{
+			if (a[i].id == b[j].id)
+				return true;
+		}
+	}
+	return false;
+}
+
+static bool ecs_systems_conflict(const ecs_system_t* a, const ecs_system_t* b)
+{
+	return ecs_types_overlap(a->writes, a->num_writes, b->writes, b->num_writes)
+		|| ecs_types_overlap(a->writes, a->num_writes, b->reads, b->num_reads)
+		|| ecs_types_overlap(a->reads, a->num_reads, b->writes, b->num_writes);
+}
+
+static void ecs_system_join_job(job_context_t* /*context*/, void* /*arg*/)
+{
+}
+
+static void ecs_system_job(job_context_t* context, void* arg)
+{
+	ecs_system_job_arg_t* job_arg = (ecs_system_job_arg_t*)arg;
+	ecs_system_t* system = job_arg->system;
+
+	job_arg->times[0] = time_current();
+	if (job_arg->batches == nullptr)
+	{
+		system->func(context, nullptr, system->user_data);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < job_arg->num_batches; ++i)
+			system->func(context, &job_arg->batches[i], system->user_data);
+	}
+	job_arg->times[1] = time_current();
+}
+
+static void ecs_systems_update_schedule(ecs_t* ecs, uint64_t frame_start)
+{
+	ecs_schedule_t* schedule = &ecs->schedule;
+	uint32_t num_systems = static_cast<uint32_t>(schedule->systems.length());
+
+	// Longest chain of durations ending in each system, systems only wait for earlier ones
+	uint64_t finish[ECS_MAX_SYSTEMS];
+	uint32_t prev[ECS_MAX_SYSTEMS];
+	uint32_t last = UINT32_MAX;
+	for (uint32_t i = 0; i < num_systems; ++i)
+	{
+		const ecs_system_t* system = &schedule->systems[i];
+		ecs_system_info_t* info = &schedule->infos[i];
+		info->name = system->name;
+		info->level = system->level;
+		info->num_jobs = system->num_jobs;
+		info->start = 0;
+		info->duration = 0;
+		info->critical = false;
+
+		if (system->num_jobs > 0)
+		{
+			uint64_t start = UINT64_MAX;
+			uint64_t end = 0;
+			for (uint32_t j = 0; j < system->num_jobs; ++j)
+			{
+				start = system->job_times[j * 2] < start ? system->job_times[j * 2] : start;
+				end = system->job_times[j * 2 + 1] > end ? system->job_times[j * 2 + 1] : end;
+			}
+			info->start = start - frame_start;
+			info->duration = end - start;
+		}
+
+		finish[i] = 0;
+		prev[i] = UINT32_MAX;
+		for (uint64_t preds = system->preds; preds; preds &= preds - 1)
+		{
+			uint32_t p = bits_lsb(preds);
+			if (prev[i] == UINT32_MAX || finish[p] > finish[i])
+			{
+				finish[i] = finish[p];
+				prev[i] = p;
+			}
+		}
+		finish[i] += info->duration;
+
+		if (last == UINT32_MAX || finish[i] > finish[last])
+			last = i;
+	}
+
+	schedule->num_critical_path = 0;
+	schedule->critical_path_time = last != UINT32_MAX ? finish[last] : 0;
+	for (uint32_t i = last; i != UINT32_MAX; i = prev[i])
+	{
+		schedule->infos[i].critical = true;
+		schedule->critical_path[schedule->num_critical_path++] = i;
+	}
+	for (uint32_t i = 0; i < schedule->num_critical_path / 2; ++i)
+	{
+		uint32_t tmp = schedule->critical_path[i];
+		schedule->critical_path[i] = schedule->critical_path[schedule->num_critical_path - 1 - i];
+		schedule->critical_path[schedule->num_critical_path - 1 - i] = tmp;
+	}
+}
+
+void ecs_systems_destroy(ecs_t* ecs)
+{
+	ecs_schedule_t* schedule = &ecs->schedule;
+	for (size_t i = 0; i < schedule->systems.length(); ++i)
+	{
+		ALLOCATOR_FREE(ecs->allocator, schedule->systems[i].job_args);
+		ALLOCATOR_FREE(ecs->allocator, schedule->systems[i].job_times);
+	}
+	schedule->systems.destroy(ecs->allocator);
+}
+
+ecs_result_t ecs_system_register(ecs_t* ecs, const ecs_system_create_info_t* create_info, ecs_system_id_t* out_id)
+{
+	ASSERT(create_info->func != nullptr);
+	ASSERT(create_info->num_reads <= ECS_MAX_QUERY_COMPONENTS && create_info->num_writes <= ECS_MAX_QUERY_COMPONENTS, "Too many components in system");
+
+	ecs_schedule_t* schedule = &ecs->schedule;
+	if (schedule->systems.capacity() == 0)
+		schedule->systems.create(ecs->allocator, ECS_MAX_SYSTEMS);
+	ASSERT(!schedule->systems.full(), "Out of systems");
+
+	uint32_t sid = static_cast<uint32_t>(schedule->systems.length());
+	schedule->systems.set_length(sid + 1);
+	ecs_system_t* system = &schedule->systems[sid];
+	memset(system, 0, sizeof(ecs_system_t));
+	system->name = create_info->name;
+	system->num_reads = create_info->num_reads;
+	system->num_writes = create_info->num_writes;
+	if (create_info->num_reads)
+		memcpy(system->reads, create_info->reads, create_info->num_reads * sizeof(component_type_id_t));
+	if (create_info->num_writes)
+		memcpy(system->writes, create_info->writes, create_info->num_writes * sizeof(component_type_id_t));
+	system->query = create_info->query;
+	system->func = create_info->func;
+	system->user_data = create_info->user_data;
+	system->max_jobs = create_info->query && create_info->max_jobs ? create_info->max_jobs : 1;
+	system->job_args = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, system->max_jobs, ecs_system_job_arg_t);
+	system->job_times = ALLOCATOR_ALLOC_ARRAY(ecs->allocator, system->max_jobs * 2, uint64_t);
+
+	// Whatever the system writes through its query counts as changed
+	ecs_query_t* query = create_info->query;
+	for (uint32_t i = 0; query && i < create_info->num_writes; ++i)
+	{
+		for (uint32_t j = 0; j < query->num_with + query->num_optional; ++j)
+		{
+			component_type_id_t type = j < query->num_with ? query->with[j] : query->optional[j - query->num_with];
+			if (type.id == create_info->writes[i].id)
+				query->write_mask |= 1U << j;
+		}
+	}
+
+	for (uint32_t i = 0; i < sid; ++i)
+	{
+		const ecs_system_t* other = &schedule->systems[i];
+		if (ecs_systems_conflict(other, system))
+		{
+			system->preds |= 1ULL << i;
+			if (other->level + 1 > system->level)
+				system->level = other->level + 1;
+		}
+	}
+
+	out_id->id = sid;
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_systems_run(ecs_t* ecs, job_system_t* job_system)
+{
+	ecs_schedule_t* schedule = &ecs->schedule;
+	uint32_t num_systems = static_cast<uint32_t>(schedule->systems.length());
+	uint64_t frame_start = time_current();
+
+	for (uint32_t i = 0; i < num_systems; ++i)
+	{
+		ecs_system_t* system = &schedule->systems[i];
+
+		// A job only has a single event to wait for, so join several preds into one
+		job_event_t* depends = nullptr;
+		system->join = nullptr;
+		if (system->preds != 0 && bits_is_pow2(system->preds))
+		{
+			depends = schedule->systems[bits_lsb(system->preds)].done;
+		}
+		else if (system->preds != 0)
+		{
+			job_system_acquire_event(job_system, &system->join);
+			for (uint64_t preds = system->preds; preds; preds &= preds - 1)
+				job_system_kick_ptr(job_system, ecs_system_join_job, 1, (void**)nullptr, 0, schedule->systems[bits_lsb(preds)].done, system->join);
+			depends = system->join;
+		}
+
+		if (system->query)
+		{
+			ecs_query_set_changed_since(system->query, system->last_version);
+			system->num_jobs = ecs_query_prepare_jobs(ecs, system->query, system->max_jobs, system->func, system->user_data);
+			system->last_version = ecs_get_version(ecs);
+			for (uint32_t j = 0; j < system->num_jobs; ++j)
+			{
+				system->job_args[j].system = system;
+				system->job_args[j].batches = system->query->job_args[j].batches;
+				system->job_args[j].num_batches = system->query->job_args[j].num_batches;
+				system->job_args[j].times = &system->job_times[j * 2];
+			}
+		}
+		else
+		{
+			system->num_jobs = 1;
+			system->job_args[0].system = system;
+			system->job_args[0].batches = nullptr;
+			system->job_args[0].num_batches = 0;
+			system->job_args[0].times = &system->job_times[0];
+		}
+
+		job_system_acquire_event(job_system, &system->done);
+		job_system_result_t res = job_system_kick_ptr(job_system, ecs_system_job, system->num_jobs, system->job_args, depends, system->done);
+		ASSERT(res == JOB_SYSTEM_OK);
+		(void)res;
+	}
+
+	for (uint32_t i = 0; i < num_systems; ++i)
+	{
+		ecs_system_t* system = &schedule->systems[i];
+		job_system_wait_event(job_system, system->done);
+		if (system->join)
+			job_system_wait_event(job_system, system->join);
+		if (system->query)
+			ecs_query_observe_batches(ecs, system->query);
+	}
+	schedule->frame_time = time_current() - frame_start;
+
+	for (uint32_t i = 0; i < num_systems; ++i)
+	{
+		ecs_system_t* system = &schedule->systems[i];
+		job_system_release_event(job_system, system->done);
+
+		// The join event was the result of one kick per pred
+		if (system->join)
+		{
+			for (uint64_t preds = system->preds; preds; preds &= preds - 1)
+				job_system_release_event(job_system, system->join);
+		}
+	}
+
+	ecs_systems_update_schedule(ecs, frame_start);
+	return ECS_RESULT_OK;
+}
+
+ecs_result_t ecs_systems_get_schedule(ecs_t* ecs, ecs_schedule_info_t* out_info)
+{
+	ecs_schedule_t* schedule = &ecs->schedule;
+	out_info->num_systems = static_cast<uint32_t>(schedule->systems.length());
+	out_info->systems = schedule->infos;
+	out_info->frame_time = schedule->frame_time;
+	out_info->critical_path_time = schedule->critical_path_time;
+	out_info->num_critical_path = schedule->num_critical_path;
+	out_info->critical_path = schedule->critical_path;
+	return ECS_RESULT_OK;
+}
@@ -0,0 +1,628 @@
+#include <game/spatial.h>
+
+#include <foundation/allocator.h>
+#include <foundation/array.h>
+#include <foundation/assert.h>
+#include <foundation/bits.h>
+#include <foundation/table.h>
+
+#include <cmath>
+#include <cstring>
+
+#if defined(SIMD_SSE) || defined(SIMD_AVX2)
+#	include <xmmintrin.h>
+#	define SPATIAL_SSE
+#endif
+
+#define SPATIAL_BLOCK_SIZE (16)
+#define SPATIAL_COORD_BIAS (1 << 20) // Cell coordinates are packed in 21 bits each
+
+/**
+ * Bounds of up to SPATIAL_BLOCK_SIZE entities of one cell, one array per
+ * side of the boxes. Only the first block of a cell can be partially filled.
+ */
+struct spatial_block_t
+{
+	float bounds[6][SPATIAL_BLOCK_SIZE]; // Min x, y, z followed by max x, y, z
+	entity_id_t eids[SPATIAL_BLOCK_SIZE];
+	uint32_t cell;
+	uint32_t next;
+	uint32_t count;
+};
+
+struct spatial_cell_t
+{
+	uint64_t key;
+	int32_t coords[3];
+	uint32_t first_block;
+};
+
+struct spatial_grid_t
+{
+	allocator_t* allocator;
+	uint32_t max_entities;
+	uint32_t max_cells;
+	float cell_size;
+	float inv_cell_size;
+	float max_half_extent; // Largest half extent of any box so far, queries are grown by this much
+
+	uint32_t* locations; // Entity index to block * SPATIAL_BLOCK_SIZE + slot, UINT32_MAX when not in the grid
+
+	// Occupied cells are kept dense, the table maps a packed cell coordinate to its index
+	uint32_t num_cells;
+	spatial_cell_t* cells;
+	table_t<uint64_t, uint32_t> cell_lookup;
+
+	array_t<spatial_block_t> blocks;
+	array_t<uint32_t> free_blocks;
+};
+
+/******************************************************************************\
+*
+*  Cells and blocks
+*
+\******************************************************************************/
+
+static int32_t spatial_coord(const spatial_grid_t* grid, float v)
+{
+	float c = floorf(v * grid->inv_cell_size);
+	c = c < -(float)SPATIAL_COORD_BIAS ? -(float)SPATIAL_COORD_BIAS : c;
+	c = c > (float)(SPATIAL_COORD_BIAS - 1) ? (float)(SPATIAL_COORD_BIAS - 1) : c;
+	return (int32_t)c;
+}
+
+static uint64_t spatial_cell_key(const int32_t coords[3])
+{
+	return (uint64_t)(coords[0] + SPATIAL_COORD_BIAS)
+		| ((uint64_t)(coords[1] + SPATIAL_COORD_BIAS) << 21)
+		| ((uint64_t)(coords[2] + SPATIAL_COORD_BIAS) << 42);
+}
+
+static void spatial_center_coords(const spatial_grid_t* grid, const spatial_aabb_t* aabb, int32_t out_coords[3])
+{
+	for (int i = 0; i < 3; ++i)
+		out_coords[i] = spatial_coord(grid, (aabb->min[i] + aabb->max[i]) * 0.5f);
+}
+
+static uint32_t spatial_block_alloc(spatial_grid_t* grid)
+{
+	if (grid->free_blocks.any())
+	{
+		uint32_t block = grid->free_blocks.back();
+		grid->free_blocks.remove_back();
+		return block;
+	}
+	if (grid->blocks.full())
+	{
+		grid->blocks.grow(grid->allocator);
+		grid->free_blocks.set_capacity(grid->allocator, grid->blocks.capacity());
+	}
+	grid->blocks.set_length(grid->blocks.length() + 1);
+	return (uint32_t)grid->blocks.length() - 1;
+}
+
+static uint32_t spatial_cell_find_or_create(spatial_grid_t* grid, const int32_t coords[3])
+{
+	uint64_t key = spatial_cell_key(coords);
+	uint32_t* found = grid->cell_lookup.fetch(key);
+	if (found)
+		return *found;
+
+	ASSERT(grid->num_cells < grid->max_cells, "Out of spatial grid cells");
+	uint32_t cell = grid->num_cells++;
+	grid->cells[cell].key = key;
+	memcpy(grid->cells[cell].coords, coords, sizeof(grid->cells[cell].coords));
+	grid->cells[cell].first_block = UINT32_MAX;
+	grid->cell_lookup.insert(key, cell);
+	return cell;
+}
+
+/**
+ * Moves the last cell into the hole, its blocks are pointed to the new index.
+ */
+static void spatial_cell_remove(spatial_grid_t* grid, uint32_t cell)
+{
+	grid->cell_lookup.remove(grid->cells[cell].key);
+	uint32_t last = --grid->num_cells;
+	if (cell == last)
+		return;
+
+	grid->cells[cell] = grid->cells[last];
+	grid->cell_lookup.insert(grid->cells[cell].key, cell);
+	for (uint32_t block = grid->cells[cell].first_block; block != UINT32_MAX; block = grid->blocks[block].next)
+		grid->blocks[block].cell = cell;
+}
+
+static void spatial_block_write(spatial_block_t* block, uint32_t slot, const spatial_aabb_t* aabb)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		block->bounds[i][slot] = aabb->min[i];
+		block->bounds[3 + i][slot] = aabb->max[i];
+	}
+}
+
+static void spatial_link(spatial_grid_t* grid, entity_id_t eid, const spatial_aabb_t* aabb)
+{
+	int32_t coords[3];
+	spatial_center_coords(grid, aabb, coords);
+	uint32_t cell = spatial_cell_find_or_create(grid, coords);
+
+	uint32_t head = grid->cells[cell].first_block;
+	if (head == UINT32_MAX || grid->blocks[head].count == SPATIAL_BLOCK_SIZE)
+	{
+		uint32_t block = spatial_block_alloc(grid);
+		grid->blocks[block].cell = cell;
+		grid->blocks[block].next = head;
+		grid->blocks[block].count = 0;
+		grid->cells[cell].first_block = block;
+		head = block;
+	}
+
+	spatial_block_t* block = &grid->blocks[head];
+	uint32_t slot = block->count++;
+	block->eids[slot] = eid;
+	spatial_block_write(block, slot, aabb);
+	grid->locations[ecs_entity_index(eid)] = head * SPATIAL_BLOCK_SIZE + slot;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float half_extent = (aabb->max[i] - aabb->min[i]) * 0.5f;
+		if (half_extent > grid->max_half_extent)
+			grid->max_half_extent = half_extent;
+	}
+}
+
+/**
+ * Fills the slot with the last entry of the first block of the cell, which
+ * is the only block with free slots.
+ */
+static void spatial_unlink(spatial_grid_t* grid, uint32_t location)
+{
+	uint32_t block = location / SPATIAL_BLOCK_SIZE;
+	uint32_t slot = location % SPATIAL_BLOCK_SIZE;
+	uint32_t cell = grid->blocks[block].cell;
+	uint32_t head = grid->cells[cell].first_block;
+	spatial_block_t* dst = &grid->blocks[block];
+	spatial_block_t* src = &grid->blocks[head];
+	grid->locations[ecs_entity_index(dst->eids[slot])] = UINT32_MAX;
+
+	uint32_t last = --src->count;
+	if (head != block || last != slot)
+	{
+		dst->eids[slot] = src->eids[last];
+		for (int i = 0; i < 6; ++i)
+			dst->bounds[i][slot] = src->bounds[i][last];
+		grid->locations[ecs_entity_index(dst->eids[slot])] = location;
+	}
+
+	if (src->count == 0)
+	{
+		grid->cells[cell].first_block = src->next;
+		grid->free_blocks.append(head);
+		if (grid->cells[cell].first_block == UINT32_MAX)
+			spatial_cell_remove(grid, cell);
+	}
+}
+
+static uint32_t spatial_find(const spatial_grid_t* grid, entity_id_t eid)
+{
+	uint32_t index = ecs_entity_index(eid);
+	ASSERT(index < grid->max_entities, "Entity index out of range for the spatial grid");
+	uint32_t location = grid->locations[index];
+	if (location == UINT32_MAX || grid->blocks[location / SPATIAL_BLOCK_SIZE].eids[location % SPATIAL_BLOCK_SIZE].id != eid.id)
+		return UINT32_MAX;
+	return location;
+}
+
+/******************************************************************************\
+*
+*  Box tests, each gives a bit per entry in a group of four
+*
+\******************************************************************************/
+
+struct spatial_test_aabb_t
+{
+	float bounds[6];
+#if defined(SPATIAL_SSE)
+	__m128 qmin[3];
+	__m128 qmax[3];
+#endif
+
+	explicit spatial_test_aabb_t(const spatial_aabb_t* aabb)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			bounds[i] = aabb->min[i];
+			bounds[3 + i] = aabb->max[i];
+#if defined(SPATIAL_SSE)
+			qmin[i] = _mm_set1_ps(aabb->min[i]);
+			qmax[i] = _mm_set1_ps(aabb->max[i]);
+#endif
+		}
+	}
+
+	uint32_t test(const spatial_block_t* block, uint32_t first) const
+	{
+#if defined(SPATIAL_SSE)
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int i = 0; i < 3; ++i)
+		{
+			inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_loadu_ps(&block->bounds[i][first]), qmax[i]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_loadu_ps(&block->bounds[3 + i][first]), qmin[i]));
+		}
+		return (uint32_t)_mm_movemask_ps(inside);
+#else
+		uint32_t mask = 0;
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			bool inside = true;
+			for (int i = 0; i < 3; ++i)
+				inside = inside && block->bounds[i][first + j] <= bounds[3 + i] && block->bounds[3 + i][first + j] >= bounds[i];
+			mask |= inside ? 1U << j : 0;
+		}
+		return mask;
+#endif
+	}
+};
+
+struct spatial_test_sphere_t
+{
+	float center[3];
+	float radius_sq;
+#if defined(SPATIAL_SSE)
+	__m128 c[3];
+	__m128 r2;
+#endif
+
+	spatial_test_sphere_t(const float in_center[3], float radius)
+	{
+		radius_sq = radius * radius;
+		for (int i = 0; i < 3; ++i)
+			center[i] = in_center[i];
+#if defined(SPATIAL_SSE)
+		for (int i = 0; i < 3; ++i)
+			c[i] = _mm_set1_ps(in_center[i]);
+		r2 = _mm_set1_ps(radius_sq);
+#endif
+	}
+
+	// Squared distance from the center to the closest point of each box
+	uint32_t test(const spatial_block_t* block, uint32_t first) const
+	{
+#if defined(SPATIAL_SSE)
+		__m128 zero = _mm_setzero_ps();
+		__m128 dist_sq = zero;
+		for (int i = 0; i < 3; ++i)
+		{
+			__m128 below = _mm_sub_ps(_mm_loadu_ps(&block->bounds[i][first]), c[i]);
+			__m128 above = _mm_sub_ps(c[i], _mm_loadu_ps(&block->bounds[3 + i][first]));
+			__m128 d = _mm_max_ps(_mm_max_ps(below, above), zero);
+			dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(d, d));
+		}
+		return (uint32_t)_mm_movemask_ps(_mm_cmple_ps(dist_sq, r2));
+#else
+		uint32_t mask = 0;
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			float dist_sq = 0.0f;
+			for (int i = 0; i < 3; ++i)
+			{
+				float below = block->bounds[i][first + j] - center[i];
+				float above = center[i] - block->bounds[3 + i][first + j];
+				float d = below > above ? below : above;
+				d = d > 0.0f ? d : 0.0f;
+				dist_sq += d * d;
+			}
+			mask |= dist_sq <= radius_sq ? 1U << j : 0;
+		}
+		return mask;
+#endif
+	}
+};
+
+struct spatial_test_frustum_t
+{
+	const spatial_frustum_t* frustum;
+	int side[6][3]; // Bounds array of the corner furthest along each plane normal
+#if defined(SPATIAL_SSE)
+	__m128 n[6][3];
+	__m128 d[6];
+#endif
+
+	explicit spatial_test_frustum_t(const spatial_frustum_t* in_frustum)
+	{
+		frustum = in_frustum;
+		for (int p = 0; p < 6; ++p)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				side[p][i] = frustum->planes[p][i] >= 0.0f ? 3 + i : i;
+#if defined(SPATIAL_SSE)
+				n[p][i] = _mm_set1_ps(frustum->planes[p][i]);
+#endif
+			}
+#if defined(SPATIAL_SSE)
+			d[p] = _mm_set1_ps(frustum->planes[p][3]);
+#endif
+		}
+	}
+
+	bool test_box(const float min[3], const float max[3]) const
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			const float* plane = frustum->planes[p];
+			float dist = plane[3];
+			for (int i = 0; i < 3; ++i)
+				dist += plane[i] * (plane[i] >= 0.0f ? max[i] : min[i]);
+			if (dist < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	uint32_t test(const spatial_block_t* block, uint32_t first) const
+	{
+#if defined(SPATIAL_SSE)
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 dist = d[p];
+			for (int i = 0; i < 3; ++i)
+				dist = _mm_add_ps(dist, _mm_mul_ps(n[p][i], _mm_loadu_ps(&block->bounds[side[p][i]][first])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+		return (uint32_t)_mm_movemask_ps(inside);
+#else
+		uint32_t mask = 0;
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; ++p)
+			{
+				float dist = frustum->planes[p][3];
+				for (int i = 0; i < 3; ++i)
+					dist += frustum->planes[p][i] * block->bounds[side[p][i]][first + j];
+				inside = dist >= 0.0f;
+			}
+			mask |= inside ? 1U << j : 0;
+		}
+		return mask;
+#endif
+	}
+};
+
+struct spatial_results_t
+{
+	uint32_t max_results;
+	entity_id_t* eids;
+	uint32_t count;
+};
+
+template<class T>
+static void spatial_query_cell(const spatial_grid_t* grid, const spatial_cell_t* cell, const T& test, spatial_results_t* results)
+{
+	for (uint32_t b = cell->first_block; b != UINT32_MAX; b = grid->blocks[b].next)
+	{
+		const spatial_block_t* block = &grid->blocks[b];
+		for (uint32_t first = 0; first < block->count; first += 4)
+		{
+			uint32_t mask = test.test(block, first);
+			if (block->count - first < 4)
+				mask &= (1U << (block->count - first)) - 1;
+			for (; mask; mask &= mask - 1)
+			{
+				if (results->count < results->max_results)
+					results->eids[results->count] = block->eids[first + bits_lsb(mask)];
+				++results->count;
+			}
+		}
+	}
+}
+
+/**
+ * Visits the cells that can hold a box overlapping bounds, either by looking
+ * up each cell in range or by going through all cells when that is fewer.
+ */
+template<class T>
+static void spatial_query_range(const spatial_grid_t* grid, const float min[3], const float max[3], const T& test, spatial_results_t* results)
+{
+	int32_t lo[3];
+	int32_t hi[3];
+	double num_in_range = 1.0;
+	for (int i = 0; i < 3; ++i)
+	{
+		lo[i] = spatial_coord(grid, min[i] - grid->max_half_extent);
+		hi[i] = spatial_coord(grid, max[i] + grid->max_half_extent);
+		num_in_range *= (double)(hi[i] - lo[i] + 1);
+	}
+
+	if (num_in_range > (double)grid->num_cells)
+	{
+		for (uint32_t c = 0; c < grid->num_cells; ++c)
+		{
+			const spatial_cell_t* cell = &grid->cells[c];
+			if (cell->coords[0] >= lo[0] && cell->coords[0] <= hi[0] && cell->coords[1] >= lo[1] && cell->coords[1] <= hi[1] && cell->coords[2] >= lo[2] && cell->coords[2] <= hi[2])
+				spatial_query_cell(grid, cell, test, results);
+		}
+		return;
+	}
+
+	// The table is not const correct, lookups do not change it
+	table_t<uint64_t, uint32_t>* lookup = const_cast<table_t<uint64_t, uint32_t>*>(&grid->cell_lookup);
+	int32_t coords[3];
+	for (coords[2] = lo[2]; coords[2] <= hi[2]; ++coords[2])
+	{
+		for (coords[1] = lo[1]; coords[1] <= hi[1]; ++coords[1])
+		{
+			for (coords[0] = lo[0]; coords[0] <= hi[0]; ++coords[0])
+			{
+				const uint32_t* cell = lookup->fetch(spatial_cell_key(coords));
+				if (cell)
+					spatial_query_cell(grid, &grid->cells[*cell], test, results);
+			}
+		}
+	}
+}
+
+/******************************************************************************\
+*
+*  Spatial grid operations
+*
+\******************************************************************************/
+
+spatial_result_t spatial_grid_create(const spatial_grid_create_info_t* create_info, spatial_grid_t** out_grid)
+{
+	ASSERT(create_info->cell_size > 0.0f);
+	ASSERT(create_info->max_cells > 0);
+
+	spatial_grid_t* grid = ALLOCATOR_ALLOC_TYPE(create_info->allocator, spatial_grid_t);
+	memset(grid, 0, sizeof(spatial_grid_t));
+	grid->allocator = create_info->allocator;
+	grid->max_entities = create_info->max_entities;
+	grid->max_cells = create_info->max_cells;
+	grid->cell_size = create_info->cell_size;
+	grid->inv_cell_size = 1.0f / create_info->cell_size;
+
+	grid->locations = ALLOCATOR_ALLOC_ARRAY(grid->allocator, create_info->max_entities, uint32_t);
+	memset(grid->locations, 0xFF, create_info->max_entities * sizeof(uint32_t));
+	grid->cells = ALLOCATOR_ALLOC_ARRAY(grid->allocator, create_info->max_cells, spatial_cell_t);
+	grid->cell_lookup.create(grid->allocator, create_info->max_cells, create_info->max_cells | 1);
+	grid->blocks.create(grid->allocator, 64);
+	grid->free_blocks.create(grid->allocator, 64);
+
+	*out_grid = grid;
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_destroy(spatial_grid_t* grid)
+{
+	allocator_t* allocator = grid->allocator;
+	ALLOCATOR_FREE(allocator, grid->locations);
+	ALLOCATOR_FREE(allocator, grid->cells);
+	grid->cell_lookup.destroy(allocator);
+	grid->blocks.destroy(allocator);
+	grid->free_blocks.destroy(allocator);
+	ALLOCATOR_FREE(allocator, grid);
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_insert(spatial_grid_t* grid, entity_id_t eid, const spatial_aabb_t* aabb)
+{
+	ASSERT(ecs_entity_index(eid) < grid->max_entities, "Entity index out of range for the spatial grid");
+	if (grid->locations[ecs_entity_index(eid)] != UINT32_MAX)
+		return SPATIAL_RESULT_ENTITY_EXISTS;
+
+	spatial_link(grid, eid, aabb);
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_remove(spatial_grid_t* grid, entity_id_t eid)
+{
+	uint32_t location = spatial_find(grid, eid);
+	if (location == UINT32_MAX)
+		return SPATIAL_RESULT_NO_SUCH_ENTITY;
+
+	spatial_unlink(grid, location);
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_update(spatial_grid_t* grid, entity_id_t eid, const spatial_aabb_t* aabb)
+{
+	uint32_t location = spatial_find(grid, eid);
+	if (location == UINT32_MAX)
+		return SPATIAL_RESULT_NO_SUCH_ENTITY;
+
+	spatial_block_t* block = &grid->blocks[location / SPATIAL_BLOCK_SIZE];
+	int32_t coords[3];
+	spatial_center_coords(grid, aabb, coords);
+	const spatial_cell_t* cell = &grid->cells[block->cell];
+	if (coords[0] != cell->coords[0] || coords[1] != cell->coords[1] || coords[2] != cell->coords[2])
+	{
+		spatial_unlink(grid, location);
+		spatial_link(grid, eid, aabb);
+		return SPATIAL_RESULT_OK;
+	}
+
+	spatial_block_write(block, location % SPATIAL_BLOCK_SIZE, aabb);
+	for (int i = 0; i < 3; ++i)
+	{
+		float half_extent = (aabb->max[i] - aabb->min[i]) * 0.5f;
+		if (half_extent > grid->max_half_extent)
+			grid->max_half_extent = half_extent;
+	}
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_update_batch(spatial_grid_t* grid, uint32_t count, const entity_id_t* eids, const spatial_aabb_t* aabbs)
+{
+	spatial_result_t result = SPATIAL_RESULT_OK;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (spatial_grid_update(grid, eids[i], &aabbs[i]) != SPATIAL_RESULT_OK)
+			result = SPATIAL_RESULT_NO_SUCH_ENTITY;
+	}
+	return result;
+}
+
+spatial_result_t spatial_grid_get(const spatial_grid_t* grid, entity_id_t eid, spatial_aabb_t* out_aabb)
+{
+	uint32_t location = spatial_find(grid, eid);
+	if (location == UINT32_MAX)
+		return SPATIAL_RESULT_NO_SUCH_ENTITY;
+
+	const spatial_block_t* block = &grid->blocks[location / SPATIAL_BLOCK_SIZE];
+	uint32_t slot = location % SPATIAL_BLOCK_SIZE;
+	for (int i = 0; i < 3; ++i)
+	{
+		out_aabb->min[i] = block->bounds[i][slot];
+		out_aabb->max[i] = block->bounds[3 + i][slot];
+	}
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_query_aabb(const spatial_grid_t* grid, const spatial_aabb_t* aabb, uint32_t max_results, entity_id_t* out_eids, uint32_t* out_count)
+{
+	spatial_results_t results = { max_results, out_eids, 0 };
+	spatial_test_aabb_t test(aabb);
+	spatial_query_range(grid, aabb->min, aabb->max, test, &results);
+	*out_count = results.count;
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_query_sphere(const spatial_grid_t* grid, const float center[3], float radius, uint32_t max_results, entity_id_t* out_eids, uint32_t* out_count)
+{
+	spatial_results_t results = { max_results, out_eids, 0 };
+	spatial_test_sphere_t test(center, radius);
+	float min[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+	float max[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+	spatial_query_range(grid, min, max, test, &results);
+	*out_count = results.count;
+	return SPATIAL_RESULT_OK;
+}
+
+spatial_result_t spatial_grid_query_frustum(const spatial_grid_t* grid, const spatial_frustum_t* frustum, uint32_t max_results, entity_id_t* out_eids, uint32_t* out_count)
+{
+	spatial_results_t results = { max_results, out_eids, 0 };
+	spatial_test_frustum_t test(frustum);
+
+	// A frustum has no useful range of cells, cull whole cells by their loose bounds first
+	float margin = grid->max_half_extent;
+	for (uint32_t c = 0; c < grid->num_cells; ++c)
+	{
+		const spatial_cell_t* cell = &grid->cells[c];
+		float min[3];
+		float max[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			min[i] = (float)cell->coords[i] * grid->cell_size - margin;
+			max[i] = (float)(cell->coords[i] + 1) * grid->cell_size + margin;
+		}
+		if (test.test_box(min, max))
+			spatial_query_cell(grid, cell, test, &results);
+	}
+
+	*out_count = results.count;
+	return SPATIAL_RESULT_OK;
+}
@@ -29,6 +29,7 @@ function Unit.AddTools(self)
 		end)
 	end
 
+	-- all compilers sharing a manifest check the names they hash for collisions across assets
 	local function AddCompiler(name, extension)
 		AddTool(function (settings)
 			settings[name] = {}
@@ -38,7 +39,8 @@ function Unit.AddTools(self)
 				local outfile = PathJoin(target.outdir, infile)
 				local compiler = settings[name]
 				local exe = compiler.exe
-				local cmd = exe .. " -o " .. outfile .. " " .. infile
+				local manifest = PathJoin(target.outdir, "hash_manifest.txt")
+				local cmd = exe .. " -m " .. manifest .. " -o " .. outfile .. " " .. infile
 
 				AddJob(outfile, name .. " " .. infile, cmd)
 				AddDependency(outfile, exe)
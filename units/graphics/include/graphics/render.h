@@ -233,6 +233,14 @@ void render_instance_destroy(render_t* render, render_instance_id_t instance_id)
 
 render_result_t render_instance_set_data(render_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data);
 
+/**
+ * Points out_data[i] at where the backend keeps the data of instance i, to be
+ * written in place instead of copied in with render_instance_set_data. The
+ * pointers are valid until the next instance is created or destroyed, the
+ * data is read by the next render_kick_render.
+ */
+render_result_t render_instance_map_data(render_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data);
+
 void render_kick_render(render_t* render, render_view_id_t view_id, render_script_id_t script_id); // TODO: multiple views (stereo, shadow, etc)
 
 void render_kick_upload(render_t* render);
@@ -38,6 +38,7 @@ int main(int argc, const char** argv)
 	{
 		{ "help",   'h', GETOPT_OPTION_TYPE_NO_ARG,   0x0, 'h', "displays this message", 0x0 },
 		{ "output", 'o', GETOPT_OPTION_TYPE_REQUIRED, 0x0, 'o', "output to file", "file" },
+		{ "manifest", 'm', GETOPT_OPTION_TYPE_REQUIRED, 0x0, 'm', "check hashed names for collisions with all names in manifest and add them to it", "file" },
 		GETOPT_OPTIONS_END
 	};
 
@@ -46,6 +47,7 @@ int main(int argc, const char** argv)
 
 	const char* infilename = NULL;
 	const char* outfilename = NULL;
+	const char* manifestname = NULL;
 
 	int opt;
 	while( (opt = getopt_next( &go_ctx ) ) != -1 )
@@ -61,6 +63,9 @@ int main(int argc, const char** argv)
 
 				outfilename = go_ctx.current_opt_arg;
 				break;
+			case 'm':
+				manifestname = go_ctx.current_opt_arg;
+				break;
 			case '+':
 				if(infilename != NULL && infilename[0] != '\0')
 				{
@@ -100,9 +105,19 @@ int main(int argc, const char** argv)
 	uint32_t num_properties = material_intermediate->properties.count;
 	material_property_t* properties = (material_property_t*)alloca(num_properties * sizeof(material_property_t));
 
+	if (manifestname != NULL)
+	{
+		const char** names = (const char**)alloca((num_properties + 1) * sizeof(const char*));
+		for (size_t i = 0; i < num_properties; ++i)
+			names[i] = material_intermediate->properties[i].name;
+		names[num_properties] = material_intermediate->shader_name;
+		if (!hash_manifest_add(manifestname, names, num_properties + 1))
+			ERROR_AND_FAIL("a property or shader name of \"%s\" collides with another name", infilename);
+	}
+
 	for (size_t i = 0; i < num_properties; ++i)
 	{
-		properties[i].name_hash = hash_string(material_intermediate->properties[i].name);
+		properties[i].name_hash = hash_string_64(material_intermediate->properties[i].name);
 		if (material_intermediate->properties[i].path != nullptr)
 		{
 			properties[i].value.data = nullptr;
@@ -118,7 +133,7 @@ int main(int argc, const char** argv)
 	material_data_t material_data =
 	{
 		{ properties, num_properties },
-		hash_string(material_intermediate->shader_name)
+		hash_string_64(material_intermediate->shader_name)
 	};
 
 	err = dl_util_store_to_file(
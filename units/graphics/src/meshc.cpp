@@ -48,6 +48,7 @@ int main(int argc, const char** argv)
 	{
 		{ "help",   'h', GETOPT_OPTION_TYPE_NO_ARG,   0x0, 'h', "displays this message", 0x0 },
 		{ "output", 'o', GETOPT_OPTION_TYPE_REQUIRED, 0x0, 'o', "output to file", "file" },
+		{ "manifest", 'm', GETOPT_OPTION_TYPE_REQUIRED, 0x0, 'm', "check hashed names for collisions with all names in manifest and add them to it", "file" },
 		GETOPT_OPTIONS_END
 	};
 
@@ -56,6 +57,7 @@ int main(int argc, const char** argv)
 
 	const char* infilename = nullptr;
 	const char* outfilename = nullptr;
+	const char* manifestname = nullptr;
 
 	int opt;
 	while( (opt = getopt_next( &go_ctx ) ) != -1 )
@@ -69,6 +71,9 @@ int main(int argc, const char** argv)
 
 				outfilename = go_ctx.current_opt_arg;
 				break;
+			case 'm':
+				manifestname = go_ctx.current_opt_arg;
+				break;
 			case '+':
 				if(infilename != nullptr && infilename[0] != '\0')
 					ERROR_AND_FAIL("input file already set to: \"%s\", trying to set it to \"%s\"", infilename, go_ctx.current_opt_arg);
@@ -103,7 +108,10 @@ int main(int argc, const char** argv)
 	if(err != DL_ERROR_OK)
 		ERROR_AND_FAIL("failed to load intermediate mesh from file \"%s\"", infilename);
 
-	uint32_t vertex_layout_hash = hash_string(mesh_intermediate->vertex_stream.layout);
+	uint64_t vertex_layout_hash = hash_string_64(mesh_intermediate->vertex_stream.layout);
+	if (manifestname != nullptr && !hash_manifest_add(manifestname, &mesh_intermediate->vertex_stream.layout, 1))
+		ERROR_AND_FAIL("vertex layout name \"%s\" collides with another name", mesh_intermediate->vertex_stream.layout);
+
 	vertex_layout_t* vertex_layout = nullptr;
 	err = dl_util_load_from_file(
 			dl_ctx,
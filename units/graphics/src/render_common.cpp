@@ -146,6 +146,12 @@ render_result_t render_instance_set_data(render_t* render, size_t num_instances,
 	return (render_result_t)-1;
 }
 
+render_result_t render_instance_map_data(render_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data)
+{
+	RENDER_CALL_FUNC(render, instance_map_data, render->backend, num_instances, instance_ids, out_data)
+	return (render_result_t)-1;
+}
+
 void render_kick_render(render_t* render, render_view_id_t view_id, render_script_id_t script_id)
 {
 	RENDER_CALL_FUNC(render, kick_render, render->backend, view_id, script_id)
@@ -27,6 +27,7 @@ void            render_null_mesh_destroy      (render_null_t* render, render_mes
 render_result_t render_null_instance_create   (render_null_t* render, const render_instance_create_info_t* create_info, render_instance_id_t* out_instance_id);
 void            render_null_instance_destroy  (render_null_t* render, render_instance_id_t instance_id);
 render_result_t render_null_instance_set_data (render_null_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data);
+render_result_t render_null_instance_map_data (render_null_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data);
 void            render_null_kick_render       (render_null_t* render, render_view_id_t view_id, render_script_id_t script_id); // TODO: multiple views (stereo, shadow, etc)
 void            render_null_kick_upload       (render_null_t* render);
 
@@ -51,6 +52,7 @@ void            render_vulkan_mesh_destroy      (render_vulkan_t* render, render
 render_result_t render_vulkan_instance_create   (render_vulkan_t* render, const render_instance_create_info_t* create_info, render_instance_id_t* out_instance_id);
 void            render_vulkan_instance_destroy  (render_vulkan_t* render, render_instance_id_t instance_id);
 render_result_t render_vulkan_instance_set_data (render_vulkan_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data);
+render_result_t render_vulkan_instance_map_data (render_vulkan_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data);
 void            render_vulkan_kick_render       (render_vulkan_t* render, render_view_id_t view_id, render_script_id_t script_id); // TODO: multiple views (stereo, shadow, etc)
 void            render_vulkan_kick_upload       (render_vulkan_t* render);
 #endif
@@ -76,6 +78,7 @@ void            render_dx12_mesh_destroy      (render_dx12_t* render, render_mes
 render_result_t render_dx12_instance_create   (render_dx12_t* render, const render_instance_create_info_t* create_info, render_instance_id_t* out_instance_id);
 void            render_dx12_instance_destroy  (render_dx12_t* render, render_instance_id_t instance_id);
 render_result_t render_dx12_instance_set_data (render_dx12_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data);
+render_result_t render_dx12_instance_map_data (render_dx12_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data);
 void            render_dx12_kick_render       (render_dx12_t* render, render_view_id_t view_id, render_script_id_t script_id); // TODO: multiple views (stereo, shadow, etc)
 void            render_dx12_kick_upload       (render_dx12_t* render);
 #endif
@@ -101,6 +104,7 @@ void            render_metal_mesh_destroy      (render_metal_t* render, render_m
 render_result_t render_metal_instance_create   (render_metal_t* render, const render_instance_create_info_t* create_info, render_instance_id_t* out_instance_id);
 void            render_metal_instance_destroy  (render_metal_t* render, render_instance_id_t instance_id);
 render_result_t render_metal_instance_set_data (render_metal_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data);
+render_result_t render_metal_instance_map_data (render_metal_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data);
 void            render_metal_kick_render       (render_metal_t* render, render_view_id_t view_id, render_script_id_t script_id); // TODO: multiple views (stereo, shadow, etc)
 void            render_metal_kick_upload       (render_metal_t* render);
 #endif
\ No newline at end of file
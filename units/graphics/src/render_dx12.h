@@ -4,7 +4,7 @@
 #include "render_common.h"
 
 #include <foundation/objpool.h>
-#include <foundation/cobjpool.h>
+#include <foundation/gen_cobjpool.h>
 #include <foundation/idpool.h>
 #include <foundation/range_pool.h>
 
@@ -126,7 +126,7 @@ struct render_dx12_texture_t
 
 struct render_dx12_shader_property_t
 {
-	uint32_t name_hash;
+	uint64_t name_hash;
 	shader_frequency_t frequency;
 	uint32_t pack_offset;
 	uint32_t pack_size;
@@ -151,6 +151,8 @@ struct render_dx12_shader_t
 
 	size_t num_properties;
 	render_dx12_shader_property_t* properties;
+	uint32_t num_property_seeds;
+	uint32_t* property_seeds; // perfect hash seeds, properties are stored in their slots
 
 	size_t num_variants;
 	render_dx12_shader_variant_t* variants;
@@ -215,7 +217,7 @@ struct render_dx12_t : public render_t
 	objpool_t<render_dx12_material_t,  render_material_id_t> materials;
 	objpool_t<render_dx12_mesh_t,      render_mesh_id_t>     meshes;
 
-	cobjpool_t<render_dx12_instance_t, render_instance_id_t> instances;
+	gen_cobjpool_t<render_dx12_instance_t, render_instance_id_t> instances;
 
 	array_t<render_dx12_upload_t> pending_uploads;
 
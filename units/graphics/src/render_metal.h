@@ -4,7 +4,7 @@
 #include "render_common.h"
 
 #include <foundation/objpool.h>
-#include <foundation/cobjpool.h>
+#include <foundation/gen_cobjpool.h>
 
 /* external types */
 #include <units/graphics/types/mesh.h>
@@ -64,7 +64,7 @@ struct render_metal_t : public render_t
 	objpool_t<render_metal_material_t,  render_material_id_t> materials;
 	objpool_t<render_metal_mesh_t,      render_mesh_id_t>     meshes;
 
-	cobjpool_t<render_metal_instance_t, render_instance_id_t> instances;
+	gen_cobjpool_t<render_metal_instance_t, render_instance_id_t> instances;
 
 	NSWindow* window;
 	NSView* view;
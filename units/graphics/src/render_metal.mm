@@ -121,7 +121,7 @@ render_result_t render_metal_material_create(render_metal_t* render, const mater
 	ASSERT(render->materials.num_free() != 0);
 
 	render_metal_material_t* material = render->materials.alloc();
-	material->shader = render->shaders.handle_to_pointer(material_data->shader_name_hash);
+	material->shader = render->shaders.handle_to_pointer((render_shader_id_t)material_data->shader_name_hash);
 
 	*out_material_id = render->materials.pointer_to_handle(material);
 	return RENDER_RESULT_OK;
@@ -174,18 +174,23 @@ void render_metal_instance_destroy(render_metal_t* render, render_instance_id_t
 
 render_result_t render_metal_instance_set_data(render_metal_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data)
 {
-	// TODO: do this a more efficient way?
-	render_metal_instance_t* instances = render->instances.base_ptr();
-	render_instance_id_t* instance_indices = render->instances.index_ptr();
 	for (size_t i = 0; i < num_instances; ++i)
 	{
-		render_metal_instance_t* instance = &instances[instance_indices[instance_ids[i]]]; // :E
+		render_metal_instance_t* instance = render->instances.handle_to_pointer(instance_ids[i]);
 		memcpy(&instance->data, &instance_data[i], sizeof(instance->data));
 	}
 
 	return RENDER_RESULT_OK;
 }
 
+render_result_t render_metal_instance_map_data(render_metal_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data)
+{
+	for (size_t i = 0; i < num_instances; ++i)
+		out_data[i] = &render->instances.handle_to_pointer(instance_ids[i])->data;
+
+	return RENDER_RESULT_OK;
+}
+
 void render_metal_kick_render(render_metal_t* render, render_view_id_t /*view_id*/, render_script_id_t /*script_id*/)
 {
 	@autoreleasepool
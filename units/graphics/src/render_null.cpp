@@ -91,6 +91,14 @@ render_result_t render_null_instance_set_data(render_null_t* /*render*/, size_t
 	return RENDER_RESULT_OK;
 }
 
+render_result_t render_null_instance_map_data(render_null_t* render, size_t num_instances, const render_instance_id_t* /*instance_ids*/, render_instance_data_t** out_data)
+{
+	for (size_t i = 0; i < num_instances; ++i)
+		out_data[i] = &render->discard;
+
+	return RENDER_RESULT_OK;
+}
+
 void render_null_kick_render(render_null_t* /*render*/, render_view_id_t /*view_id*/, render_script_id_t /*script_id*/)
 {
 }
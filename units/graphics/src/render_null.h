@@ -6,4 +6,5 @@
 struct render_null_t : public render_t
 {
 	allocator_t* allocator;
+	render_instance_data_t discard; // Every mapped instance points here
 };
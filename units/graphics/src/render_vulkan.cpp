@@ -2,6 +2,7 @@
 #include <foundation/allocator.h>
 #include <foundation/assert.h>
 #include <foundation/hash.h>
+#include <foundation/perfect_hash.h>
 
 #include <algorithm>
 
@@ -661,6 +662,9 @@ render_result_t render_vulkan_shader_create(render_vulkan_t* render, const shade
 	// TODO: copy less things
 	shader->num_properties = data->properties.count;
 	shader->properties = ALLOCATOR_ALLOC_ARRAY(render->allocator, data->properties.count, render_vulkan_shader_property_t);
+	shader->num_property_seeds = shader_data->property_seeds.count;
+	shader->property_seeds = ALLOCATOR_ALLOC_ARRAY(render->allocator, shader_data->property_seeds.count, uint32_t);
+	memcpy(shader->property_seeds, shader_data->property_seeds.data, shader_data->property_seeds.count * sizeof(uint32_t));
 	shader->num_variants = data->variants.count;
 	shader->variants = ALLOCATOR_ALLOC_ARRAY(render->allocator, data->variants.count, render_vulkan_shader_variant_t);
 	memset(shader->constant_buffers, 0, sizeof(shader->constant_buffers));
@@ -894,6 +898,7 @@ void render_vulkan_shader_destroy(render_vulkan_t* render, render_shader_id_t sh
 	render_vulkan_shader_t* shader = render->shaders.handle_to_pointer(shader_id);
 	ALLOCATOR_FREE(render->allocator, shader->variants);
 	ALLOCATOR_FREE(render->allocator, shader->properties);
+	ALLOCATOR_FREE(render->allocator, shader->property_seeds);
 	for (int i = 0; i < SHADER_FREQUENCY_MAX; ++i)
 	{
 		ALLOCATOR_FREE(render->allocator, shader->constant_buffers[i].default_data);
@@ -903,12 +908,21 @@ void render_vulkan_shader_destroy(render_vulkan_t* render, render_shader_id_t sh
 	render->shaders.free_handle(shader_id);
 }
 
+static size_t render_vulkan_shader_find_property(const render_vulkan_shader_t* shader, uint64_t name_hash)
+{
+	if (shader->num_properties == 0)
+		return SIZE_MAX;
+
+	uint32_t idx = perfect_hash_lookup(shader->property_seeds, shader->num_property_seeds, (uint32_t)shader->num_properties, name_hash);
+	return shader->properties[idx].name_hash == name_hash ? idx : SIZE_MAX;
+}
+
 render_result_t render_vulkan_material_create(render_vulkan_t* render, const material_data_t* material_data, render_material_id_t* out_material_id)
 {
 	ASSERT(render->materials.num_free() != 0);
 
 	render_vulkan_material_t* material = render->materials.alloc();
-	render_vulkan_shader_t* shader = material->shader = render->shaders.handle_to_pointer(material_data->shader_name_hash);
+	render_vulkan_shader_t* shader = material->shader = render->shaders.handle_to_pointer((render_shader_id_t)material_data->shader_name_hash);
 	memset(material->constant_buffers, 0, sizeof(uint8_t*) * SHADER_FREQUENCY_MAX);
 
 	// Copy in all material specific information
@@ -918,22 +932,12 @@ render_result_t render_vulkan_material_create(render_vulkan_t* render, const mat
 	for (size_t i = 0; i < material_data->properties.count; ++i)
 	{
 		// Find the the property from the shader
-		size_t idx = SIZE_MAX;
-		// TODO: rewrite with a sorted array and binary search?
-		for (size_t isp = 0; isp < shader->num_properties; ++isp)
-		{
-			if (shader->properties[isp].name_hash == material_data->properties[i].name_hash)
-			{
-				idx = isp;
-				break;
-			}
-		}
-		
+		size_t idx = render_vulkan_shader_find_property(shader, material_data->properties[i].name_hash);
 		if(idx != SIZE_MAX)
 		{
 			// Make sure we have the constant buffer to patch
 			ASSERT(shader->properties[idx].pack_size == material_data->properties[i].value.count);
-			const shader_frequency_t icb = shader->properties[i].frequency;
+			const shader_frequency_t icb = shader->properties[idx].frequency;
 			ASSERT(icb >= SHADER_FREQUENCY_PER_MATERIAL);
 			if (material->constant_buffers[icb] == nullptr)
 			{
@@ -1004,19 +1008,24 @@ void render_vulkan_instance_destroy(render_vulkan_t* render, render_instance_id_
 
 render_result_t render_vulkan_instance_set_data(render_vulkan_t* render, size_t num_instances, render_instance_id_t* instance_ids, render_instance_data_t* instance_data)
 {
-	// TODO: do this a more efficient way?
 	// TODO: extract to shared function
-	render_vulkan_instance_t* instances = render->instances.base_ptr();
-	render_instance_id_t* instance_indices = render->instances.index_ptr();
 	for (size_t i = 0; i < num_instances; ++i)
 	{
-		render_vulkan_instance_t* instance = &instances[instance_indices[instance_ids[i]]]; // :E
+		render_vulkan_instance_t* instance = render->instances.handle_to_pointer(instance_ids[i]);
 		memcpy(&instance->data, &instance_data[i], sizeof(instance->data));
 	}
 
 	return RENDER_RESULT_OK;
 }
 
+render_result_t render_vulkan_instance_map_data(render_vulkan_t* render, size_t num_instances, const render_instance_id_t* instance_ids, render_instance_data_t** out_data)
+{
+	for (size_t i = 0; i < num_instances; ++i)
+		out_data[i] = &render->instances.handle_to_pointer(instance_ids[i])->data;
+
+	return RENDER_RESULT_OK;
+}
+
 void render_vulkan_kick_render(render_vulkan_t* render, render_view_id_t /*view_id*/, render_script_id_t /*script_id*/)
 {
 	uint32_t image_index = 0;
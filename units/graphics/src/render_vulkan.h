@@ -4,7 +4,7 @@
 #include "render_common.h"
 #include <foundation/array.h>
 #include <foundation/objpool.h>
-#include <foundation/cobjpool.h>
+#include <foundation/gen_cobjpool.h>
 #include <foundation/idpool.h>
 
 // define these... vulkan.h pulls in windows.h if we want to use PLATFORM_WIN32
@@ -57,7 +57,7 @@ struct render_vulkan_texture_t
 
 struct render_vulkan_shader_property_t
 {
-	uint32_t name_hash;
+	uint64_t name_hash;
 	shader_frequency_t frequency;
 	uint32_t pack_offset;
 	uint32_t pack_size;
@@ -87,6 +87,8 @@ struct render_vulkan_shader_t
 
 	size_t num_properties;
 	render_vulkan_shader_property_t* properties;
+	uint32_t num_property_seeds;
+	uint32_t* property_seeds; // perfect hash seeds, properties are stored in their slots
 
 	size_t num_variants;
 	render_vulkan_shader_variant_t* variants;
@@ -135,7 +137,7 @@ struct render_vulkan_t : public render_t
 	objpool_t<render_vulkan_material_t,  render_material_id_t> materials;
 	objpool_t<render_vulkan_mesh_t,      render_mesh_id_t>     meshes;
 
-	cobjpool_t<render_vulkan_instance_t, render_instance_id_t> instances;
+	gen_cobjpool_t<render_vulkan_instance_t, render_instance_id_t> instances;
 
 	VkInstance instance;
 	VkDebugReportCallbackEXT debug_callback;
@@ -1,7 +1,9 @@
 #include <foundation/assert.h>
+#include <foundation/hash.h>
 
 #include <foundation/allocator.h>
 #include <foundation/file.h>
+#include <foundation/perfect_hash.h>
 
 #include <dl/dl.h>
 #include <dl/dl_util.h>
@@ -37,6 +39,7 @@ int main(int argc, const char** argv)
 	{
 		{ "help",   'h', GETOPT_OPTION_TYPE_NO_ARG,   0x0, 'h', "displays this message", 0x0 },
 		{ "output", 'o', GETOPT_OPTION_TYPE_REQUIRED, 0x0, 'o', "output to file", "file" },
+		{ "manifest", 'm', GETOPT_OPTION_TYPE_REQUIRED, 0x0, 'm', "check hashed names for collisions with all names in manifest and add them to it", "file" },
 		GETOPT_OPTIONS_END
 	};
 
@@ -45,6 +48,7 @@ int main(int argc, const char** argv)
 
 	const char* infilename = NULL;
 	const char* outfilename = NULL;
+	const char* manifestname = NULL;
 
 	int opt;
 	while( (opt = getopt_next( &go_ctx ) ) != -1 )
@@ -60,6 +64,9 @@ int main(int argc, const char** argv)
 
 				outfilename = go_ctx.current_opt_arg;
 				break;
+			case 'm':
+				manifestname = go_ctx.current_opt_arg;
+				break;
 			case '+':
 				if(infilename != NULL && infilename[0] != '\0')
 				{
@@ -95,7 +102,41 @@ int main(int argc, const char** argv)
 	if(err != DL_ERROR_OK)
 		ERROR_AND_FAIL("failed to load intermediate shader from file \"%s\"", infilename);
 
+	size_t num_properties = shader_intermediate->properties.count;
+	uint64_t* property_hashes = ALLOCATOR_ALLOC_ARRAY(&allocator_malloc, num_properties, uint64_t);
+	for (size_t i = 0; i < num_properties; ++i)
+	{
+		const char* name = shader_intermediate->properties[i].name;
+		property_hashes[i] = hash_string_64(name);
+		if (!hash_registry_add(property_hashes[i], name))
+			ERROR_AND_FAIL("property name \"%s\" collides with another name", name);
+	}
+
+	if (manifestname != NULL)
+	{
+		const char** names = ALLOCATOR_ALLOC_ARRAY(&allocator_malloc, num_properties, const char*);
+		for (size_t i = 0; i < num_properties; ++i)
+			names[i] = shader_intermediate->properties[i].name;
+		if (!hash_manifest_add(manifestname, names, num_properties))
+			ERROR_AND_FAIL("a property name of \"%s\" collides with another name", infilename);
+	}
+
+	// Build a perfect hash table for the properties and reorder them into their slots,
+	// that way the backends emit them in lookup order and the runtime finds them in O(1)
+	uint32_t num_property_seeds = perfect_hash_num_seeds(num_properties);
+	uint32_t* property_seeds = ALLOCATOR_ALLOC_ARRAY(&allocator_malloc, num_property_seeds, uint32_t);
+	uint32_t* property_slots = ALLOCATOR_ALLOC_ARRAY(&allocator_malloc, num_properties, uint32_t);
+	if (!perfect_hash_build(&allocator_malloc, property_hashes, num_properties, property_seeds, property_slots))
+		ERROR_AND_FAIL("failed to build property table for \"%s\", are there duplicate property names?", infilename);
+
+	shader_intermediate_property_t* sorted_properties = ALLOCATOR_ALLOC_ARRAY(&allocator_malloc, num_properties, shader_intermediate_property_t);
+	for (size_t i = 0; i < num_properties; ++i)
+		sorted_properties[property_slots[i]] = shader_intermediate->properties[i];
+	shader_intermediate->properties.data = sorted_properties;
+
 	shader_data_t shader_data = {};
+	shader_data.property_seeds.data = property_seeds;
+	shader_data.property_seeds.count = num_property_seeds;
 
 	shader_data_null_t shader_data_null = {};
 	shader_data.data_null = &shader_data_null;
@@ -65,7 +65,7 @@ bool compile_shader_vulkan(shader_intermediate_t* shader_intermediate, shader_da
 	char itoa_scratch[21];
 	for (size_t i = 0; i < num_properties; ++i)
 	{
-		properties[i].name_hash = hash_string(shader_intermediate->properties[i].name);
+		properties[i].name_hash = hash_string_64(shader_intermediate->properties[i].name);
 		shader_frequency_t freq = properties[i].frequency = (shader_frequency_t)shader_intermediate->properties[i].frequency;
 		switch (shader_intermediate->properties[i].data.type)
 		{